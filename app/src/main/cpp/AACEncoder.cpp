@@ -2,7 +2,9 @@
 #include <vector>
 #include <chrono>
 #include <algorithm>
+#include <ctime>
 #include <android/log.h>
+#include "soundtouch/include/SampleConvert.h"
 
 #ifndef AMEDIAFORMAT_AAC_PROFILE_LC
 #define AMEDIAFORMAT_AAC_PROFILE_LC 2
@@ -13,16 +15,44 @@
 
 static constexpr int AAC_FRAME_SAMPLES = 1024;
 static constexpr int TIMEOUT_US = 10000;  // 10ms timeout
+static constexpr int64_t EOS_TIMEOUT_MS = 2000;
+
+static int64_t nowNs(clockid_t clock) {
+    timespec ts{};
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
 AacEncoder::AacEncoder(PcmRingBuffer& buffer,
                        int sampleRate,
                        int channels,
-                       int fd)
-        : mRing(buffer),
-          mSampleRate(sampleRate),
+                       int fd,
+                       int encodeRate,
+                       int bitrate,
+                       bool fillGaps,
+                       EncoderMode mode)
+        : mReader(buffer, sampleRate, channels, fillGaps, encodeRate),
+          mSampleRate(mReader.outputRate()),
           mChannels(channels),
-          mFd(fd) {}
-
+          mBitrate(bitrate > 0 ? bitrate : defaultBitrate(mSampleRate, channels)),
+          mFd(fd),
+          mMode(mode),
+          mFloatBuf(AAC_FRAME_SAMPLES * channels),
+          mPcm16(AAC_FRAME_SAMPLES * channels) {}
+
+
+// Speech at the reduced rates is transparent well below the music bitrate
+int AacEncoder::defaultBitrate(int sampleRate, int channels) {
+    int perChannel;
+    if (sampleRate <= 16000) {
+        perChannel = 24000;
+    } else if (sampleRate <= 24000) {
+        perChannel = 32000;
+    } else {
+        perChannel = 128000;
+    }
+    return perChannel * channels;
+}
 
 void AacEncoder::start() {
     if (mRunning.load()) {
@@ -30,8 +60,13 @@ void AacEncoder::start() {
         return;
     }
 
+    mStartNs = nowNs(CLOCK_MONOTONIC);
     mRunning.store(true);
-    mThread = std::thread(&AacEncoder::encodeLoop, this);
+    if (mMode == EncoderMode::Async) {
+        mThread = std::thread(&AacEncoder::asyncEncodeLoop, this);
+    } else {
+        mThread = std::thread(&AacEncoder::encodeLoop, this);
+    }
 }
 
 
@@ -41,6 +76,7 @@ void AacEncoder::stop() {
     }
 
     mRunning.store(false);
+    mInputCv.notify_all();
     if (mThread.joinable()) {
         mThread.join();
     }
@@ -49,175 +85,555 @@ void AacEncoder::stop() {
 void AacEncoder::encodeLoop() {
     LOGI("encodeLoop started");
 
-    AMediaCodec* codec = AMediaCodec_createEncoderByType("audio/mp4a-latm");
-    if (!codec) {
-        LOGE("Failed to create AAC encoder");
+    if (!openCodec()) {
+        mFailed.store(true);
         return;
     }
 
+    int64_t startWallNs = nowNs(CLOCK_MONOTONIC);
+    int64_t startCpuNs = nowNs(CLOCK_THREAD_CPUTIME_ID);
+    bool eosSignaled = false;
+    bool stopping = false;
+    std::chrono::steady_clock::time_point eosDeadline;
+
+    while (mRunning.load() || !eosSignaled) {
+        // Once stopped, the codec gets EOS_TIMEOUT_MS to take the end of
+        // stream and hand back everything before it
+        if (!stopping && !mRunning.load()) {
+            stopping = true;
+            eosDeadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(EOS_TIMEOUT_MS);
+        } else if (stopping && std::chrono::steady_clock::now() > eosDeadline) {
+            LOGE("Timed out waiting for EOS from encoder");
+            mFailed.store(true);
+            break;
+        }
+
+        // 1. Feed input once a frame is collected
+        if (!eosSignaled && collectFrame()) {
+            ssize_t inIdx = AMediaCodec_dequeueInputBuffer(mCodec, TIMEOUT_US);
+            if (inIdx >= 0) {
+                queueFrame(inIdx);
+            }
+        } else if (!mRunning.load() && !eosSignaled) {
+            // Signal end of stream
+            ssize_t inIdx = AMediaCodec_dequeueInputBuffer(mCodec, TIMEOUT_US);
+            if (inIdx >= 0) {
+                queueEos(inIdx);
+                eosSignaled = true;
+            }
+        }
+
+        // 2. Drain output
+        AMediaCodecBufferInfo info;
+        ssize_t outIdx = AMediaCodec_dequeueOutputBuffer(mCodec, &info, TIMEOUT_US);
+
+        if (outIdx == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
+            AMediaFormat* outFormat = AMediaCodec_getOutputFormat(mCodec);
+            bool ok = handleOutputFormat(outFormat);
+            AMediaFormat_delete(outFormat);
+
+            if (!ok) {
+                mFailed.store(true);
+                break;
+            }
+        } else if (outIdx >= 0) {
+            // Check for end of stream
+            if (writeOutput(outIdx, info)) {
+                break;
+            }
+        } else if (outIdx == AMEDIACODEC_INFO_TRY_AGAIN_LATER) {
+            // No output available yet
+            if (!mRunning.load() && eosSignaled) {
+                // Give it more time to flush
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+    }
+
+    LOGI("Encoding loop finished, cleaning up");
+
+    mThreadCpuNs = nowNs(CLOCK_THREAD_CPUTIME_ID) - startCpuNs;
+    logStats(nowNs(CLOCK_MONOTONIC) - startWallNs);
+
+    releaseCodec();
+}
+
+// Input buffers are handed out by onAsyncInputAvailable and filled here once
+// the ring has a frame; output is written to the muxer directly from the
+// codec's callback thread, so neither side waits for the other.
+void AacEncoder::asyncEncodeLoop() {
+    LOGI("asyncEncodeLoop started");
+
+    if (!openCodec()) {
+        mFailed.store(true);
+        return;
+    }
+
+    int64_t startWallNs = nowNs(CLOCK_MONOTONIC);
+    int64_t startCpuNs = nowNs(CLOCK_THREAD_CPUTIME_ID);
+    bool eosSignaled = false;
+    std::chrono::steady_clock::time_point eosDeadline;
+
+    while (!mOutputDone.load()) {
+        if (eosSignaled) {
+            // Only the output is left. The codec keeps handing out input
+            // buffers, so wait for the end of the output rather than for them.
+            std::unique_lock<std::mutex> lock(mInputMutex);
+            if (!mInputCv.wait_until(lock, eosDeadline, [this] { return mOutputDone.load(); })) {
+                LOGE("Timed out waiting for EOS from encoder");
+                mFailed.store(true);
+            }
+            break;
+        }
+
+        int32_t inIdx = -1;
+        {
+            std::unique_lock<std::mutex> lock(mInputMutex);
+            mInputCv.wait_for(lock, std::chrono::milliseconds(5), [this] {
+                return !mInputIndices.empty() || mOutputDone.load();
+            });
+            if (!mInputIndices.empty()) {
+                inIdx = mInputIndices.front();
+            }
+        }
+
+        if (inIdx < 0) {
+            continue;
+        }
+
+        bool consumed = true;
+        if (collectFrame()) {
+            queueFrame(inIdx);
+        } else if (!mRunning.load()) {
+            queueEos(inIdx);
+            eosSignaled = true;
+            eosDeadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(EOS_TIMEOUT_MS);
+        } else {
+            // Ring has no full frame yet, keep the buffer for the next round
+            consumed = false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        if (consumed) {
+            std::lock_guard<std::mutex> lock(mInputMutex);
+            mInputIndices.pop_front();
+        }
+    }
+
+    LOGI("Encoding loop finished, cleaning up");
+
+    mThreadCpuNs = nowNs(CLOCK_THREAD_CPUTIME_ID) - startCpuNs;
+    logStats(nowNs(CLOCK_MONOTONIC) - startWallNs);
+
+    releaseCodec();
+}
+
+bool AacEncoder::createCodec() {
+    mCodec = AMediaCodec_createEncoderByType("audio/mp4a-latm");
+    if (!mCodec) {
+        LOGE("Failed to create AAC encoder");
+        return false;
+    }
+
+    if (mMode == EncoderMode::Async) {
+        AMediaCodecOnAsyncNotifyCallback callback = {
+                onAsyncInputAvailable,
+                onAsyncOutputAvailable,
+                onAsyncFormatChanged,
+                onAsyncError
+        };
+        media_status_t status = AMediaCodec_setAsyncNotifyCallback(mCodec, callback, this);
+        if (status != AMEDIA_OK) {
+            LOGE("Failed to set async callback: %d", status);
+            AMediaCodec_delete(mCodec);
+            mCodec = nullptr;
+            return false;
+        }
+    }
+
+    LOGI("Encoding %d Hz, %d channels at %d bps", mSampleRate, mChannels, mBitrate);
+
     AMediaFormat* format = AMediaFormat_new();
     AMediaFormat_setString(format, AMEDIAFORMAT_KEY_MIME, "audio/mp4a-latm");
     AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_SAMPLE_RATE, mSampleRate);
     AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_CHANNEL_COUNT, mChannels);
-    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_BIT_RATE, 128000);
+    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_BIT_RATE, mBitrate);
     AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_AAC_PROFILE,
                           AMEDIAFORMAT_AAC_PROFILE_LC);
 //    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_PCM_ENCODING, 2);
 
-    media_status_t status = AMediaCodec_configure(codec, format, nullptr, nullptr,
+    media_status_t status = AMediaCodec_configure(mCodec, format, nullptr, nullptr,
                                                   AMEDIACODEC_CONFIGURE_FLAG_ENCODE);
     AMediaFormat_delete(format);
 
     if (status != AMEDIA_OK) {
         LOGE("Failed to configure codec: %d", status);
-        AMediaCodec_delete(codec);
-        return;
+        AMediaCodec_delete(mCodec);
+        mCodec = nullptr;
+        return false;
     }
 
-    status = AMediaCodec_start(codec);
+    status = AMediaCodec_start(mCodec);
     if (status != AMEDIA_OK) {
         LOGE("Failed to start codec: %d", status);
-        AMediaCodec_delete(codec);
-        return;
+        AMediaCodec_delete(mCodec);
+        mCodec = nullptr;
+        return false;
     }
 
-    AMediaMuxer* muxer = AMediaMuxer_new(mFd, AMEDIAMUXER_OUTPUT_FORMAT_MPEG_4);
-    if (!muxer) {
+    return true;
+}
+
+// Codec creation, configuration and start take tens to hundreds of
+// milliseconds, so they can be done ahead of the recording. Only the muxer
+// needs the fd.
+bool AacEncoder::prepare() {
+    if (mCodec) {
+        return true;
+    }
+
+    int64_t startNs = nowNs(CLOCK_MONOTONIC);
+    bool ok = createCodec();
+    LOGI("Codec prepared in %.1f ms", (nowNs(CLOCK_MONOTONIC) - startNs) / 1e6);
+    return ok;
+}
+
+void AacEncoder::attach(int fd) {
+    mFd = fd;
+}
+
+bool AacEncoder::openCodec() {
+    if (!mCodec && !createCodec()) {
+        return false;
+    }
+
+    if (!createMuxer()) {
+        releaseCodec();
+        return false;
+    }
+    return true;
+}
+
+// A format change reported before the muxer existed is applied here, with
+// the codec's current output format.
+bool AacEncoder::createMuxer() {
+    std::lock_guard<std::mutex> lock(mMuxerMutex);
+
+    mMuxer = AMediaMuxer_new(mFd, AMEDIAMUXER_OUTPUT_FORMAT_MPEG_4);
+    if (!mMuxer) {
         LOGE("Failed to create muxer");
-        AMediaCodec_stop(codec);
-        AMediaCodec_delete(codec);
-        return;
+        return false;
     }
 
-    bool muxerStarted = false;
-    int trackIndex = -1;
+    if (mFormatPending) {
+        AMediaFormat* format = AMediaCodec_getOutputFormat(mCodec);
+        bool ok = addTrack(format);
+        AMediaFormat_delete(format);
+        return ok;
+    }
+    return true;
+}
 
-    std::vector<float> floatBuf(AAC_FRAME_SAMPLES * mChannels);
-    std::vector<int16_t> pcm16(floatBuf.size());
+void AacEncoder::releaseCodec() {
+    // Cleanup
+    AMediaCodec_stop(mCodec);
+    AMediaCodec_delete(mCodec);
+    mCodec = nullptr;
+
+    // The muxer writes the MP4 index on stop; without it the file is unusable
+    std::lock_guard<std::mutex> lock(mMuxerMutex);
+    if (mMuxerStarted) {
+        media_status_t status = AMediaMuxer_stop(mMuxer);
+        if (status != AMEDIA_OK) {
+            LOGE("Failed to stop muxer: %d", status);
+            mFailed.store(true);
+        }
+        mMuxerStarted = false;
+    }
+    if (mMuxer) {
+        AMediaMuxer_delete(mMuxer);
+        mMuxer = nullptr;
+    }
 
-    int64_t ptsUs = 0;
-    int64_t frameUs = AAC_FRAME_SAMPLES * 1000000LL / mSampleRate;
-    bool eosSignaled = false;
+    LOGI("Encoder cleanup complete");
+}
 
-    while (mRunning.load() || !eosSignaled) {
-        // 1. Feed input if we have enough PCM
-        if (mRunning.load() && mRing.size() >= AAC_FRAME_SAMPLES) {
-            size_t read = mRing.pop(floatBuf.data(), AAC_FRAME_SAMPLES);
-
-            if (read == AAC_FRAME_SAMPLES) {
-                // Convert float to int16
-                for (size_t i = 0; i < AAC_FRAME_SAMPLES; ++i) {
-                    float s = std::max(-1.0f, std::min(1.0f, floatBuf[i]));
-                    pcm16[i] = static_cast<int16_t>(s * 32767.0f);
-                }
-
-                ssize_t inIdx = AMediaCodec_dequeueInputBuffer(codec, TIMEOUT_US);
-                if (inIdx >= 0) {
-                    size_t inSize;
-                    uint8_t* inBuf = AMediaCodec_getInputBuffer(codec, inIdx, &inSize);
-
-                    size_t dataSize = pcm16.size() * sizeof(int16_t);
-                    if (inBuf && dataSize <= inSize) {
-                        memcpy(inBuf, pcm16.data(), dataSize);
-
-                        AMediaCodec_queueInputBuffer(
-                                codec,
-                                inIdx,
-                                0,
-                                dataSize,
-                                ptsUs,
-                                0);
-
-                        ptsUs += frameUs;
-                    } else {
-                        LOGE("Input buffer too small or null");
-                    }
-                }
+// Collects the next frame into mFloatBuf. Returns true when a frame is ready to
+// queue - a full one, or the partial one left before a skipped gap or at the
+// end of the recording.
+bool AacEncoder::collectFrame() {
+    const size_t frameSamples = mFloatBuf.size();
+
+    if (!mRunning.load() && !mFlushPartial) {
+        // Samples the reader already decimated still belong to the recording
+        mFilled += mReader.readBuffered(mFloatBuf.data() + mFilled, frameSamples - mFilled);
+        if (mFilled == frameSamples) {
+            return true;
+        }
+        if (mFilled > 0) {
+            mFlushPartial = true;
+        }
+    }
+
+    while (mRunning.load() && mFilled < frameSamples && !mFlushPartial) {
+        int64_t skipped = 0;
+        size_t read = mReader.read(mFloatBuf.data() + mFilled, frameSamples - mFilled, skipped);
+
+        if (skipped > 0) {
+            LOGI("Skipping discontinuity of %lld frames", (long long) skipped);
+            {
+                std::lock_guard<std::mutex> lock(mStatsMutex);
+                mStats.skippedFrames += skipped;
             }
-        } else if (!mRunning.load() && !eosSignaled) {
-            // Signal end of stream
-            ssize_t inIdx = AMediaCodec_dequeueInputBuffer(codec, TIMEOUT_US);
-            if (inIdx >= 0) {
-                AMediaCodec_queueInputBuffer(
-                        codec,
-                        inIdx,
-                        0,
-                        0,
-                        ptsUs,
-                        AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
-                eosSignaled = true;
-                LOGI("EOS signaled to encoder");
+
+            if (mFilled > 0) {
+                mSkipFrames = skipped;
+                mFlushPartial = true;
+            } else {
+                mPtsFrames += skipped;
             }
+            continue;
         }
 
-        // 2. Drain output
-        AMediaCodecBufferInfo info;
-        ssize_t outIdx = AMediaCodec_dequeueOutputBuffer(codec, &info, TIMEOUT_US);
+        if (read == 0) {
+            break;
+        }
+        mFilled += read;
+    }
 
-        if (outIdx == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
-            AMediaFormat* outFormat = AMediaCodec_getOutputFormat(codec);
-            trackIndex = AMediaMuxer_addTrack(muxer, outFormat);
-            AMediaFormat_delete(outFormat);
+    return mFilled == frameSamples || (mFlushPartial && mFilled > 0);
+}
 
-            if (trackIndex < 0) {
-                LOGE("Failed to add track to muxer");
-                break;
-            }
+void AacEncoder::queueFrame(ssize_t inIdx) {
+    int64_t convertStartNs = nowNs(CLOCK_MONOTONIC);
+    soundtouch::convertFloatToInt16(mFloatBuf.data(), mPcm16.data(), mFilled);
+    int64_t convertNs = nowNs(CLOCK_MONOTONIC) - convertStartNs;
+
+    size_t inSize;
+    uint8_t* inBuf = AMediaCodec_getInputBuffer(mCodec, inIdx, &inSize);
+
+    size_t dataSize = mFilled * sizeof(int16_t);
+    int64_t ptsUs = mPtsFrames * 1000000LL / mSampleRate;
+    if (inBuf && dataSize <= inSize) {
+        memcpy(inBuf, mPcm16.data(), dataSize);
+
+        {
+            std::lock_guard<std::mutex> lock(mStatsMutex);
+            mPendingInputs.emplace_back(ptsUs, nowNs(CLOCK_MONOTONIC));
+            int32_t depth = static_cast<int32_t>(mPendingInputs.size());
+            mStats.codecQueueDepth = depth;
+            mStats.codecQueueMax = std::max(mStats.codecQueueMax, depth);
+            mStats.framesQueued += static_cast<int64_t>(mFilled / mChannels);
+            mStats.discontinuities = mReader.discontinuityCount();
+            mStats.convert.add(convertNs);
+        }
 
-            media_status_t muxerStatus = AMediaMuxer_start(muxer);
-            if (muxerStatus != AMEDIA_OK) {
-                LOGE("Failed to start muxer: %d", muxerStatus);
-                break;
-            }
+        AMediaCodec_queueInputBuffer(
+                mCodec,
+                inIdx,
+                0,
+                dataSize,
+                ptsUs,
+                0);
+
+        if (mFirstSampleLatencyNs.load() < 0) {
+            int64_t latencyNs = nowNs(CLOCK_MONOTONIC) - mStartNs;
+            mFirstSampleLatencyNs.store(latencyNs);
+            logFirstSampleLatency();
+
+            std::lock_guard<std::mutex> lock(mStatsMutex);
+            mStats.firstSampleLatencyNs = latencyNs;
+        }
+    } else {
+        LOGE("Input buffer too small or null");
+    }
 
-            muxerStarted = true;
-            LOGI("Muxer started, track index: %d", trackIndex);
-        } else if (outIdx >= 0) {
-            if (muxerStarted && info.size > 0) {
-                size_t outSize;
-                uint8_t* outBuf = AMediaCodec_getOutputBuffer(codec, outIdx, &outSize);
-
-                if (outBuf) {
-                    media_status_t writeStatus = AMediaMuxer_writeSampleData(
-                            muxer,
-                            trackIndex,
-                            outBuf,
-                            &info);
-
-                    if (writeStatus != AMEDIA_OK) {
-                        LOGE("Failed to write sample data: %d", writeStatus);
-                    }
-                }
+    mPtsFrames += static_cast<int64_t>(mFilled / mChannels) + mSkipFrames;
+    mSkipFrames = 0;
+    mFlushPartial = false;
+    mFilled = 0;
+}
+
+void AacEncoder::queueEos(ssize_t inIdx) {
+    AMediaCodec_queueInputBuffer(
+            mCodec,
+            inIdx,
+            0,
+            0,
+            mPtsFrames * 1000000LL / mSampleRate,
+            AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
+    LOGI("EOS signaled to encoder");
+}
+
+bool AacEncoder::handleOutputFormat(AMediaFormat* format) {
+    std::lock_guard<std::mutex> lock(mMuxerMutex);
+
+    if (!mMuxer) {
+        // Prepared codec without an fd yet
+        mFormatPending = true;
+        return true;
+    }
+    return addTrack(format);
+}
+
+bool AacEncoder::addTrack(AMediaFormat* format) {
+    mTrackIndex = AMediaMuxer_addTrack(mMuxer, format);
+
+    if (mTrackIndex < 0) {
+        LOGE("Failed to add track to muxer");
+        return false;
+    }
+
+    media_status_t muxerStatus = AMediaMuxer_start(mMuxer);
+    if (muxerStatus != AMEDIA_OK) {
+        LOGE("Failed to start muxer: %d", muxerStatus);
+        return false;
+    }
+
+    mMuxerStarted = true;
+    LOGI("Muxer started, track index: %d", mTrackIndex);
+    return true;
+}
+
+// Writes one output buffer to the muxer and releases it.
+// Returns true when it carries the end of stream.
+bool AacEncoder::writeOutput(ssize_t outIdx, const AMediaCodecBufferInfo& info) {
+    // In async mode this runs on the codec's callback thread, while the
+    // encoder thread may be creating the muxer
+    std::unique_lock<std::mutex> muxerLock(mMuxerMutex);
+
+    if (mMuxerStarted && info.size > 0) {
+        size_t outSize;
+        uint8_t* outBuf = AMediaCodec_getOutputBuffer(mCodec, outIdx, &outSize);
+
+        int64_t writeNs = -1;
+        if (outBuf) {
+            int64_t writeStartNs = nowNs(CLOCK_MONOTONIC);
+            media_status_t writeStatus = AMediaMuxer_writeSampleData(
+                    mMuxer,
+                    mTrackIndex,
+                    outBuf,
+                    &info);
+
+            if (writeStatus != AMEDIA_OK) {
+                LOGE("Failed to write sample data: %d", writeStatus);
+                mFailed.store(true);
+            } else {
+                writeNs = nowNs(CLOCK_MONOTONIC) - writeStartNs;
             }
+        }
+        muxerLock.unlock();
 
-            AMediaCodec_releaseOutputBuffer(codec, outIdx, false);
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        if (writeNs >= 0) {
+            mStats.write.add(writeNs);
+            mStats.bytesWritten += info.size;
+        }
 
-            // Check for end of stream
-            if (info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) {
-                LOGI("Received EOS from encoder");
-                break;
+        if (!(info.flags & AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG)) {
+            int64_t queuedNs = -1;
+            while (!mPendingInputs.empty() &&
+                   mPendingInputs.front().first <= info.presentationTimeUs) {
+                queuedNs = mPendingInputs.front().second;
+                mPendingInputs.pop_front();
             }
-        } else if (outIdx == AMEDIACODEC_INFO_TRY_AGAIN_LATER) {
-            // No output available yet
-            if (!mRunning.load() && eosSignaled) {
-                // Give it more time to flush
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            } else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            if (queuedNs >= 0) {
+                mStats.encode.add(nowNs(CLOCK_MONOTONIC) - queuedNs);
             }
+            mStats.codecQueueDepth = static_cast<int32_t>(mPendingInputs.size());
         }
     }
 
-    LOGI("Encoding loop finished, cleaning up");
+    AMediaCodec_releaseOutputBuffer(mCodec, outIdx, false);
 
-    // Cleanup
-    AMediaCodec_stop(codec);
-    AMediaCodec_delete(codec);
+    if (info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) {
+        LOGI("Received EOS from encoder");
+        return true;
+    }
+    return false;
+}
 
-    if (muxerStarted) {
-        AMediaMuxer_stop(muxer);
+void AacEncoder::onAsyncInputAvailable(AMediaCodec*, void* userdata, int32_t index) {
+    auto* self = static_cast<AacEncoder*>(userdata);
+    {
+        std::lock_guard<std::mutex> lock(self->mInputMutex);
+        self->mInputIndices.push_back(index);
     }
-    AMediaMuxer_delete(muxer);
+    self->mInputCv.notify_one();
+}
 
-    LOGI("Encoder cleanup complete");
-}
\ No newline at end of file
+void AacEncoder::onAsyncOutputAvailable(AMediaCodec*, void* userdata, int32_t index,
+                                        AMediaCodecBufferInfo* info) {
+    auto* self = static_cast<AacEncoder*>(userdata);
+    int64_t startCpuNs = nowNs(CLOCK_THREAD_CPUTIME_ID);
+
+    if (self->writeOutput(index, *info)) {
+        self->finishOutput();
+    }
+
+    self->mCallbackCpuNs.fetch_add(nowNs(CLOCK_THREAD_CPUTIME_ID) - startCpuNs);
+}
+
+void AacEncoder::onAsyncFormatChanged(AMediaCodec*, void* userdata, AMediaFormat* format) {
+    auto* self = static_cast<AacEncoder*>(userdata);
+    if (!self->handleOutputFormat(format)) {
+        self->mFailed.store(true);
+        self->finishOutput();
+    }
+}
+
+void AacEncoder::onAsyncError(AMediaCodec*, void* userdata, media_status_t error,
+                              int32_t actionCode, const char* detail) {
+    auto* self = static_cast<AacEncoder*>(userdata);
+    LOGE("Codec error %d (action %d): %s", error, actionCode, detail ? detail : "");
+
+    self->mFailed.store(true);
+    self->finishOutput();
+}
+
+// Set under the input mutex, so that the encoder thread can't check the flag
+// and then miss the notification before it waits
+void AacEncoder::finishOutput() {
+    {
+        std::lock_guard<std::mutex> lock(mInputMutex);
+        mOutputDone.store(true);
+    }
+    mInputCv.notify_one();
+}
+
+// Until the first frame is queued, samples wait in the recording ring. A start
+// slower than the ring can hold means the beginning was lost.
+void AacEncoder::logFirstSampleLatency() const {
+    int64_t budgetNs = mReader.ringDurationNs();
+    int64_t latencyNs = mFirstSampleLatencyNs.load();
+
+    if (latencyNs > budgetNs) {
+        LOGE("First sample queued after %.1f ms, over the %.1f ms the ring holds",
+             latencyNs / 1e6, budgetNs / 1e6);
+    } else {
+        LOGI("First sample queued after %.1f ms", latencyNs / 1e6);
+    }
+}
+
+RecordingStats AacEncoder::stats() const {
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    return mStats;
+}
+
+void AacEncoder::logStats(int64_t wallNs) const {
+    int64_t cpuNs = mThreadCpuNs + mCallbackCpuNs.load();
+    double cpuPercent = wallNs > 0 ? 100.0 * cpuNs / wallNs : 0.0;
+    RecordingStats s = stats();
+
+    LOGI("%s encoder: CPU %.1f ms over %.1f s (%.2f%%), encode latency avg %.1f ms, max %.1f ms",
+         mMode == EncoderMode::Async ? "Async" : "Sync",
+         cpuNs / 1e6, wallNs / 1e9, cpuPercent,
+         s.encode.averageNs() / 1e6, s.encode.maxNs / 1e6);
+    LOGI("Queued %lld frames, wrote %lld bytes, muxer write avg %.2f ms, max %.2f ms",
+         (long long) s.framesQueued, (long long) s.bytesWritten,
+         s.write.averageNs() / 1e6, s.write.maxNs / 1e6);
+}
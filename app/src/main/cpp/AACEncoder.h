@@ -3,33 +3,141 @@
 #include <media/NdkMediaMuxer.h>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
 #include "PcmRingBuffer.h"
+#include "PcmStreamReader.h"
+#include "RecordingSink.h"
 
 
-class AacEncoder {
+enum class EncoderMode {
+    Sync,   // dequeue/queue polling from the encoder thread
+    Async   // AMediaCodec callback notification
+};
+
+class AacEncoder : public RecordingSink {
 public:
+    // encodeRate below sampleRate decimates the stream before encoding, 0
+    // keeps the stream rate. Bitrate 0 picks defaultBitrate() for the rate.
     AacEncoder(PcmRingBuffer& buffer,
                int sampleRate,
                int channels,
-               int fd);
+               int fd,
+               int encodeRate = 0,
+               int bitrate = 0,
+               bool fillGaps = true,
+               EncoderMode mode = EncoderMode::Sync);
+
+    static int defaultBitrate(int sampleRate, int channels);
+
+    // Creates and starts the codec ahead of start(), e.g. on a background
+    // thread. The fd may be given later through attach().
+    bool prepare();
+    void attach(int fd);
+
+    // Time from start() until the first frame went to the codec, -1 before
+    int64_t firstSampleLatencyNs() const {
+        return mFirstSampleLatencyNs.load();
+    }
+
+    // Set when the codec or muxer failed, a write or the muxer stop included,
+    // or the codec didn't finish within the EOS timeout. The output is then
+    // incomplete.
+    bool failed() const {
+        return mFailed.load();
+    }
+
+
+    void start() override;
+    void stop() override;
 
+    void setPreRoll(std::unique_ptr<PreRollSnapshot> snapshot) override {
+        mReader.setPreRoll(std::move(snapshot));
+    }
 
-    void start();
-    void stop();
+    RecordingStats stats() const override;
 
-    ~AacEncoder() {
+    ~AacEncoder() override {
         stop();
+        if (mCodec) {
+            // Prepared but never started
+            releaseCodec();
+        }
     }
 
 private:
     void encodeLoop();
+    void asyncEncodeLoop();
+
+    bool createCodec();
+    bool createMuxer();
+    bool openCodec();
+    void releaseCodec();
+
+    bool collectFrame();
+    void queueFrame(ssize_t inIdx);
+    void queueEos(ssize_t inIdx);
+    bool handleOutputFormat(AMediaFormat* format);
+    bool addTrack(AMediaFormat* format);
+    bool writeOutput(ssize_t outIdx, const AMediaCodecBufferInfo& info);
+
+    static void onAsyncInputAvailable(AMediaCodec* codec, void* userdata, int32_t index);
+    static void onAsyncOutputAvailable(AMediaCodec* codec, void* userdata, int32_t index,
+                                       AMediaCodecBufferInfo* info);
+    static void onAsyncFormatChanged(AMediaCodec* codec, void* userdata, AMediaFormat* format);
+    static void onAsyncError(AMediaCodec* codec, void* userdata, media_status_t error,
+                             int32_t actionCode, const char* detail);
+    void finishOutput();
+
+    void logFirstSampleLatency() const;
+    void logStats(int64_t wallNs) const;
 
-    PcmRingBuffer& mRing;
-    int mSampleRate;
+    PcmStreamReader mReader;
+    int mSampleRate;  // encoded rate, the stream rate may be higher
     int mChannels;
+    int mBitrate;
     int mFd;
+    EncoderMode mMode;
+
+    AMediaCodec* mCodec = nullptr;
+    // The format change can arrive on the callback thread before the muxer
+    // of a prepared codec exists
+    std::mutex mMuxerMutex;
+    AMediaMuxer* mMuxer = nullptr;
+    bool mMuxerStarted = false;
+    bool mFormatPending = false;
+    int mTrackIndex = -1;
+
+    // Frame being collected from the ring
+    std::vector<float> mFloatBuf;
+    std::vector<int16_t> mPcm16;
+    size_t mFilled = 0;
+
+    // PTS counts the frames read from the stream plus skipped gaps, so that
+    // dropped pushes and stream restarts don't shift everything after them.
+    int64_t mPtsFrames = 0;
+    int64_t mSkipFrames = 0;
+    bool mFlushPartial = false;
+
+    // Async mode: input buffers handed out by the codec, EOS seen on output
+    std::mutex mInputMutex;
+    std::condition_variable mInputCv;
+    std::deque<int32_t> mInputIndices;
+    std::atomic<bool> mOutputDone{false};
 
+    // Measurements: queue time of inputs still inside the codec, and the
+    // counters behind stats(), written from the encoder and callback threads
+    mutable std::mutex mStatsMutex;
+    std::deque<std::pair<int64_t, int64_t>> mPendingInputs;
+    RecordingStats mStats;
+    std::atomic<int64_t> mCallbackCpuNs{0};
+    int64_t mThreadCpuNs = 0;
+    int64_t mStartNs = 0;
+    std::atomic<int64_t> mFirstSampleLatencyNs{-1};  // read from other threads
 
     std::thread mThread;
     std::atomic<bool> mRunning{false};
-};
\ No newline at end of file
+    std::atomic<bool> mFailed{false};
+};
@@ -1,9 +1,18 @@
 #include "AudioEngine.h"
 #include "AACEncoder.h"
+#include "WavSink.h"
+#include "SegmentedSink.h"
 #include <android/log.h>
+#include <chrono>
+#include <algorithm>
 
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "test", __VA_ARGS__)
 
+// Channels recorded for a RecordingSource
+static int recordingChannels(int source) {
+    return static_cast<RecordingSource>(source) == RecordingSource::DryAndProcessed ? 2 : 1;
+}
+
 AudioEngine::AudioEngine() {
     initCallbacks();
     initGainProcessor();
@@ -77,6 +86,14 @@ bool AudioEngine::start() {
         return false;
     }
 
+    resetPreRoll();
+
+    // Everything the callback uses is set up & reserved before it starts running
+    setupSoundTouch();
+    setupDelayLine();
+    setupFrequencyShifter();
+    setupGainProcessor(outputStream->getSampleRate());
+
     dataCallback->setSharedInputStream(inputStream);
     dataCallback->setSharedOutputStream(outputStream);
 
@@ -85,25 +102,61 @@ bool AudioEngine::start() {
         cleanupStreams();
         return false;
     }
-    setupSoundTouch();
-    setupGainProcessor(outputStream->getSampleRate());
+
+    prepareRecording(lastRecordingConfig.source, lastRecordingConfig.recordRate,
+                     lastRecordingConfig.bitrate);
 
     return true;
 }
 
 void AudioEngine::setupSoundTouch() {
+    // The buffers stay reserved between the streams; release them to reconfigure
+    soundTouch.reserve(0);
+    // Set the pitch at once here, the later changes ramp (see processAudio)
+    soundTouch.setSetting(SETTING_PARAMETER_RAMP_MS, 0);
+
     soundTouch.setSampleRate(outputStream->getSampleRate());
     soundTouch.setChannels(1);
-    soundTouch.setPitch(pitch.load(std::memory_order_relaxed));
+    appliedPitch = pitch.load(std::memory_order_relaxed);
+    soundTouch.setPitch(appliedPitch);
     soundTouch.setTempo(1.0f);
 
-    soundTouch.setSetting(SETTING_USE_QUICKSEEK, 1);
     soundTouch.setSetting(SETTING_USE_AA_FILTER, 0);
     soundTouch.setSetting(SETTING_SEQUENCE_MS, 20);
     soundTouch.setSetting(SETTING_SEEKWINDOW_MS, 10);
     soundTouch.setSetting(SETTING_OVERLAP_MS, 5);
 
+    // Exhaustive overlap search, with all offsets correlated at once by FFT.
+    // Set after the window lengths so the FFT buffers are sized once, here.
+    soundTouch.setSetting(SETTING_USE_QUICKSEEK, 0);
+    soundTouch.setSetting(SETTING_USE_FFT_SEEK, 1);
+    // Voice input: try the offset in phase with the previous sequence first and
+    // only fall back to the exhaustive search when that doesn't match well.
+    soundTouch.setSetting(SETTING_USE_PREDICTIVE_SEEK, 1);
+    // Output each sequence as the input arrives instead of in 20 ms batches.
+    // 15 ms is the seek window plus overlap above, so the matching is unchanged.
+    soundTouch.setSetting(SETTING_LOW_LATENCY_MS, 15);
+
     soundTouch.clear();
+    soundTouch.setSetting(SETTING_PARAMETER_RAMP_MS, 50);
+
+    // Presize the buffers for the largest callback so that processing doesn't
+    // allocate memory on the audio thread. Pitch 0.5 .. 1.5 keeps the rate &
+    // tempo within 1/2 .. 2.
+    int maxFrames = inputStream->getBufferCapacityInFrames();
+    soundTouch.reserve(maxFrames, 2.0);
+    gainedInput.resize(maxFrames);
+}
+
+void AudioEngine::setupDelayLine() {
+    delayLine.prepare(outputStream->getSampleRate());
+    delayLine.setPitch(appliedPitch);
+}
+
+void AudioEngine::setupFrequencyShifter() {
+    frequencyShifter.prepare(outputStream->getSampleRate());
+    appliedShift = frequencyShift.load(std::memory_order_relaxed);
+    frequencyShifter.setShift(appliedShift);
 }
 
 void AudioEngine::setupGainProcessor(int sr) {
@@ -126,7 +179,8 @@ void AudioEngine::cleanupStreams() {
 }
 
 void AudioEngine::stop() {
-    stopRecording();
+    stopRecordingSink();
+    releasePreparedEncoder();
 
     dataCallback->stop();
 
@@ -134,6 +188,9 @@ void AudioEngine::stop() {
 
     ringBuffer.clear();
     soundTouch.clear();
+    delayLine.reset();
+    frequencyShifter.reset();
+    nextBlockPosition = -1;  // the next stream's first block re-anchors
 }
 
 oboe::DataCallbackResult AudioEngine::processAudio(
@@ -145,22 +202,91 @@ oboe::DataCallbackResult AudioEngine::processAudio(
     auto *input = static_cast<const float *>(inputData);
     auto *output = static_cast<float *>(outputData);
 
-    std::vector<float> gainedInput(numInputFrames);
+    // The engine taking over starts from silence rather than from the input it
+    // had when it was last used. None of the clears allocates.
+    PitchEngine newEngine = pitchEngine.load(std::memory_order_relaxed);
+    if (newEngine != appliedPitchEngine) {
+        appliedPitchEngine = newEngine;
+        soundTouch.clear();
+        delayLine.reset();
+        frequencyShifter.reset();
+    }
+
+    // Pitch changes apply here on the audio thread and glide to the new pitch
+    // over the ramp, without clearing the buffers or clicking.
+    float newPitch = pitch.load(std::memory_order_relaxed);
+    if (newPitch != appliedPitch) {
+        appliedPitch = newPitch;
+        // A pitch out of the range reserved in setupSoundTouch() is refused and
+        // SoundTouch stays at the last one
+        soundTouch.setPitch(newPitch);
+        delayLine.setPitch(newPitch);
+    }
+    float newShift = frequencyShift.load(std::memory_order_relaxed);
+    if (newShift != appliedShift) {
+        appliedShift = newShift;
+        frequencyShifter.setShift(newShift);
+    }
+
+    // Sized in setupSoundTouch() for the input buffer capacity, which no callback
+    // should exceed; resizing here would allocate on the audio thread
+    if (numInputFrames > static_cast<int>(gainedInput.size())) {
+        truncatedInputFrames.fetch_add(numInputFrames - static_cast<int>(gainedInput.size()),
+                                       std::memory_order_relaxed);
+        numInputFrames = static_cast<int>(gainedInput.size());
+    }
     for (int i = 0; i < numInputFrames; ++i) {
         gainedInput[i] = gainProcessor->process(input[i]);
     }
 
-    soundTouch.putSamples(gainedInput.data(), numInputFrames);
-    uint numReceived = soundTouch.receiveSamples(output, numOutputFrames);
+    uint numReceived;
+    if (appliedPitchEngine == PitchEngine::DelayLine) {
+        // Sample in, sample out: the frames beyond the input are silence
+        numReceived = std::min(numInputFrames, numOutputFrames);
+        delayLine.process(gainedInput.data(), output, numReceived);
+        pitchLatencyFrames.store(delayLine.latencyFrames(), std::memory_order_relaxed);
+    } else if (appliedPitchEngine == PitchEngine::FrequencyShift) {
+        numReceived = std::min(numInputFrames, numOutputFrames);
+        frequencyShifter.process(gainedInput.data(), output, numReceived);
+        pitchLatencyFrames.store(frequencyShifter.latencyFrames(), std::memory_order_relaxed);
+    } else {
+        // Exceptions can't leave the callback, so the reservation is checked
+        // without them. Output piled up beyond it, from callbacks that came with
+        // more input than output, is dropped to catch up.
+        if (!soundTouch.tryPutSamples(gainedInput.data(), numInputFrames)) {
+            pitchOverruns.fetch_add(1, std::memory_order_relaxed);
+            soundTouch.clear();
+            soundTouch.tryPutSamples(gainedInput.data(), numInputFrames);
+        }
+        numReceived = soundTouch.receiveSamples(output, numOutputFrames);
+        // The processing latency plus the output waiting for the next callback
+        pitchLatencyFrames.store(soundTouch.getSetting(SETTING_INITIAL_LATENCY) +
+                                 static_cast<int>(soundTouch.numSamples()),
+                                 std::memory_order_relaxed);
+    }
 
     if (numReceived < numOutputFrames) {
         std::fill(output + numReceived, output + numOutputFrames, 0.0f);
     }
 
     {
-        std::lock_guard<std::mutex> lock(encoderMutex);
-        if (encoder) {
-            ringBuffer.push(gainedInput.data(), numInputFrames);
+        std::lock_guard<std::mutex> lock(recordingMutex);
+        if (recordingSink || preRoll) {
+            PcmBlockInfo info = captureBlockInfo(numInputFrames);
+
+            // Both sides need the same length; a short block leaves a gap the
+            // sink fills in
+            int frames = std::min(numInputFrames, numOutputFrames);
+
+            if (preRoll) {
+                preRoll->append(gainedInput.data(), output, frames, info);
+            }
+
+            if (recordingSink && recordingSource == RecordingSource::DryAndProcessed) {
+                ringBuffer.pushInterleaved(gainedInput.data(), output, frames, info);
+            } else if (recordingSink) {
+                ringBuffer.push(gainedInput.data(), numInputFrames, info);
+            }
         }
     }
 
@@ -171,6 +297,37 @@ oboe::DataCallbackResult AudioEngine::processAudio(
     return oboe::DataCallbackResult::Continue;
 }
 
+// getTimestamp() goes down to the HAL, so the stream is only asked every
+// kReanchorBlocks blocks and after a discontinuity; blocks in between are timed
+// from the last anchor, which the frame position extrapolates from.
+PcmBlockInfo AudioEngine::captureBlockInfo(int numInputFrames) {
+    PcmBlockInfo info;
+    info.framePosition = inputStream->getFramesRead() - numInputFrames;
+
+    bool discontinuity = info.framePosition != nextBlockPosition;
+    nextBlockPosition = info.framePosition + numInputFrames;
+
+    if (discontinuity || !anchorFromStream || ++blocksSinceAnchor >= kReanchorBlocks) {
+        blocksSinceAnchor = 0;
+        auto timestamp = inputStream->getTimestamp(CLOCK_MONOTONIC);
+        anchorFromStream = static_cast<bool>(timestamp);
+        if (timestamp) {
+            anchorPosition = timestamp.value().position;
+            anchorTimeNs = timestamp.value().timestamp;
+        } else {
+            // No timestamp before the stream is fully running: the last frame
+            // of the block has just been read. Asked again on the next block.
+            anchorPosition = info.framePosition + numInputFrames;
+            anchorTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    info.anchorPosition = anchorPosition;
+    info.anchorTimeNs = anchorTimeNs;
+    return info;
+}
+
 void AudioEngine::handleStreamError(oboe::AudioStream* stream, oboe::Result error) {
     stop();
 }
@@ -197,10 +354,6 @@ void AudioEngine::setSampleRate(int value) {
 
 void AudioEngine::setPitch(float value) {
     pitch.store(value, std::memory_order_relaxed);
-
-    soundTouch.clear();
-    soundTouch.flush();
-    soundTouch.setPitch(value);
 }
 
 void AudioEngine::setGain(int value) {
@@ -212,29 +365,298 @@ void AudioEngine::setGainType(int value) {
     initGainProcessor();
 }
 
-void AudioEngine::startRecording(int fd) {
-    std::lock_guard<std::mutex> lock(encoderMutex);
+void AudioEngine::setPitchEngine(int value) {
+    pitchEngine.store(static_cast<PitchEngine>(value), std::memory_order_relaxed);
+}
+
+// Used by PitchEngine::FrequencyShift; the pitch applies to the other engines
+void AudioEngine::setFrequencyShift(float hz) {
+    frequencyShift.store(hz, std::memory_order_relaxed);
+}
+
+int AudioEngine::getPitchLatencyFrames() const {
+    return pitchLatencyFrames.load(std::memory_order_relaxed);
+}
+
+void AudioEngine::setPreRollSeconds(int value) {
+    preRollLength = std::clamp(value, 0, PreRollBuffer::kMaxSeconds);
+    resetPreRoll();
+}
 
-    if (encoder) {
-        encoder->stop();
+// Rebuilds the pre-roll history when its length or the stream rate changed.
+// The buffer is allocated and freed outside of the lock the audio thread takes.
+void AudioEngine::resetPreRoll() {
+    if (!outputStream) {
+        return;
     }
+    int rate = outputStream->getSampleRate();
 
-    ringBuffer.clear();
+    {
+        std::lock_guard<std::mutex> lock(recordingMutex);
+        if (preRoll ? preRoll->sampleRate() == rate && preRoll->seconds() == preRollLength
+                    : preRollLength == 0) {
+            return;
+        }
+    }
 
-    encoder = std::make_unique<AacEncoder>(
+    std::shared_ptr<PreRollBuffer> buffer;
+    if (preRollLength > 0) {
+        buffer = std::make_shared<PreRollBuffer>(rate, preRollLength);
+    }
+
+    std::lock_guard<std::mutex> lock(recordingMutex);
+    std::swap(preRoll, buffer);
+}
+
+// recordRate 0 records at the stream rate, lower rates are decimated to.
+// bitrate 0 lets the AAC encoder pick one for the rate. preRollSeconds of the
+// kept history are put in front of the recording.
+void AudioEngine::startRecording(int fd, int sinkType, int source, int recordRate, int bitrate,
+                                 int preRollSeconds) {
+    RecordingConfig config{source, recordRate, bitrate, outputStream->getSampleRate()};
+    lastRecordingConfig = config;
+
+    // Taken before the recording lock: a preparation still running is waited
+    // for, and the audio thread must not wait with it
+    std::unique_ptr<AacEncoder> prepared;
+    if (static_cast<RecordingSinkType>(sinkType) == RecordingSinkType::Aac) {
+        prepared = takePreparedEncoder(config);
+    }
+    stopRecordingSink();
+
+    std::unique_lock<std::mutex> lock(recordingMutex);
+    int channels = resetRecording(source);
+
+    if (prepared) {
+        prepared->attach(fd);
+        recordingSink = std::move(prepared);
+    } else if (static_cast<RecordingSinkType>(sinkType) == RecordingSinkType::Wav) {
+        recordingSink = std::make_unique<WavSink>(
+                ringBuffer,
+                outputStream->getSampleRate(),
+                channels,
+                fd,
+                recordRate
+        );
+    } else {
+        recordingSink = std::make_unique<AacEncoder>(
+                ringBuffer,
+                outputStream->getSampleRate(),
+                channels,
+                fd,
+                recordRate,
+                bitrate,
+                true,
+                EncoderMode::Async
+        );
+    }
+
+    startRecordingSink(lock, channels, preRollSeconds);
+}
+
+// Records into numbered AAC segments in directory, rolling over after
+// segmentSeconds or segmentBytes. 0 disables either limit.
+void AudioEngine::startSegmentedRecording(const std::string& directory,
+                                          int segmentSeconds, int64_t segmentBytes,
+                                          int source, int recordRate, int bitrate,
+                                          int preRollSeconds) {
+    stopRecordingSink();
+
+    // The first segment's file and codec are set up before the lock the audio
+    // thread takes; the sink is published once it only has to start threads
+    auto sink = std::make_unique<SegmentedSink>(
             ringBuffer,
             outputStream->getSampleRate(),
-            1,
-            fd
+            recordingChannels(source),
+            directory,
+            segmentSeconds,
+            segmentBytes,
+            recordRate,
+            bitrate
     );
-    encoder->start();
+    if (!sink->prepare()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(recordingMutex);
+    int channels = resetRecording(source);
+    recordingSink = std::move(sink);
+
+    startRecordingSink(lock, channels, preRollSeconds);
+}
+
+// Sets up the ring for a new source once the previous sink was stopped.
+// Returns the channel count of the recording. To be called with
+// recordingMutex held.
+int AudioEngine::resetRecording(int source) {
+    recordingSource = static_cast<RecordingSource>(source);
+    int channels = recordingChannels(source);
+
+    ringBuffer.clear();
+    ringBuffer.setChannels(channels);
+    ringBuffer.resetStats();
+    truncatedInputFrames.store(0, std::memory_order_relaxed);
+    pitchOverruns.store(0, std::memory_order_relaxed);
+    return channels;
+}
+
+// Called with lock held on recordingMutex right after the sink was set, so
+// that the pre-roll ends where the ring starts. The lock is let go while the
+// history is copied; the ring buffers the stream meanwhile.
+void AudioEngine::startRecordingSink(std::unique_lock<std::mutex>& lock, int channels,
+                                     int preRollSeconds) {
+    if (preRoll && preRollSeconds > 0) {
+        RecordingSink* sink = recordingSink.get();
+        std::shared_ptr<PreRollBuffer> history = preRoll;
+
+        int64_t frames = static_cast<int64_t>(preRollSeconds) * history->sampleRate();
+        std::unique_ptr<PreRollSnapshot> snapshot = history->snapshot(frames, channels, lock);
+        if (recordingSink.get() != sink) {
+            // Stopped while the lock was let go
+            return;
+        }
+        sink->setPreRoll(std::move(snapshot));
+    }
+    recordingSink->start();
 }
 
 void AudioEngine::stopRecording() {
-    std::lock_guard<std::mutex> lock(encoderMutex);
+    stopRecordingSink();
+
+    // Have an encoder ready for the next recording
+    prepareRecording(lastRecordingConfig.source, lastRecordingConfig.recordRate,
+                     lastRecordingConfig.bitrate);
+}
+
+// The sink is taken out under the lock, which stops the audio thread feeding
+// it, and stopped after: stopping drains the ring, joins the encoder threads
+// and syncs the files.
+void AudioEngine::stopRecordingSink() {
+    std::shared_ptr<RecordingSink> sink;
+    {
+        std::lock_guard<std::mutex> lock(recordingMutex);
+        std::swap(sink, recordingSink);
+    }
+    if (!sink) {
+        return;
+    }
+
+    sink->stop();
+    RecordingStats stats = collectRecordingStats(*sink);
+
+    std::lock_guard<std::mutex> lock(recordingMutex);
+    lastRecordingStats = stats;
+}
+
+// The sink's stats() takes the sink's own locks, which the audio callback
+// must not wait behind, so they are read after letting recordingMutex go
+RecordingStats AudioEngine::getRecordingStats() {
+    std::shared_ptr<RecordingSink> sink;
+    {
+        std::lock_guard<std::mutex> lock(recordingMutex);
+        if (!recordingSink) {
+            return lastRecordingStats;
+        }
+        sink = recordingSink;
+    }
+    return collectRecordingStats(*sink);
+}
+
+// Sink counters plus those of the ring feeding it and of the callback
+RecordingStats AudioEngine::collectRecordingStats(const RecordingSink& sink) const {
+    RecordingStats stats = sink.stats();
+    stats.droppedSamples += ringBuffer.droppedSamples();
+    stats.truncatedInputFrames = truncatedInputFrames.load(std::memory_order_relaxed);
+    stats.pitchOverruns = pitchOverruns.load(std::memory_order_relaxed);
+    stats.ringOccupancy = static_cast<int64_t>(ringBuffer.size());
+    stats.ringHighWater = static_cast<int64_t>(ringBuffer.highWaterMark());
+    stats.ringCapacity = static_cast<int64_t>(ringBuffer.capacitySamples());
+    return stats;
+}
+
+// Creates, configures and starts an AAC codec in the background, so that
+// startRecording() with the same configuration only has to attach the fd.
+void AudioEngine::prepareRecording(int source, int recordRate, int bitrate) {
+    if (!outputStream) {
+        return;
+    }
+
+    RecordingConfig config{source, recordRate, bitrate, outputStream->getSampleRate()};
+    int channels = recordingChannels(source);
+
+    std::lock_guard<std::mutex> lock(prepareMutex);
+    if (preparedEncoder.valid() && preparedConfig == config) {
+        return;
+    }
+
+    discardPreparedEncoder();
+    preparedConfig = config;
+    preparedEncoder = std::async(std::launch::async, [this, config, channels]() {
+        auto encoder = std::make_unique<AacEncoder>(
+                ringBuffer,
+                config.streamRate,
+                channels,
+                -1,
+                config.recordRate,
+                config.bitrate,
+                true,
+                EncoderMode::Async
+        );
+        if (!encoder->prepare()) {
+            // startRecording() falls back to a cold start
+            encoder = nullptr;
+        }
+        return encoder;
+    });
+}
 
-    if (encoder) {
-        encoder->stop();
-        encoder = nullptr;
+// Never waits: a preparation still running would take as long as the cold
+// start it is meant to save. It is kept for the next recording instead.
+std::unique_ptr<AacEncoder> AudioEngine::takePreparedEncoder(const RecordingConfig& config) {
+    std::lock_guard<std::mutex> lock(prepareMutex);
+
+    if (!preparedEncoder.valid()) {
+        return nullptr;
+    }
+
+    if (!(preparedConfig == config)) {
+        LOGD("Prepared encoder doesn't match the recording, starting cold");
+        discardPreparedEncoder();
+        return nullptr;
+    }
+    if (preparedEncoder.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        LOGD("Prepared encoder not ready yet, starting cold");
+        return nullptr;
+    }
+    return preparedEncoder.get();
+}
+
+// Tearing a codec down takes about as long as setting it up, so an encoder
+// prepared for another configuration is waited for and freed in the
+// background. To be called with prepareMutex held.
+void AudioEngine::discardPreparedEncoder() {
+    if (preparedEncoder.valid()) {
+        discardedEncoders.push_back(std::async(std::launch::async,
+                [pending = std::move(preparedEncoder)]() mutable {
+                    pending.get();
+                }));
+    }
+
+    // Forget the ones that are done
+    discardedEncoders.erase(std::remove_if(discardedEncoders.begin(), discardedEncoders.end(),
+            [](std::future<void>& f) {
+                return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            }), discardedEncoders.end());
+}
+
+void AudioEngine::releasePreparedEncoder() {
+    std::lock_guard<std::mutex> lock(prepareMutex);
+
+    if (preparedEncoder.valid()) {
+        preparedEncoder.get();
+    }
+    for (auto& discarded : discardedEncoders) {
+        discarded.wait();
     }
+    discardedEncoders.clear();
 }
\ No newline at end of file
@@ -3,17 +3,31 @@
 #include <oboe/Oboe.h>
 #include <fstream>
 #include <vector>
+#include <string>
 #include <mutex>
 #include <atomic>
+#include <future>
 #include "soundtouch/include/SoundTouch.h"
 #include "PcmRingBuffer.h"
+#include "RecordingSink.h"
 #include "AACEncoder.h"
+#include "PreRollBuffer.h"
 #include "AudioDataCallback.h"
 #include "AudioStreamErrorHandler.h"
 #include "GainProcessor.h"
+#include "DelayLinePitchShifter.h"
+#include "FrequencyShifter.h"
 
 using namespace soundtouch;
 
+// Processing behind the monitor: pitch shifting by SoundTouch's WSOLA or by the
+// delay line for the lowest latency at a lower quality, or a frequency shift
+enum class PitchEngine {
+    SoundTouch = 0,
+    DelayLine = 1,
+    FrequencyShift = 2
+};
+
 class AudioEngine {
 
 public:
@@ -31,10 +45,25 @@ public:
     void setPitch(float value);
     void setGain(int value);
     void setGainType(int value);
+    void setPitchEngine(int value);
+    void setFrequencyShift(float hz);
+
+    // Frames the pitch engine delays the monitor by, as of the last callback
+    int getPitchLatencyFrames() const;
 
-    void startRecording(int fd);
+    void setPreRollSeconds(int value);
+    void prepareRecording(int source, int recordRate, int bitrate);
+    void startRecording(int fd, int sinkType, int source, int recordRate, int bitrate,
+                        int preRollSeconds);
+    void startSegmentedRecording(const std::string& directory,
+                                 int segmentSeconds, int64_t segmentBytes,
+                                 int source, int recordRate, int bitrate,
+                                 int preRollSeconds);
     void stopRecording();
 
+    // Counters of the running recording, or of the last one once stopped
+    RecordingStats getRecordingStats();
+
     oboe::DataCallbackResult processAudio(
             const void *inputData,
             int numInputFrames,
@@ -45,11 +74,48 @@ public:
 
 private:
     SoundTouch soundTouch;
-    PcmRingBuffer ringBuffer;
+    std::vector<float> gainedInput;  // input block with the gain applied
+    DelayLinePitchShifter delayLine;
+    FrequencyShifter frequencyShifter;
+    float appliedShift = 0.0f;       // set on frequencyShifter by the audio thread
+    float appliedPitch = 1.0f;       // pitch set on the engines by the audio thread
+    PitchEngine appliedPitchEngine = PitchEngine::SoundTouch;
+    PcmRingBuffer ringBuffer{8192};  // ~85 ms of stereo at 48 kHz
     std::unique_ptr<GainProcessor> gainProcessor;
 
-    std::unique_ptr<AacEncoder> encoder;
-    std::mutex encoderMutex;
+    std::shared_ptr<RecordingSink> recordingSink;  // shared with a stats read
+    RecordingStats lastRecordingStats;
+    RecordingSource recordingSource = RecordingSource::Dry;
+    std::shared_ptr<PreRollBuffer> preRoll;  // shared with a snapshot being copied
+
+    // AAC encoder created ahead of startRecording() for this configuration
+    struct RecordingConfig {
+        int source = 0;
+        int recordRate = 0;
+        int bitrate = 0;
+        int streamRate = 0;
+
+        bool operator==(const RecordingConfig& other) const {
+            return source == other.source && recordRate == other.recordRate &&
+                   bitrate == other.bitrate && streamRate == other.streamRate;
+        }
+    };
+    std::future<std::unique_ptr<AacEncoder>> preparedEncoder;
+    RecordingConfig preparedConfig;
+    std::vector<std::future<void>> discardedEncoders;  // being freed in the background
+    RecordingConfig lastRecordingConfig;
+    std::mutex prepareMutex;
+    int preRollLength = 0;  // seconds of history kept
+    std::mutex recordingMutex;
+
+    // Capture timestamp anchor reused between the getTimestamp() calls of
+    // captureBlockInfo(); audio thread only
+    static constexpr int kReanchorBlocks = 64;
+    int64_t anchorPosition = 0;
+    int64_t anchorTimeNs = 0;
+    int64_t nextBlockPosition = -1;  // where the next block continues the last
+    int blocksSinceAnchor = 0;
+    bool anchorFromStream = false;
 
     std::unique_ptr<AudioDataCallback> dataCallback;
     std::unique_ptr<AudioStreamErrorHandler> errorHandler;
@@ -61,11 +127,28 @@ private:
     int inputDeviceId = oboe::kUnspecified;
     int outputDeviceId = oboe::kUnspecified;
     std::atomic<float> pitch{1.0f};
+    std::atomic<float> frequencyShift{0.0f};
+    std::atomic<PitchEngine> pitchEngine{PitchEngine::SoundTouch};
+    std::atomic<int> pitchLatencyFrames{0};
+    // Input lost by the audio callback, counted for the recording stats
+    std::atomic<int64_t> truncatedInputFrames{0};
+    std::atomic<int64_t> pitchOverruns{0};
     int gainProcessorType = 0;
 
     void initCallbacks();
     void initGainProcessor();
     void setupSoundTouch();
+    void setupDelayLine();
+    void setupFrequencyShifter();
     void setupGainProcessor(int sr);
+    PcmBlockInfo captureBlockInfo(int numInputFrames);
+    void resetPreRoll();
+    int resetRecording(int source);
+    void startRecordingSink(std::unique_lock<std::mutex>& lock, int channels, int preRollSeconds);
+    void stopRecordingSink();
+    RecordingStats collectRecordingStats(const RecordingSink& sink) const;
+    std::unique_ptr<AacEncoder> takePreparedEncoder(const RecordingConfig& config);
+    void discardPreparedEncoder();
+    void releasePreparedEncoder();
     void cleanupStreams();
 };
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "DelayLinePitchShifter.h"
+#include <cmath>
+#include <algorithm>
+
+// The cubic read needs two samples after the read position
+static constexpr float MIN_DELAY = 2.0f;
+
+// At pitch 1 the taps glide to the nominal delay at this pitch deviation, so
+// that one tap plays on its own instead of two combing with each other
+static constexpr double SETTLE_RATE = 0.02;
+
+void DelayLinePitchShifter::prepare(int sampleRate, float windowMs) {
+    window = std::max(1.0f, std::round(sampleRate * windowMs / 1000.0f));
+
+    unsigned size = 4;
+    while (size < static_cast<unsigned>(window + MIN_DELAY) + 4) {
+        size <<= 1;
+    }
+    line.assign(size, 0.0f);
+    mask = size - 1;
+    reset();
+}
+
+void DelayLinePitchShifter::reset() {
+    std::fill(line.begin(), line.end(), 0.0f);
+    writePos = 0;
+    phase = 0.5;
+}
+
+int DelayLinePitchShifter::latencyFrames() const {
+    return static_cast<int>(std::lround(MIN_DELAY + window * 0.5f));
+}
+
+// Catmull-Rom interpolated sample delay frames behind the newest one
+float DelayLinePitchShifter::tap(float delay) const {
+    float pos = static_cast<float>(writePos + line.size()) - delay;
+    auto i = static_cast<unsigned>(pos);
+    float t = pos - static_cast<float>(i);
+
+    float xm1 = line[(i - 1) & mask];
+    float x0 = line[i & mask];
+    float x1 = line[(i + 1) & mask];
+    float x2 = line[(i + 2) & mask];
+
+    float c1 = 0.5f * (x1 - xm1);
+    float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+    float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+    return ((c3 * t + c2) * t + c1) * t + x0;
+}
+
+void DelayLinePitchShifter::process(const float* in, float* out, int count) {
+    // Reading at pitch times the input rate means the delay grows by 1 - pitch
+    // per sample
+    double step = (1.0 - pitch) / window;
+    bool settle = std::fabs(step) * window < 1e-4;
+
+    for (int i = 0; i < count; ++i) {
+        line[writePos] = in[i];
+
+        double phase2 = phase < 0.5 ? phase + 0.5 : phase - 0.5;
+        // Smoothstep up to the middle of the sweep and back down: the first tap
+        // is silent where its delay jumps, and the second where it plays alone
+        float x = 1.0f - std::fabs(2.0f * static_cast<float>(phase) - 1.0f);
+        float weight = x * x * (3.0f - 2.0f * x);
+        out[i] = weight * tap(MIN_DELAY + static_cast<float>(phase) * window) +
+                 (1.0f - weight) * tap(MIN_DELAY + static_cast<float>(phase2) * window);
+
+        writePos = (writePos + 1) & mask;
+
+        if (settle) {
+            double maxStep = SETTLE_RATE / window;
+            phase += std::clamp(0.5 - phase, -maxStep, maxStep);
+        } else {
+            phase += step;
+            if (phase >= 1.0) {
+                phase -= 1.0;
+            } else if (phase < 0.0) {
+                phase += 1.0;
+            }
+        }
+    }
+}
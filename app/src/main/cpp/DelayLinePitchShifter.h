@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+// Pitch shifter for live monitoring at a few milliseconds of latency. Two taps
+// read a short delay line, their delays sweeping across a window at the rate
+// that shifts the pitch. A tap fades out as its delay reaches the end of the
+// window and jumps back while the other one, half a window apart, carries the
+// sound. Every sample costs the same and nothing waits for a block of input.
+// The price is a flutter at the sweep rate, and on steady tones a pitch that
+// the unmatched splices pull a few percent off; WSOLA avoids both by matching
+// the waveform at each splice.
+class DelayLinePitchShifter {
+public:
+    static constexpr float kDefaultWindowMs = 8.0f;
+
+    // Sizes the delay line for the stream rate. Allocates, so it's called
+    // before the stream starts rather than from the audio callback.
+    void prepare(int sampleRate, float windowMs = kDefaultWindowMs);
+
+    // Takes effect from the next sample on. Only the slope of the delay sweep
+    // changes, so a new pitch doesn't click.
+    void setPitch(float value) {
+        pitch = value;
+    }
+
+    // Shifts count mono samples from in to out, which may be the same buffer.
+    void process(const float* in, float* out, int count);
+
+    // Silences the delay line and restarts the sweep at the nominal delay.
+    void reset();
+
+    // Delay of the output behind the input in frames. It doesn't depend on the
+    // pitch or on the input: the taps average half a window plus the minimum
+    // delay over a sweep, and rest exactly there at pitch 1.
+    int latencyFrames() const;
+
+private:
+    std::vector<float> line;  // power of two length, indexed through mask
+    unsigned mask = 0;
+    unsigned writePos = 0;    // where the next input sample goes
+
+    float window = 0.0f;      // sweep length in frames
+    double phase = 0.5;       // of the first tap across the window, 0 .. 1
+    float pitch = 1.0f;
+
+    float tap(float delay) const;
+};
@@ -0,0 +1,208 @@
+#include "FrequencyShifter.h"
+#include <cmath>
+#include <complex>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Olli Niemitalo's allpass pair: the outputs stay within a degree of 90° apart
+// from about 0.1% to 99.9% of the Nyquist frequency. These are the squared
+// coefficients of the published design.
+static const float COEFFS_A[] = {
+        0.16175849836770f, 0.73302893234149f, 0.94534970032911f, 0.99059915668453f
+};
+static const float COEFFS_B[] = {
+        0.47940086558884f, 0.87621849353931f, 0.97659758950819f, 0.99749925593555f
+};
+
+// The phasors drift off the unit circle by rounding; a first order correction
+// every this many blocks of four puts them back
+static constexpr int RENORMALIZE_BLOCKS = 64;
+
+static constexpr double PI = 3.14159265358979323846;
+
+static constexpr double LATENCY_HZ = 500.0;
+
+// Phase response of an allpass chain at omega radians per sample
+static double chainPhase(const float* coeffs, int stages, double omega) {
+    std::complex<double> z2 = std::polar(1.0, -2.0 * omega);
+    std::complex<double> h = 1.0;
+    for (int i = 0; i < stages; ++i) {
+        h *= (static_cast<double>(coeffs[i]) - z2) / (1.0 - static_cast<double>(coeffs[i]) * z2);
+    }
+    return std::arg(h);
+}
+
+FrequencyShifter::FrequencyShifter() {
+    for (int i = 0; i < kStages; ++i) {
+        coeffs[i][0] = coeffs[i][1] = COEFFS_A[i];
+        coeffs[i][2] = coeffs[i][3] = COEFFS_B[i];
+    }
+    reset();
+}
+
+void FrequencyShifter::prepare(int rate) {
+    sampleRate = rate;
+    setShift(shift);
+
+    double omega = 2.0 * PI * LATENCY_HZ / rate;
+    double delta = omega * 1e-3;
+    double phaseStep = chainPhase(COEFFS_A, kStages, omega - delta) -
+                       chainPhase(COEFFS_A, kStages, omega + delta);
+    latency = static_cast<int>(std::lround(std::remainder(phaseStep, 2.0 * PI) / (2.0 * delta)));
+}
+
+void FrequencyShifter::setShift(float hz) {
+    shift = hz;
+    double omega = 2.0 * PI * hz / sampleRate;
+    for (int r = 0; r < 4; ++r) {
+        stepRe[r] = static_cast<float>(std::cos(omega * (r + 1)));
+        stepIm[r] = static_cast<float>(std::sin(omega * (r + 1)));
+    }
+    // Respace the phasors behind the first one, which keeps its phase
+    for (int k = 1; k < 4; ++k) {
+        oscRe[k] = oscRe[0] * stepRe[k - 1] - oscIm[0] * stepIm[k - 1];
+        oscIm[k] = oscRe[0] * stepIm[k - 1] + oscIm[0] * stepRe[k - 1];
+    }
+}
+
+void FrequencyShifter::reset() {
+    for (int i = 0; i < kStages; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            prevIn[i][k] = prevOut[i][k] = 0.0f;
+        }
+    }
+    delayedB = 0.0f;
+    oscRe[0] = 1.0f;
+    oscIm[0] = 0.0f;
+    blocksSinceRenormalize = 0;
+    setShift(shift);
+}
+
+// Runs samples x0 & x1 through both chains, giving their in-phase & quadrature
+// parts
+void FrequencyShifter::filterPair(float x0, float x1, float* re, float* im) {
+    alignas(16) float v[4] = {x0, x1, x0, x1};
+#if defined(__ARM_NEON)
+    float32x4_t x = vld1q_f32(v);
+    for (int i = 0; i < kStages; ++i) {
+        float32x4_t y = vsubq_f32(vmulq_f32(vld1q_f32(coeffs[i]),
+                                            vaddq_f32(x, vld1q_f32(prevOut[i]))),
+                                  vld1q_f32(prevIn[i]));
+        vst1q_f32(prevIn[i], x);
+        vst1q_f32(prevOut[i], y);
+        x = y;
+    }
+    vst1q_f32(v, x);
+#else
+    for (int i = 0; i < kStages; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            float y = coeffs[i][k] * (v[k] + prevOut[i][k]) - prevIn[i][k];
+            prevIn[i][k] = v[k];
+            prevOut[i][k] = y;
+            v[k] = y;
+        }
+    }
+#endif
+    re[0] = v[0];
+    re[1] = v[1];
+    im[0] = delayedB;
+    im[1] = v[2];
+    delayedB = v[3];
+}
+
+// One sample on its own, in lanes 0 & 2. The lanes are swapped after it so that
+// the next pair again finds its older state in lanes 0 & 2.
+void FrequencyShifter::filterSingle(float x, float& re, float& im) {
+    float a = x;
+    float b = x;
+    for (int i = 0; i < kStages; ++i) {
+        float ya = coeffs[i][0] * (a + prevOut[i][0]) - prevIn[i][0];
+        float yb = coeffs[i][2] * (b + prevOut[i][2]) - prevIn[i][2];
+        prevIn[i][0] = prevIn[i][1];
+        prevIn[i][1] = a;
+        prevIn[i][2] = prevIn[i][3];
+        prevIn[i][3] = b;
+        prevOut[i][0] = prevOut[i][1];
+        prevOut[i][1] = ya;
+        prevOut[i][2] = prevOut[i][3];
+        prevOut[i][3] = yb;
+        a = ya;
+        b = yb;
+    }
+    re = a;
+    im = delayedB;
+    delayedB = b;
+}
+
+// Takes the real part of the analytic signal times the oscillator, and
+// advances the phasors by four samples
+void FrequencyShifter::modulate(const float* re, const float* im, float* out) {
+#if defined(__ARM_NEON)
+    float32x4_t oRe = vld1q_f32(oscRe);
+    float32x4_t oIm = vld1q_f32(oscIm);
+    vst1q_f32(out, vmlsq_f32(vmulq_f32(vld1q_f32(re), oRe), vld1q_f32(im), oIm));
+
+    float32x4_t sRe = vdupq_n_f32(stepRe[3]);
+    float32x4_t sIm = vdupq_n_f32(stepIm[3]);
+    vst1q_f32(oscRe, vmlsq_f32(vmulq_f32(oRe, sRe), oIm, sIm));
+    vst1q_f32(oscIm, vmlaq_f32(vmulq_f32(oRe, sIm), oIm, sRe));
+#else
+    // Plain lanes the compiler can keep in one vector
+    for (int k = 0; k < 4; ++k) {
+        out[k] = re[k] * oscRe[k] - im[k] * oscIm[k];
+    }
+    for (int k = 0; k < 4; ++k) {
+        float r = oscRe[k] * stepRe[3] - oscIm[k] * stepIm[3];
+        oscIm[k] = oscRe[k] * stepIm[3] + oscIm[k] * stepRe[3];
+        oscRe[k] = r;
+    }
+#endif
+}
+
+void FrequencyShifter::renormalize() {
+    for (int k = 0; k < 4; ++k) {
+        float gain = 1.5f - 0.5f * (oscRe[k] * oscRe[k] + oscIm[k] * oscIm[k]);
+        oscRe[k] *= gain;
+        oscIm[k] *= gain;
+    }
+    blocksSinceRenormalize = 0;
+}
+
+void FrequencyShifter::process(const float* in, float* out, int count) {
+    alignas(16) float re[4];
+    alignas(16) float im[4];
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        filterPair(in[i], in[i + 1], re, im);
+        filterPair(in[i + 2], in[i + 3], re + 2, im + 2);
+        modulate(re, im, out + i);
+        if (++blocksSinceRenormalize == RENORMALIZE_BLOCKS) {
+            renormalize();
+        }
+    }
+
+    int rest = count - i;
+    if (rest > 0) {
+        int k = 0;
+        if (rest >= 2) {
+            filterPair(in[i], in[i + 1], re, im);
+            k = 2;
+        }
+        if (k < rest) {
+            filterSingle(in[i + k], re[k], im[k]);
+        }
+        for (k = 0; k < rest; ++k) {
+            out[i + k] = re[k] * oscRe[k] - im[k] * oscIm[k];
+        }
+        // Move the phasors on by the samples used, to stay a sample apart
+        // from the next block's start
+        for (k = 0; k < 4; ++k) {
+            float r = oscRe[k] * stepRe[rest - 1] - oscIm[k] * stepIm[rest - 1];
+            oscIm[k] = oscRe[k] * stepIm[rest - 1] + oscIm[k] * stepRe[rest - 1];
+            oscRe[k] = r;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Single-sideband frequency shifter: moves every component of the input by the
+// same number of hertz, which unlike a pitch shift breaks the harmonic spacing
+// of the voice. Two allpass chains turn the input into a pair of signals 90°
+// apart, and multiplying that pair by a complex oscillator keeps one sideband.
+// Nothing is buffered, so the only delay is the chains' group delay, well
+// under a millisecond over most of the voice band; there's no allocation and
+// every sample costs the same.
+class FrequencyShifter {
+public:
+    FrequencyShifter();
+
+    // Takes the stream rate the shift is in hertz of
+    void prepare(int sampleRate);
+
+    // Shift in hertz, negative downwards. The oscillator keeps its phase, so a
+    // change doesn't click.
+    void setShift(float hz);
+
+    // Shifts count mono samples from in to out, which may be the same buffer.
+    void process(const float* in, float* out, int count);
+
+    // Clears the allpass state and restarts the oscillator.
+    void reset();
+
+    // Group delay in frames at 500 Hz, amid the voice energy. It's fixed by the
+    // stream rate; lower frequencies come out later, ~2.5 ms at 100 Hz.
+    int latencyFrames() const {
+        return latency;
+    }
+
+private:
+    static constexpr int kStages = 4;
+
+    // Allpass sections y = c (x + y'') - x''. They only reach two samples back,
+    // so even and odd samples go through them independently: the four lanes are
+    // the in-phase chain on an even and an odd sample, then the quadrature chain
+    // on the same two. Lanes 0 and 2 hold the older sample of the state.
+    alignas(16) float coeffs[kStages][4];
+    alignas(16) float prevIn[kStages][4];
+    alignas(16) float prevOut[kStages][4];
+    float delayedB = 0.0f;  // the quadrature chain is a sample behind
+
+    // Four phasors a sample apart, for four outputs at a time, and the rotation
+    // by one to four samples at the current shift
+    alignas(16) float oscRe[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    alignas(16) float oscIm[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float stepRe[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float stepIm[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    int blocksSinceRenormalize = 0;
+
+    int sampleRate = 48000;
+    float shift = 0.0f;
+    int latency = 0;
+
+    void filterPair(float x0, float x1, float* re, float* im);
+    void filterSingle(float x, float& re, float& im);
+    void modulate(const float* re, const float* im, float* out);
+    void renormalize();
+};
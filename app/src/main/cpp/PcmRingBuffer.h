@@ -1,35 +1,60 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <atomic>
 #include <algorithm>
 
+// Stream position and capture time of a block of samples written to the ring.
+// The capture time follows oboe::FrameTimestamp semantics: it is the time of
+// anchorPosition, which doesn't have to be the first frame of the block.
+struct PcmBlockInfo {
+    int64_t framePosition = 0;
+    int64_t anchorPosition = 0;
+    int64_t anchorTimeNs = 0;
+};
+
 class PcmRingBuffer {
 public:
     PcmRingBuffer() : PcmRingBuffer(4096) {}
 
     explicit PcmRingBuffer(size_t capacity)
-            : buffer(capacity), capacity(capacity) {}
+            : buffer(capacity), capacity(capacity), blocks(kMaxBlocks) {}
 
-    bool push(const float* data, size_t count) {
-        size_t free = capacity - size();
-        if (count > free) return false;
+    bool push(const float* data, size_t count, const PcmBlockInfo& info) {
+        return pushBlock(count, info, [data](size_t i) { return data[i]; });
+    }
 
-        for (size_t i = 0; i < count; ++i) {
-            buffer[writeIndex.load(std::memory_order_relaxed)] = data[i];
-            writeIndex.store((writeIndex.load(std::memory_order_relaxed) + 1) % capacity,
-                             std::memory_order_relaxed);
-        }
-        writeCounter.fetch_add(count, std::memory_order_release);
-        return true;
+    // Pushes frames of two channels held in separate buffers, interleaving
+    // them on the way into the ring instead of through a temporary buffer.
+    bool pushInterleaved(const float* left, const float* right, size_t frames,
+                         const PcmBlockInfo& info) {
+        return pushBlock(frames * 2, info, [left, right](size_t i) {
+            return (i & 1) ? right[i >> 1] : left[i >> 1];
+        });
+    }
+
+    // Block positions count frames of this many samples. Only to be changed
+    // while nothing is pushed, e.g. right after clear().
+    void setChannels(int value) {
+        channels = static_cast<size_t>(value);
     }
 
-    size_t pop(float* out, size_t count) {
+    // Pops up to count samples. When info is given, it receives the position of
+    // the first popped sample and the read stops short of the next discontinuity,
+    // so every popped run is contiguous in stream time.
+    size_t pop(float* out, size_t count, PcmBlockInfo* info = nullptr) {
         size_t available = size();
         size_t toRead = std::min(count, available);
 
+        retireBlocks();
+        if (info && toRead > 0) {
+            peek(*info);
+            toRead = std::min(toRead, contiguousSize());
+        }
+
         for (size_t i = 0; i < toRead; ++i) {
             out[i] = buffer[readIndex.load(std::memory_order_relaxed)];
             readIndex.store((readIndex.load(std::memory_order_relaxed) + 1) % capacity,
@@ -39,23 +64,139 @@ public:
         return toRead;
     }
 
+    // Describes the next sample to be popped without consuming it.
+    bool peek(PcmBlockInfo& info) {
+        if (size() == 0) return false;
+
+        retireBlocks();
+        size_t blockRead = blockReadCounter.load(std::memory_order_relaxed);
+        if (blockRead == blockWriteCounter.load(std::memory_order_acquire)) return false;
+
+        const Block& block = blocks[blockRead % kMaxBlocks];
+        size_t offset = readCounter.load(std::memory_order_relaxed) - block.start;
+
+        info = block.info;
+        info.framePosition += static_cast<int64_t>(offset / channels);
+        return true;
+    }
+
+    size_t capacityFrames() const {
+        return capacity / channels;
+    }
+
     size_t size() const {
         return writeCounter.load(std::memory_order_acquire) -
                readCounter.load(std::memory_order_acquire);
     }
 
+    size_t capacitySamples() const {
+        return capacity;
+    }
+
+    // Most samples ever held at once and samples rejected by a full ring,
+    // both updated by the writer only.
+    size_t highWaterMark() const {
+        return highWater.load(std::memory_order_relaxed);
+    }
+
+    int64_t droppedSamples() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    void resetStats() {
+        highWater.store(0, std::memory_order_relaxed);
+        dropped.store(0, std::memory_order_relaxed);
+    }
+
     void clear() {
         readCounter.store(writeCounter.load(std::memory_order_relaxed),
                           std::memory_order_relaxed);
         readIndex.store(writeIndex.load(std::memory_order_relaxed),
                         std::memory_order_relaxed);
+        blockReadCounter.store(blockWriteCounter.load(std::memory_order_relaxed),
+                               std::memory_order_release);
     }
 
 private:
+    static constexpr size_t kMaxBlocks = 256;
+
+    struct Block {
+        size_t start = 0;
+        PcmBlockInfo info;
+    };
+
+    template <typename Sample>
+    bool pushBlock(size_t count, const PcmBlockInfo& info, Sample sample) {
+        size_t free = capacity - size();
+        size_t blockWrite = blockWriteCounter.load(std::memory_order_relaxed);
+        if (count > free ||
+            blockWrite - blockReadCounter.load(std::memory_order_acquire) >= kMaxBlocks) {
+            dropped.fetch_add(static_cast<int64_t>(count), std::memory_order_relaxed);
+            return false;
+        }
+
+        Block& block = blocks[blockWrite % kMaxBlocks];
+        block.start = writeCounter.load(std::memory_order_relaxed);
+        block.info = info;
+
+        for (size_t i = 0; i < count; ++i) {
+            buffer[writeIndex.load(std::memory_order_relaxed)] = sample(i);
+            writeIndex.store((writeIndex.load(std::memory_order_relaxed) + 1) % capacity,
+                             std::memory_order_relaxed);
+        }
+        blockWriteCounter.store(blockWrite + 1, std::memory_order_release);
+        writeCounter.fetch_add(count, std::memory_order_release);
+
+        size_t held = capacity - free + count;
+        if (held > highWater.load(std::memory_order_relaxed)) {
+            highWater.store(held, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Drops descriptors of blocks that have been read completely.
+    void retireBlocks() {
+        size_t read = readCounter.load(std::memory_order_relaxed);
+        size_t blockRead = blockReadCounter.load(std::memory_order_relaxed);
+        size_t blockWrite = blockWriteCounter.load(std::memory_order_acquire);
+
+        while (blockRead + 1 < blockWrite && blocks[(blockRead + 1) % kMaxBlocks].start <= read) {
+            ++blockRead;
+        }
+        blockReadCounter.store(blockRead, std::memory_order_release);
+    }
+
+    // Number of samples from the read position up to the first block that
+    // doesn't continue the stream position of its predecessor.
+    size_t contiguousSize() const {
+        size_t read = readCounter.load(std::memory_order_relaxed);
+        size_t blockRead = blockReadCounter.load(std::memory_order_relaxed);
+        size_t blockWrite = blockWriteCounter.load(std::memory_order_acquire);
+
+        for (size_t i = blockRead; i + 1 < blockWrite; ++i) {
+            const Block& cur = blocks[i % kMaxBlocks];
+            const Block& next = blocks[(i + 1) % kMaxBlocks];
+            int64_t expected = cur.info.framePosition +
+                               static_cast<int64_t>((next.start - cur.start) / channels);
+            if (next.info.framePosition != expected) {
+                return next.start - read;
+            }
+        }
+        return SIZE_MAX;
+    }
+
     std::vector<float> buffer;
     size_t capacity;
+    size_t channels = 1;
     std::atomic<size_t> writeCounter{0};
     std::atomic<size_t> readCounter{0};
     std::atomic<size_t> writeIndex{0};
     std::atomic<size_t> readIndex{0};
-};
\ No newline at end of file
+
+    std::vector<Block> blocks;
+    std::atomic<size_t> blockWriteCounter{0};
+    std::atomic<size_t> blockReadCounter{0};
+
+    std::atomic<size_t> highWater{0};
+    std::atomic<int64_t> dropped{0};
+};
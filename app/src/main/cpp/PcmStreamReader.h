@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "PcmRingBuffer.h"
+#include "PolyphaseDecimator.h"
+#include "PreRollBuffer.h"
+
+// Reads the recording ring as a continuous stream. Discontinuities between
+// blocks (dropped pushes, stream restarts) are either filled with silence or
+// reported as skipped frames, so recording sinks can keep file time in line
+// with wall-clock time. When outputRate is below the stream rate, samples are
+// decimated to it on the way out.
+class PcmStreamReader {
+public:
+    static constexpr int64_t kMaxGapFillSec = 10;  // longer gaps are skipped instead
+
+    PcmStreamReader(PcmRingBuffer& ring, int sampleRate, int channels, bool fillGaps,
+                    int outputRate = 0)
+            : ring(ring), sampleRate(sampleRate), channels(channels), fillGaps(fillGaps) {
+        if (outputRate > 0 && outputRate < sampleRate) {
+            decimator = std::make_unique<PolyphaseDecimator>(sampleRate, outputRate, channels);
+            streamBuf.resize(kDecimateChunkFrames * channels);
+            decimatedBuf.resize(decimator->maxOutput(streamBuf.size()));
+        }
+    }
+
+    // How long the ring can buffer the stream before pushes fail
+    int64_t ringDurationNs() const {
+        return static_cast<int64_t>(ring.capacityFrames()) * 1000000000LL / sampleRate;
+    }
+
+    // Rate of the samples returned by read()
+    int outputRate() const {
+        return decimator ? decimator->outRate() : sampleRate;
+    }
+
+    // Reads up to count samples at the output rate, never across a
+    // discontinuity. Returns 0 and sets skippedFrames, also at the output
+    // rate, when a gap has to be skipped rather than filled.
+    size_t read(float* out, size_t count, int64_t& skippedFrames) {
+        if (!decimator) {
+            return readStream(out, count, skippedFrames);
+        }
+
+        skippedFrames = 0;
+        if (decimatedPos == decimatedCount) {
+            size_t read = readStream(streamBuf.data(), streamBuf.size(), skippedFrames);
+            if (skippedFrames > 0) {
+                // Filter history from before the gap doesn't belong to what follows
+                decimator->reset();
+                skippedFrames = skippedFrames * decimator->outRate() / sampleRate;
+                return 0;
+            }
+            if (read == 0) {
+                return 0;
+            }
+            decimatedCount = decimator->process(streamBuf.data(), read, decimatedBuf.data());
+            decimatedPos = 0;
+        }
+        return takeDecimated(out, count);
+    }
+
+    // Samples to read before the ring; they have to end where the ring starts.
+    void setPreRoll(std::unique_ptr<PreRollSnapshot> snapshot) {
+        preRoll = std::move(snapshot);
+    }
+
+    // Returns samples already taken from the ring but not read yet, without
+    // touching the ring. Used to flush the tail of a recording.
+    size_t readBuffered(float* out, size_t count) {
+        return decimator ? takeDecimated(out, count) : 0;
+    }
+
+    int64_t discontinuityCount() const {
+        return discontinuities;
+    }
+
+private:
+    static constexpr size_t kDecimateChunkFrames = 480;
+
+    size_t takeDecimated(float* out, size_t count) {
+        size_t n = std::min(count, decimatedCount - decimatedPos);
+        std::copy(decimatedBuf.data() + decimatedPos, decimatedBuf.data() + decimatedPos + n, out);
+        decimatedPos += n;
+        return n;
+    }
+
+    size_t readStream(float* out, size_t count, int64_t& skippedFrames) {
+        if (preRoll && preRoll->empty()) {
+            preRoll = nullptr;
+        }
+        return preRoll ? readFrom(*preRoll, out, count, skippedFrames)
+                       : readFrom(ring, out, count, skippedFrames);
+    }
+
+    template <typename Source>
+    size_t readFrom(Source& source, float* out, size_t count, int64_t& skippedFrames) {
+        skippedFrames = 0;
+
+        if (silenceFrames > 0) {
+            size_t n = std::min<size_t>(silenceFrames * channels, count);
+            std::fill(out, out + n, 0.0f);
+            silenceFrames -= static_cast<int64_t>(n / channels);
+            return n;
+        }
+
+        PcmBlockInfo info;
+        if (!source.peek(info)) {
+            return 0;
+        }
+
+        int64_t gap = started ? gapFrames(info) : 0;
+        if (gap > 0) {
+            // Samples after the gap are expected from here on
+            expectedPosition = info.framePosition;
+            expectedTimeNs = sampleTimeNs(info);
+            ++discontinuities;
+
+            if (fillGaps && gap <= kMaxGapFillSec * sampleRate) {
+                silenceFrames = gap;
+                return readStream(out, count, skippedFrames);
+            }
+            skippedFrames = gap;
+            return 0;
+        }
+
+        size_t read = source.pop(out, count, &info);
+        if (read == 0) {
+            return 0;
+        }
+
+        int64_t readFrames = static_cast<int64_t>(read / channels);
+        started = true;
+        expectedPosition = info.framePosition + readFrames;
+        expectedTimeNs = sampleTimeNs(info) + readFrames * 1000000000LL / sampleRate;
+        return read;
+    }
+
+    int64_t sampleTimeNs(const PcmBlockInfo& info) const {
+        return info.anchorTimeNs +
+               (info.framePosition - info.anchorPosition) * 1000000000LL / sampleRate;
+    }
+
+    // Number of frames missing between the last read sample and the next one
+    // in the ring. A forward jump in stream position means pushes were dropped;
+    // a backward jump means the stream was restarted and only the capture time
+    // tells how long the recording was interrupted.
+    int64_t gapFrames(const PcmBlockInfo& info) const {
+        if (info.framePosition > expectedPosition) {
+            return info.framePosition - expectedPosition;
+        }
+        if (info.framePosition < expectedPosition) {
+            int64_t lostNs = sampleTimeNs(info) - expectedTimeNs;
+            return std::max<int64_t>(0, lostNs * sampleRate / 1000000000LL);
+        }
+        return 0;
+    }
+
+    PcmRingBuffer& ring;
+    int sampleRate;
+    int channels;
+    bool fillGaps;
+
+    bool started = false;
+    int64_t expectedPosition = 0;
+    int64_t expectedTimeNs = 0;
+    int64_t silenceFrames = 0;
+    int64_t discontinuities = 0;
+
+    std::unique_ptr<PreRollSnapshot> preRoll;
+
+    std::unique_ptr<PolyphaseDecimator> decimator;
+    std::vector<float> streamBuf;
+    std::vector<float> decimatedBuf;
+    size_t decimatedPos = 0;
+    size_t decimatedCount = 0;
+};
@@ -0,0 +1,145 @@
+#include "PolyphaseDecimator.h"
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static constexpr double PASSBAND = 0.9;       // of the output Nyquist rate
+static constexpr double ZERO_CROSSINGS = 12;  // sinc lobes on each side
+static constexpr double KAISER_BETA = 8.0;    // about 80 dB stopband
+
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+static float dot(const float* a, const float* b, int n) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float32x2_t sum2 = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    float sum = vget_lane_f32(vpadd_f32(sum2, sum2), 0);
+#else
+    // Independent partial sums, so the compiler can keep them in one vector
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (; i + 4 <= n; i += 4) {
+        acc[0] += a[i] * b[i];
+        acc[1] += a[i + 1] * b[i + 1];
+        acc[2] += a[i + 2] * b[i + 2];
+        acc[3] += a[i + 3] * b[i + 3];
+    }
+    float sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+PolyphaseDecimator::PolyphaseDecimator(int inRate, int outRate, int channels)
+        : inRate_(inRate), outRate_(outRate), channels(channels), history(channels) {
+    int g = std::gcd(inRate, outRate);
+    up = outRate / g;
+    down = inRate / g;
+
+    // Cutoff in cycles per input sample, then the filter span that holds the
+    // wanted number of sinc lobes
+    double cutoff = 0.5 * PASSBAND * std::min(1.0, static_cast<double>(outRate) / inRate);
+    taps = static_cast<int>(std::ceil(ZERO_CROSSINGS / cutoff));
+    taps = (taps + 3) & ~3;
+
+    // Prototype filter at the upsampled rate: up * taps coefficients, centred
+    // between them. Each phase is normalised to unity gain at DC.
+    int length = up * taps;
+    double centre = (length - 1) / 2.0;
+    double fc = cutoff / up;
+    std::vector<double> proto(length);
+    for (int n = 0; n < length; ++n) {
+        double t = n - centre;
+        double x = 2.0 * M_PI * fc * t;
+        double sinc = t == 0.0 ? 1.0 : std::sin(x) / x;
+        double w = (n - centre) / (length / 2.0);
+        double window = besselI0(KAISER_BETA * std::sqrt(std::max(0.0, 1.0 - w * w))) /
+                        besselI0(KAISER_BETA);
+        proto[n] = sinc * window;
+    }
+
+    coeffs.resize(length);
+    for (int p = 0; p < up; ++p) {
+        double sum = 0.0;
+        for (int k = 0; k < taps; ++k) {
+            sum += proto[p + k * up];
+        }
+        for (int k = 0; k < taps; ++k) {
+            coeffs[p * taps + (taps - 1 - k)] = static_cast<float>(proto[p + k * up] / sum);
+        }
+    }
+
+    reset();
+}
+
+void PolyphaseDecimator::reset() {
+    for (auto& h : history) {
+        h.assign(taps - 1, 0.0f);
+    }
+    nextInput = taps - 1;
+    phase = 0;
+}
+
+size_t PolyphaseDecimator::maxOutput(size_t count) const {
+    size_t frames = count / channels;
+    return (frames * up / down + 2) * channels;
+}
+
+size_t PolyphaseDecimator::process(const float* in, size_t count, float* out) {
+    size_t frames = count / channels;
+
+    for (int c = 0; c < channels; ++c) {
+        std::vector<float>& h = history[c];
+        size_t base = h.size();
+        h.resize(base + frames);
+        for (size_t i = 0; i < frames; ++i) {
+            h[base + i] = in[i * channels + c];
+        }
+    }
+
+    size_t available = history[0].size();
+    size_t written = 0;
+
+    while (nextInput < available) {
+        const float* phaseCoeffs = coeffs.data() + phase * taps;
+        size_t first = nextInput + 1 - taps;
+
+        for (int c = 0; c < channels; ++c) {
+            out[written++] = dot(phaseCoeffs, history[c].data() + first, taps);
+        }
+
+        phase += down;
+        nextInput += phase / up;
+        phase %= up;
+    }
+
+    // Keep the samples the next outputs still reach back to
+    size_t keepFrom = nextInput + 1 - taps;
+    for (auto& h : history) {
+        h.erase(h.begin(), h.begin() + std::min(keepFrom, h.size()));
+    }
+    nextInput -= keepFrom;
+
+    return written;
+}
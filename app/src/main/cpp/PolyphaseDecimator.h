@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Rational-ratio polyphase lowpass resampler for lowering the recording rate,
+// e.g. 48 kHz -> 16 kHz for speech. Interleaved multichannel input is split
+// into per-channel histories so every output sample is one contiguous dot
+// product against a single phase of the filter.
+class PolyphaseDecimator {
+public:
+    PolyphaseDecimator(int inRate, int outRate, int channels);
+
+    // Consumes all count interleaved input samples. out must have room for
+    // maxOutput(count) samples; returns the number of samples written.
+    size_t process(const float* in, size_t count, float* out);
+
+    size_t maxOutput(size_t count) const;
+
+    // Drops the filter history, e.g. after a discontinuity in the input.
+    void reset();
+
+    int inRate() const {
+        return inRate_;
+    }
+
+    int outRate() const {
+        return outRate_;
+    }
+
+private:
+    int inRate_;
+    int outRate_;
+    int channels;
+
+    int up = 1;      // L: upsampling factor of the rational ratio
+    int down = 1;    // M: downsampling factor
+    int taps = 0;    // taps per phase, in input samples
+
+    // Per phase coefficients, stored reversed to run forward over the history
+    std::vector<float> coeffs;
+
+    // Per channel input, starting with taps - 1 samples of history
+    std::vector<std::vector<float>> history;
+    size_t nextInput = 0;  // history index of the newest sample for the next output
+    int phase = 0;
+};
@@ -0,0 +1,206 @@
+#include "PreRollBuffer.h"
+#include <algorithm>
+
+static const int16_t ADPCM_STEPS[89] = {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+        50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+        253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+        1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+        3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+        11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+        32767
+};
+
+static const int8_t ADPCM_INDEX_ADJUST[16] = {
+        -1, -1, -1, -1, 2, 4, 6, 8,
+        -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static void adpcmUpdate(AdpcmState& state, uint8_t code) {
+    int step = ADPCM_STEPS[state.index];
+    int delta = step >> 3;
+    if (code & 4) delta += step;
+    if (code & 2) delta += step >> 1;
+    if (code & 1) delta += step >> 2;
+
+    int predictor = state.predictor + ((code & 8) ? -delta : delta);
+    state.predictor = static_cast<int16_t>(std::clamp(predictor, -32768, 32767));
+    state.index = static_cast<uint8_t>(std::clamp(state.index + ADPCM_INDEX_ADJUST[code], 0, 88));
+}
+
+static uint8_t adpcmEncode(AdpcmState& state, float sample) {
+    int value = static_cast<int>(std::clamp(sample, -1.0f, 1.0f) * 32767.0f);
+    int diff = value - state.predictor;
+    int step = ADPCM_STEPS[state.index];
+
+    uint8_t code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+    }
+    if (diff >= step >> 1) {
+        code |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= step >> 2) {
+        code |= 1;
+    }
+
+    // The decoder's reconstruction keeps both sides in step
+    adpcmUpdate(state, code);
+    return code;
+}
+
+PreRollBuffer::PreRollBuffer(int sampleRate, int seconds)
+        : rate(sampleRate), length(std::clamp(seconds, 0, kMaxSeconds)) {
+    int64_t frames = static_cast<int64_t>(rate) * length;
+    // One block more than the history, as the block being written isn't complete
+    blocks.resize(frames / PreRollBlock::kBlockFrames + 2);
+}
+
+void PreRollBuffer::nextBlock() {
+    writeBlock = (writeBlock + 1) % blocks.size();
+    blocks[writeBlock].frames = 0;
+    completeBlocks = std::min(completeBlocks + 1, blocks.size() - 1);
+    ++blocksStarted;
+}
+
+void PreRollBuffer::append(const float* dry, const float* processed, size_t frames,
+                           const PcmBlockInfo& info) {
+    PreRollBlock* block = &blocks[writeBlock];
+
+    // A block only holds contiguous frames
+    if (block->frames > 0 &&
+        info.framePosition != block->info.framePosition + block->frames) {
+        nextBlock();
+        block = &blocks[writeBlock];
+    }
+
+    for (size_t i = 0; i < frames; ++i) {
+        if (block->frames == 0) {
+            block->info = info;
+            block->info.framePosition = info.framePosition + static_cast<int64_t>(i);
+            block->start[0] = state[0];
+            block->start[1] = state[1];
+        }
+
+        uint8_t dryCode = adpcmEncode(state[0], dry[i]);
+        uint8_t processedCode = adpcmEncode(state[1], processed[i]);
+
+        size_t byte = block->frames >> 1;
+        if (block->frames & 1) {
+            block->data[0][byte] |= dryCode << 4;
+            block->data[1][byte] |= processedCode << 4;
+        } else {
+            block->data[0][byte] = dryCode;
+            block->data[1][byte] = processedCode;
+        }
+
+        if (++block->frames == PreRollBlock::kBlockFrames) {
+            nextBlock();
+            block = &blocks[writeBlock];
+        }
+    }
+}
+
+// Only the block being written is copied with the lock held. append() can
+// reuse the oldest of the other blocks while they are copied; those are
+// found from blocksStarted and left out, which shortens the pre-roll at its
+// start but never tears it.
+std::unique_ptr<PreRollSnapshot> PreRollBuffer::snapshot(int64_t maxFrames, int channels,
+                                                         std::unique_lock<std::mutex>& lock) const {
+    const size_t size = blocks.size();
+
+    // Walk back from the block being written until enough frames are covered
+    size_t count = 0;
+    int64_t frames = 0;
+    bool partial = blocks[writeBlock].frames > 0;
+    size_t available = completeBlocks + (partial ? 1 : 0);
+    size_t newest = partial ? writeBlock : (writeBlock + size - 1) % size;
+
+    while (count < available && frames < maxFrames) {
+        const PreRollBlock& block = blocks[(newest + size - count) % size];
+        frames += block.frames;
+        ++count;
+    }
+
+    PreRollBlock newestBlock = blocks[newest];
+    uint64_t started = blocksStarted;
+    lock.unlock();
+
+    auto snapshot = std::make_unique<PreRollSnapshot>();
+    snapshot->channels = channels;
+    snapshot->blocks.reserve(count);
+    for (size_t i = count; i > 1; --i) {
+        snapshot->blocks.push_back(blocks[(newest + size - (i - 1)) % size]);
+    }
+    if (count > 0) {
+        snapshot->blocks.push_back(newestBlock);
+    }
+    snapshot->offset = frames > maxFrames ? static_cast<size_t>(frames - maxFrames) : 0;
+
+    lock.lock();
+
+    // Slots after newest written since, the free ones first, then the oldest
+    // copied ones. The block being written when the lock was let go is newest
+    // itself when it had frames, the slot after it otherwise.
+    uint64_t written = blocksStarted - started + (partial ? 0 : 1);
+    uint64_t reused = written > size - count ? written - (size - count) : 0;
+    if (reused > 0 && count > 0) {
+        size_t drop = static_cast<size_t>(std::min<uint64_t>(reused, count - 1));
+        snapshot->blocks.erase(snapshot->blocks.begin(), snapshot->blocks.begin() + drop);
+        if (drop > 0) {
+            snapshot->offset = 0;
+        }
+    }
+    return snapshot;
+}
+
+void PreRollSnapshot::decodeCurrent() {
+    const PreRollBlock& block = blocks[current];
+    decoded.resize(PreRollBlock::kBlockFrames * channels);
+
+    for (int c = 0; c < channels; ++c) {
+        AdpcmState state = block.start[c];
+        for (uint32_t i = 0; i < block.frames; ++i) {
+            uint8_t byte = block.data[c][i >> 1];
+            adpcmUpdate(state, (i & 1) ? byte >> 4 : byte & 0x0f);
+            decoded[i * channels + c] = state.predictor / 32768.0f;
+        }
+    }
+    decodedBlock = current;
+}
+
+bool PreRollSnapshot::peek(PcmBlockInfo& info) const {
+    if (empty()) return false;
+
+    info = blocks[current].info;
+    info.framePosition += static_cast<int64_t>(offset);
+    return true;
+}
+
+size_t PreRollSnapshot::pop(float* out, size_t count, PcmBlockInfo* info) {
+    if (empty()) return 0;
+
+    if (info) {
+        peek(*info);
+    }
+    if (decodedBlock != current) {
+        decodeCurrent();
+    }
+
+    size_t frames = std::min<size_t>(count / channels, blocks[current].frames - offset);
+    std::copy(decoded.data() + offset * channels,
+              decoded.data() + (offset + frames) * channels, out);
+
+    offset += frames;
+    if (offset == blocks[current].frames) {
+        ++current;
+        offset = 0;
+    }
+    return frames * channels;
+}
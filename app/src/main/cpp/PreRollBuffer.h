@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "PcmRingBuffer.h"
+
+// Encoder/decoder state of one IMA ADPCM channel
+struct AdpcmState {
+    int16_t predictor = 0;
+    uint8_t index = 0;
+};
+
+// Dry and processed samples of up to kBlockFrames contiguous frames, 4 bits
+// per sample. The start states make every block decodable on its own.
+struct PreRollBlock {
+    static constexpr size_t kBlockFrames = 256;
+
+    PcmBlockInfo info;
+    uint32_t frames = 0;
+    AdpcmState start[2];
+    uint8_t data[2][kBlockFrames / 2];
+};
+
+class PreRollSnapshot;
+
+// Always-on history of the recording tap, so a recording can start with the
+// seconds before it was requested. Both the dry and the processed signal are
+// kept as IMA ADPCM; together they take under a third of the memory of a
+// single float channel.
+class PreRollBuffer {
+public:
+    static constexpr int kMaxSeconds = 120;
+
+    PreRollBuffer(int sampleRate, int seconds);
+
+    // Called from the audio callback: constant work per frame, no allocation.
+    void append(const float* dry, const float* processed, size_t frames,
+                const PcmBlockInfo& info);
+
+    // Copies the last maxFrames frames or less. One channel gives the dry
+    // signal, two give dry and processed interleaved like the recording tap.
+    // lock is held on the mutex append() is called under. It is let go while
+    // the complete blocks are copied, which takes milliseconds for a long
+    // history, and held again on return.
+    std::unique_ptr<PreRollSnapshot> snapshot(int64_t maxFrames, int channels,
+                                              std::unique_lock<std::mutex>& lock) const;
+
+    int sampleRate() const {
+        return rate;
+    }
+
+    int seconds() const {
+        return length;
+    }
+
+private:
+    void nextBlock();
+
+    int rate;
+    int length;
+    std::vector<PreRollBlock> blocks;
+    size_t writeBlock = 0;
+    size_t completeBlocks = 0;
+    uint64_t blocksStarted = 0;  // blocks moved on to, tells snapshot() what was reused
+    AdpcmState state[2];
+};
+
+// Pre-roll copied out for one recording. Reads like PcmRingBuffer: samples
+// come with their stream position and never cross a block.
+class PreRollSnapshot {
+public:
+    bool peek(PcmBlockInfo& info) const;
+    size_t pop(float* out, size_t count, PcmBlockInfo* info = nullptr);
+
+    bool empty() const {
+        return current >= blocks.size();
+    }
+
+private:
+    friend class PreRollBuffer;
+
+    void decodeCurrent();
+
+    std::vector<PreRollBlock> blocks;
+    int channels = 1;
+    size_t current = 0;
+    size_t offset = 0;  // frames of the current block already read
+
+    std::vector<float> decoded;
+    size_t decodedBlock = SIZE_MAX;
+};
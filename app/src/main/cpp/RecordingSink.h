@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include "PreRollBuffer.h"
+#include "RecordingStats.h"
+
+enum class RecordingSinkType {
+    Aac = 0,  // AAC in MP4 through AMediaCodec/AMediaMuxer
+    Wav = 1   // uncompressed 16 bit PCM in RIFF/RF64
+};
+
+enum class RecordingSource {
+    Dry = 0,             // mono, the input after gain
+    DryAndProcessed = 1  // stereo, dry left and SoundTouch output right
+};
+
+// Destination of the recording tap. A sink drains the recording ring on its
+// own thread between start() and stop() and owns the file written to its fd.
+class RecordingSink {
+public:
+    virtual ~RecordingSink() = default;
+
+    virtual void start() = 0;
+    virtual void stop() = 0;
+
+    // Recording starts with these samples; to be called before start().
+    virtual void setPreRoll(std::unique_ptr<PreRollSnapshot> snapshot) = 0;
+
+    // Counters aggregated since start(); safe to call from any thread.
+    virtual RecordingStats stats() const = 0;
+};
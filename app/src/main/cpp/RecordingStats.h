@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+
+// Count, total and maximum of a repeated measurement. Totals rather than
+// averages are kept so that snapshots can be summed across recordings.
+struct TimingStat {
+    int64_t count = 0;
+    int64_t totalNs = 0;
+    int64_t maxNs = 0;
+
+    void add(int64_t ns) {
+        ++count;
+        totalNs += ns;
+        maxNs = std::max(maxNs, ns);
+    }
+
+    int64_t averageNs() const {
+        return count > 0 ? totalNs / count : 0;
+    }
+};
+
+// Snapshot of the recording pipeline, from the audio callback pushing into the
+// recording ring to the bytes the sink wrote. Sinks fill in what applies to
+// them; the ring fields are filled in by the engine that owns the ring.
+struct RecordingStats {
+    int64_t framesQueued = 0;      // frames handed to the codec or written out
+    int64_t bytesWritten = 0;      // encoded or PCM bytes written to the file
+    int64_t droppedSamples = 0;    // samples the ring had no room for
+    int64_t skippedFrames = 0;     // gap frames skipped rather than filled
+    int64_t discontinuities = 0;
+    int64_t truncatedInputFrames = 0;  // callback input beyond the processing buffer, lost
+    int64_t pitchOverruns = 0;     // SoundTouch input refused and its output cleared
+
+    int64_t ringOccupancy = 0;     // samples waiting in the ring
+    int64_t ringHighWater = 0;     // most samples ever waiting
+    int64_t ringCapacity = 0;
+
+    int32_t codecQueueDepth = 0;   // frames inside the codec
+    int32_t codecQueueMax = 0;
+
+    TimingStat convert;            // float to 16 bit conversion, per frame
+    TimingStat encode;             // queue to output of a frame in the codec
+    TimingStat write;              // muxer or file write, per buffer
+
+    int64_t firstSampleLatencyNs = -1;
+};
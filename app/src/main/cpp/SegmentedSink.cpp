@@ -0,0 +1,370 @@
+#include "SegmentedSink.h"
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <android/log.h>
+
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "SegmentedSink", __VA_ARGS__)
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, "SegmentedSink", __VA_ARGS__)
+
+static constexpr int AAC_FRAME_SAMPLES = 1024;
+static constexpr size_t SEGMENT_RING_FRAMES = 16384;
+static constexpr size_t READ_FRAMES = AAC_FRAME_SAMPLES;
+static constexpr int SIZE_CHECK_SEC = 1;
+static constexpr int64_t STALL_TIMEOUT_MS = 2000;  // encoder taking nothing from its ring
+
+// Adds the counters of one segment to the totals of the recording
+static void addStats(RecordingStats& total, const RecordingStats& s) {
+    total.framesQueued += s.framesQueued;
+    total.bytesWritten += s.bytesWritten;
+    total.droppedSamples += s.droppedSamples;
+    total.codecQueueMax = std::max(total.codecQueueMax, s.codecQueueMax);
+
+    for (auto [sum, add] : {std::make_pair(&total.convert, &s.convert),
+                            std::make_pair(&total.encode, &s.encode),
+                            std::make_pair(&total.write, &s.write)}) {
+        sum->count += add->count;
+        sum->totalNs += add->totalNs;
+        sum->maxNs = std::max(sum->maxNs, add->maxNs);
+    }
+}
+
+SegmentedSink::SegmentedSink(PcmRingBuffer& buffer,
+                             int sampleRate,
+                             int channels,
+                             std::string directory,
+                             int64_t segmentSeconds,
+                             int64_t segmentBytes,
+                             int recordRate,
+                             int bitrate)
+        : mReader(buffer, sampleRate, channels, true, recordRate),
+          mSampleRate(mReader.outputRate()),
+          mChannels(channels),
+          mBitrate(bitrate),
+          mDirectory(std::move(directory)),
+          mSegmentBytes(segmentBytes),
+          mFloatBuf(READ_FRAMES * channels) {
+    mSegmentFrames = segmentSeconds > 0 ? segmentSeconds * mSampleRate : INT64_MAX;
+}
+
+bool SegmentedSink::prepare() {
+    if (mCurrent) {
+        return true;
+    }
+
+    mCurrent = openSegment(0);
+    return mCurrent != nullptr;
+}
+
+void SegmentedSink::start() {
+    if (mRunning.load()) {
+        LOGE("Sink already running");
+        return;
+    }
+
+    if (!prepare()) {
+        return;
+    }
+
+    mCurrent->encoder->start();
+    prepareNextSegment();
+
+    mRunning.store(true);
+    mThread = std::thread(&SegmentedSink::feedLoop, this);
+}
+
+void SegmentedSink::stop() {
+    if (!mRunning.load()) {
+        return;
+    }
+
+    mRunning.store(false);
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+std::unique_ptr<SegmentedSink::Segment> SegmentedSink::openSegment(int index) {
+    char name[32];
+    snprintf(name, sizeof(name), "segment_%04d.m4a", index);
+    std::string path = mDirectory + "/" + name;
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOGE("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    auto segment = std::make_unique<Segment>(SEGMENT_RING_FRAMES * mChannels);
+    segment->index = index;
+    segment->limit = mSegmentFrames;
+    segment->fd = fd;
+    segment->name = name;
+    segment->ring.setChannels(mChannels);
+
+    // The stream is already at the recorded rate and free of long gaps
+    segment->encoder = std::make_unique<AacEncoder>(
+            segment->ring,
+            mSampleRate,
+            mChannels,
+            fd,
+            0,
+            mBitrate,
+            true,
+            EncoderMode::Async
+    );
+    if (!segment->encoder->prepare()) {
+        // A start would only try again; rotate() keeps the current segment
+        discardSegment(std::move(segment));
+        return nullptr;
+    }
+    return segment;
+}
+
+// The next segment's file and codec are set up while the current one records,
+// so the switch itself only starts a thread.
+void SegmentedSink::prepareNextSegment() {
+    int index = mCurrent->index + 1;
+    mNext = std::async(std::launch::async, [this, index]() {
+        return openSegment(index);
+    });
+}
+
+bool SegmentedSink::segmentFull() {
+    if (mCurrent->frames >= mCurrent->limit) {
+        return true;
+    }
+
+    if (mSegmentBytes > 0 && mCurrent->frames - mLastSizeCheck >= SIZE_CHECK_SEC * mSampleRate) {
+        mLastSizeCheck = mCurrent->frames;
+
+        struct stat st{};
+        if (fstat(mCurrent->fd, &st) == 0 && st.st_size >= mSegmentBytes) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SegmentedSink::rotate() {
+    std::unique_ptr<Segment> next = mNext.get();
+    if (!next) {
+        // Try again after another segment length rather than on every frame
+        LOGE("Next segment unavailable, continuing in segment %d", mCurrent->index);
+        mCurrent->limit += mSegmentFrames;
+        prepareNextSegment();
+        return false;
+    }
+
+    next->firstFrame = mFramePosition;
+    next->encoder->start();
+
+    std::unique_ptr<Segment> closed;
+    {
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        closed = std::move(mCurrent);
+        mCurrent = std::move(next);
+    }
+    closeSegment(std::move(closed));
+    mLastSizeCheck = 0;
+    prepareNextSegment();
+
+    LOGI("Rotated to segment %d at frame %lld", mCurrent->index, (long long) mFramePosition);
+    return true;
+}
+
+// Closing waits for the encoder to take everything from its ring, so it runs
+// in the background while the next segment records.
+void SegmentedSink::closeSegment(std::unique_ptr<Segment> segment) {
+    std::shared_ptr<Segment> closing(std::move(segment));
+    mClosing.push_back(std::async(std::launch::async, [this, closing]() {
+        finishSegment(*closing);
+    }));
+
+    // Forget the ones that are done
+    mClosing.erase(std::remove_if(mClosing.begin(), mClosing.end(), [](std::future<void>& f) {
+        return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), mClosing.end());
+}
+
+void SegmentedSink::finishSegment(Segment& segment) {
+    auto lastProgress = std::chrono::steady_clock::now();
+    size_t lastSize = segment.ring.size();
+
+    while (lastSize > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        size_t size = segment.ring.size();
+        auto now = std::chrono::steady_clock::now();
+        if (size != lastSize) {
+            lastProgress = now;
+        } else if (now - lastProgress > std::chrono::milliseconds(STALL_TIMEOUT_MS)) {
+            LOGE("Encoder of %s stalled, dropping its last samples", segment.name.c_str());
+            break;
+        }
+        lastSize = size;
+    }
+    segment.encoder->stop();
+    {
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        RecordingStats closed = segment.encoder->stats();
+        closed.droppedSamples += segment.ring.droppedSamples();
+        addStats(mClosedStats, closed);
+        if (segment.index == 0) {
+            mClosedStats.firstSampleLatencyNs = closed.firstSampleLatencyNs;
+        }
+    }
+    segment.encoder = nullptr;
+
+    fsync(segment.fd);
+    close(segment.fd);
+
+    // The header goes in with the first segment, so that a sink that never
+    // recorded leaves nothing behind
+    if (segment.index == 0) {
+        char header[128];
+        snprintf(header, sizeof(header), "# sampleRate=%d channels=%d segmentFrames=%lld",
+                 mSampleRate, mChannels, (long long) mSegmentFrames);
+        writeManifest(header);
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line), "%s\t%lld\t%lld",
+             segment.name.c_str(), (long long) segment.firstFrame, (long long) segment.frames);
+    writeManifest(line);
+
+    LOGI("Closed %s, %lld frames", segment.name.c_str(), (long long) segment.frames);
+}
+
+void SegmentedSink::discardSegment(std::unique_ptr<Segment> segment) {
+    if (!segment) {
+        return;
+    }
+    segment->encoder = nullptr;
+    close(segment->fd);
+    unlink((mDirectory + "/" + segment->name).c_str());
+}
+
+void SegmentedSink::writeManifest(const std::string& line) {
+    std::lock_guard<std::mutex> lock(mManifestMutex);
+
+    std::string path = mDirectory + "/segments.txt";
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOGE("Failed to open manifest: %s", strerror(errno));
+        return;
+    }
+
+    std::string data = line + "\n";
+    if (write(fd, data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+        LOGE("Failed to write manifest: %s", strerror(errno));
+    }
+    fsync(fd);
+    close(fd);
+}
+
+// Pushes samples into the current segment one encoder frame at a time, so a
+// rotation always falls between two AAC frames of the old segment.
+void SegmentedSink::feed(const float* samples, size_t count) {
+    while (count > 0) {
+        int64_t toBoundary = AAC_FRAME_SAMPLES - mCurrent->pushed % AAC_FRAME_SAMPLES;
+        size_t frames = std::min<size_t>(count / mChannels, static_cast<size_t>(toBoundary));
+
+        PcmBlockInfo info;
+        info.framePosition = mCurrent->frames;
+        info.anchorPosition = 0;
+        info.anchorTimeNs = 0;
+
+        auto waitStart = std::chrono::steady_clock::now();
+        while (!mCurrent->ring.push(samples, frames * mChannels, info)) {
+            if (std::chrono::steady_clock::now() - waitStart >
+                std::chrono::milliseconds(STALL_TIMEOUT_MS)) {
+                LOGE("Encoder of %s stalled, dropping samples", mCurrent->name.c_str());
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        mCurrent->frames += static_cast<int64_t>(frames);
+        mCurrent->pushed += static_cast<int64_t>(frames);
+        mFramePosition += static_cast<int64_t>(frames);
+        samples += frames * mChannels;
+        count -= frames * mChannels;
+
+        if (mCurrent->pushed % AAC_FRAME_SAMPLES == 0 && segmentFull()) {
+            rotate();
+        }
+    }
+}
+
+void SegmentedSink::feedLoop() {
+    LOGI("feedLoop started");
+
+    // Reads whole AAC frames as long as the stream has them; after stop the
+    // ring is read empty, then the last segment is closed.
+    while (true) {
+        bool running = mRunning.load();
+
+        int64_t skipped = 0;
+        size_t read = mReader.read(mFloatBuf.data(), mFloatBuf.size(), skipped);
+
+        if (skipped > 0) {
+            // Moves this segment's timeline on; the segment encoder sees a gap
+            LOGI("Skipping discontinuity of %lld frames", (long long) skipped);
+            mCurrent->frames += skipped;
+            mFramePosition += skipped;
+            mSkippedFrames.fetch_add(skipped);
+            mDiscontinuities.store(mReader.discontinuityCount());
+            continue;
+        }
+
+        if (read > 0) {
+            mDiscontinuities.store(mReader.discontinuityCount());
+            feed(mFloatBuf.data(), read);
+            continue;
+        }
+
+        if (!running) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::unique_ptr<Segment> last;
+    {
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        last = std::move(mCurrent);
+    }
+    closeSegment(std::move(last));
+    for (auto& closing : mClosing) {
+        closing.wait();
+    }
+    mClosing.clear();
+
+    discardSegment(mNext.get());
+
+    LOGI("Segmented recording finished at frame %lld", (long long) mFramePosition);
+}
+
+RecordingStats SegmentedSink::stats() const {
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    RecordingStats total = mClosedStats;
+
+    if (mCurrent && mCurrent->encoder) {
+        RecordingStats current = mCurrent->encoder->stats();
+        current.droppedSamples += mCurrent->ring.droppedSamples();
+        addStats(total, current);
+        total.codecQueueDepth = current.codecQueueDepth;
+        if (mCurrent->index == 0) {
+            total.firstSampleLatencyNs = current.firstSampleLatencyNs;
+        }
+    }
+    total.skippedFrames = mSkippedFrames.load();
+    total.discontinuities = mDiscontinuities.load();
+    return total;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "PcmRingBuffer.h"
+#include "PcmStreamReader.h"
+#include "RecordingSink.h"
+#include "AACEncoder.h"
+
+
+// Records into a series of AAC/MP4 files in one directory, rolling over to a
+// new file every segmentSeconds or segmentBytes, whichever comes first. Only
+// the open segment is lost if the process dies before its muxer is stopped.
+//
+// The sink reads the recording ring itself and feeds each segment's encoder
+// through a private ring, switching at an AAC frame boundary so no sample is
+// dropped or repeated. The next segment's encoder is prepared while the
+// current one runs. Every closed segment is appended to a manifest
+// (segments.txt) with its first frame and length, for stitching later.
+class SegmentedSink : public RecordingSink {
+public:
+    SegmentedSink(PcmRingBuffer& buffer,
+                  int sampleRate,
+                  int channels,
+                  std::string directory,
+                  int64_t segmentSeconds,
+                  int64_t segmentBytes,
+                  int recordRate = 0,
+                  int bitrate = 0);
+
+    // Opens the first segment and sets up its codec, which can take a few
+    // hundred milliseconds, so that it can be done before the sink is handed
+    // to the audio side. start() does it when it wasn't done. A sink dropped
+    // before start() removes the segment again.
+    bool prepare();
+
+    void start() override;
+    void stop() override;
+
+    void setPreRoll(std::unique_ptr<PreRollSnapshot> snapshot) override {
+        mReader.setPreRoll(std::move(snapshot));
+    }
+
+    // Totals over all segments so far; the codec figures are the open one's
+    RecordingStats stats() const override;
+
+    ~SegmentedSink() override {
+        if (mRunning.load()) {
+            stop();
+        } else {
+            // Prepared but never started
+            discardSegment(std::move(mCurrent));
+        }
+    }
+
+private:
+    struct Segment {
+        int index = 0;
+        int fd = -1;
+        std::string name;
+        PcmRingBuffer ring;
+        std::unique_ptr<AacEncoder> encoder;
+        int64_t firstFrame = 0;  // in recording frames since the start
+        int64_t frames = 0;      // timeline length, skipped gaps included
+        int64_t pushed = 0;      // frames given to the encoder
+        int64_t limit = 0;
+
+        explicit Segment(size_t capacity) : ring(capacity) {}
+    };
+
+    void feedLoop();
+
+    std::unique_ptr<Segment> openSegment(int index);
+    void prepareNextSegment();
+    bool rotate();
+    void closeSegment(std::unique_ptr<Segment> segment);
+    void finishSegment(Segment& segment);
+    void discardSegment(std::unique_ptr<Segment> segment);
+
+    bool segmentFull();
+    void feed(const float* samples, size_t count);
+    void writeManifest(const std::string& line);
+
+    PcmStreamReader mReader;
+    int mSampleRate;  // recorded rate, the stream rate may be higher
+    int mChannels;
+    int mBitrate;
+    std::string mDirectory;
+    int64_t mSegmentFrames;
+    int64_t mSegmentBytes;
+
+    // Guards mCurrent being swapped against stats(), and the closed totals
+    mutable std::mutex mStatsMutex;
+    std::unique_ptr<Segment> mCurrent;
+    RecordingStats mClosedStats;
+    std::atomic<int64_t> mSkippedFrames{0};
+    std::atomic<int64_t> mDiscontinuities{0};
+    std::future<std::unique_ptr<Segment>> mNext;
+    std::vector<std::future<void>> mClosing;
+    std::mutex mManifestMutex;
+
+    int64_t mFramePosition = 0;  // next frame fed to a segment
+    int64_t mLastSizeCheck = 0;
+
+    std::vector<float> mFloatBuf;
+    std::thread mThread;
+    std::atomic<bool> mRunning{false};
+};
@@ -0,0 +1,225 @@
+#include "Transcoder.h"
+#include "AACEncoder.h"
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <android/log.h>
+#include "soundtouch/include/SampleConvert.h"
+
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "Transcoder", __VA_ARGS__)
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, "Transcoder", __VA_ARGS__)
+
+static constexpr int BACKGROUND_NICE = 10;  // ANDROID_PRIORITY_BACKGROUND
+static constexpr size_t RING_SAMPLES = 16384;
+static constexpr size_t CHUNK_SAMPLES = 4096;
+
+static uint32_t getLE32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t getLE64(const uint8_t* p) {
+    return getLE32(p) | (static_cast<uint64_t>(getLE32(p + 4)) << 32);
+}
+
+static bool readFully(int fd, void* data, size_t size, int64_t offset) {
+    auto* p = static_cast<uint8_t*>(data);
+
+    while (size > 0) {
+        ssize_t read = pread(fd, p, size, offset);
+        if (read < 0 && errno == EINTR) continue;
+        if (read <= 0) return false;
+
+        p += read;
+        size -= static_cast<size_t>(read);
+        offset += read;
+    }
+    return true;
+}
+
+Transcoder::Transcoder(int inFd, int outFd)
+        : mInFd(inFd),
+          mOutFd(outFd),
+          mRing(RING_SAMPLES) {}
+
+void Transcoder::start() {
+    if (mState.load() == TranscodeState::Running) {
+        LOGE("Transcode already running");
+        return;
+    }
+
+    mState.store(TranscodeState::Running);
+    mThread = std::thread(&Transcoder::transcodeLoop, this);
+}
+
+void Transcoder::cancel() {
+    mCancelled.store(true);
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+float Transcoder::progress() const {
+    int64_t dataBytes = mDataBytes.load();
+    if (dataBytes <= 0) {
+        return mState.load() == TranscodeState::Done ? 1.0f : 0.0f;
+    }
+    return static_cast<float>(mBytesDone.load()) / static_cast<float>(dataBytes);
+}
+
+// Walks the RIFF chunks for "fmt " and "data". RF64 files carry the real data
+// size in the ds64 chunk; a capture cut short by a crash has no sizes at all,
+// so the data then runs to the end of the file.
+bool Transcoder::readHeader() {
+    uint8_t riff[12];
+    if (!readFully(mInFd, riff, sizeof(riff), 0) ||
+        (memcmp(riff, "RIFF", 4) != 0 && memcmp(riff, "RF64", 4) != 0) ||
+        memcmp(riff + 8, "WAVE", 4) != 0) {
+        LOGE("Not a WAV file");
+        return false;
+    }
+
+    off_t fileSize = lseek(mInFd, 0, SEEK_END);
+    int64_t ds64DataBytes = -1;
+    int64_t dataBytes = 0;
+    int64_t offset = sizeof(riff);
+
+    while (offset + 8 <= fileSize) {
+        uint8_t chunk[8];
+        if (!readFully(mInFd, chunk, sizeof(chunk), offset)) {
+            break;
+        }
+        uint32_t chunkSize = getLE32(chunk + 4);
+        int64_t body = offset + 8;
+
+        if (memcmp(chunk, "ds64", 4) == 0) {
+            uint8_t ds64[16];
+            if (readFully(mInFd, ds64, sizeof(ds64), body)) {
+                ds64DataBytes = static_cast<int64_t>(getLE64(ds64 + 8));
+            }
+        } else if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (!readFully(mInFd, fmt, sizeof(fmt), body)) {
+                break;
+            }
+            uint16_t formatTag = fmt[0] | (fmt[1] << 8);
+            uint16_t bitsPerSample = fmt[14] | (fmt[15] << 8);
+            if (formatTag != 1 || bitsPerSample != 16) {
+                LOGE("Unsupported WAV format %d/%d bit", formatTag, bitsPerSample);
+                return false;
+            }
+            mChannels = fmt[2] | (fmt[3] << 8);
+            mSampleRate = static_cast<int>(getLE32(fmt + 4));
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            mDataOffset = body;
+
+            int64_t available = fileSize - body;
+            int64_t declared = chunkSize == 0xffffffff ? ds64DataBytes : chunkSize;
+            dataBytes = declared >= 0 ? std::min(declared, available) : available;
+            break;
+        }
+
+        offset = body + chunkSize + (chunkSize & 1);
+    }
+
+    if (mDataOffset == 0 || mSampleRate <= 0 || mChannels <= 0) {
+        LOGE("WAV header incomplete");
+        return false;
+    }
+
+    // Drop a trailing partial frame left by an interrupted capture
+    int64_t frameBytes = mChannels * static_cast<int64_t>(sizeof(int16_t));
+    mDataBytes.store(dataBytes - dataBytes % frameBytes);
+    return true;
+}
+
+void Transcoder::transcodeLoop() {
+    // Keep the job off the cores used by the audio callback. Threads created
+    // from here, including the encoder thread, inherit the nice value.
+    setpriority(PRIO_PROCESS, 0, BACKGROUND_NICE);
+
+    if (!readHeader()) {
+        mState.store(TranscodeState::Failed);
+        return;
+    }
+
+    mRing.setChannels(mChannels);
+
+    const int64_t dataBytes = mDataBytes.load();
+    LOGI("Transcoding %lld bytes, %d Hz, %d channels",
+         (long long) dataBytes, mSampleRate, mChannels);
+
+    // The capture is already at the recording rate; the bitrate follows from it.
+    // A codec that can't be set up fails the job here rather than leaving the
+    // ring without a reader.
+    AacEncoder encoder(mRing, mSampleRate, mChannels, mOutFd, 0, 0, true, EncoderMode::Sync);
+    if (!encoder.prepare()) {
+        LOGE("Failed to set up the encoder");
+        mState.store(TranscodeState::Failed);
+        return;
+    }
+    encoder.start();
+
+    std::vector<int16_t> pcm16(CHUNK_SAMPLES);
+    std::vector<float> samples(CHUNK_SAMPLES);
+    int64_t framePosition = 0;
+    bool ok = true;
+
+    while (mBytesDone.load() < dataBytes && !mCancelled.load()) {
+        size_t bytes = static_cast<size_t>(std::min<int64_t>(
+                dataBytes - mBytesDone.load(), CHUNK_SAMPLES * sizeof(int16_t)));
+        if (!readFully(mInFd, pcm16.data(), bytes, mDataOffset + mBytesDone.load())) {
+            LOGE("Failed to read capture: %s", strerror(errno));
+            ok = false;
+            break;
+        }
+
+        size_t count = bytes / sizeof(int16_t);
+        soundtouch::convertInt16ToFloat(pcm16.data(), samples.data(), count);
+
+        // Positions are contiguous and the time follows from them, so the
+        // encoder never sees a gap
+        PcmBlockInfo info;
+        info.framePosition = framePosition;
+        info.anchorPosition = 0;
+        info.anchorTimeNs = 0;
+
+        // The encoder stops reading if the muxer or codec fails later on
+        while (!mRing.push(samples.data(), count, info) && !mCancelled.load()
+               && !encoder.failed()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        if (encoder.failed()) {
+            LOGE("Encoder failed");
+            ok = false;
+            break;
+        }
+
+        framePosition += static_cast<int64_t>(count / mChannels);
+        mBytesDone.fetch_add(static_cast<int64_t>(bytes));
+    }
+
+    // Let the encoder take everything from the ring before it is stopped;
+    // stop() flushes the last partial frame.
+    while (ok && mRing.size() > 0 && !mCancelled.load() && !encoder.failed()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    encoder.stop();
+    ok = ok && !encoder.failed();
+
+    // Done lets the caller replace the capture with the output, so the output
+    // has to be on disk first
+    if (ok && fsync(mOutFd) != 0) {
+        LOGE("Failed to sync output: %s", strerror(errno));
+        ok = false;
+    }
+
+    if (mCancelled.load()) {
+        mState.store(TranscodeState::Cancelled);
+    } else {
+        mState.store(ok ? TranscodeState::Done : TranscodeState::Failed);
+    }
+    LOGI("Transcode finished with state %d", static_cast<int>(mState.load()));
+}
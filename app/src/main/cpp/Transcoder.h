@@ -0,0 +1,57 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "PcmRingBuffer.h"
+
+enum class TranscodeState {
+    Idle = 0,
+    Running = 1,
+    Done = 2,
+    Failed = 3,
+    Cancelled = 4
+};
+
+// Converts a 16 bit PCM WAV/RF64 capture into AAC/MP4 after the session, on a
+// background priority thread. The capture is fed through a private ring into
+// AacEncoder, so the output is identical to live AAC recording.
+//
+// The MP4 muxer can't append to an existing file, so an interrupted job is
+// resumed by running it again on the same capture.
+class Transcoder {
+public:
+    Transcoder(int inFd, int outFd);
+
+    void start();
+    void cancel();
+
+    TranscodeState state() const {
+        return mState.load();
+    }
+
+    // Fraction of the capture fed to the encoder, 0 to 1
+    float progress() const;
+
+    ~Transcoder() {
+        cancel();
+    }
+
+private:
+    void transcodeLoop();
+    bool readHeader();
+
+    int mInFd;
+    int mOutFd;
+
+    int mSampleRate = 0;
+    int mChannels = 0;
+    int64_t mDataOffset = 0;
+    std::atomic<int64_t> mDataBytes{0};  // read by progress() from other threads
+
+    PcmRingBuffer mRing;
+    std::atomic<int64_t> mBytesDone{0};
+    std::atomic<TranscodeState> mState{TranscodeState::Idle};
+    std::atomic<bool> mCancelled{false};
+    std::thread mThread;
+};
@@ -0,0 +1,227 @@
+#include "WavSink.h"
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <android/log.h>
+#include "soundtouch/include/SampleConvert.h"
+
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "WavSink", __VA_ARGS__)
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, "WavSink", __VA_ARGS__)
+
+static constexpr size_t READ_SAMPLES = 4096;
+static constexpr size_t COALESCE_SAMPLES = 32768;  // 64 KiB per write
+
+// RIFF header with a JUNK chunk that is turned into ds64 for RF64 files
+static constexpr size_t JUNK_OFFSET = 12;
+static constexpr size_t JUNK_SIZE = 28;
+static constexpr size_t FMT_OFFSET = JUNK_OFFSET + 8 + JUNK_SIZE;
+static constexpr size_t DATA_OFFSET = FMT_OFFSET + 8 + 16;
+static constexpr size_t HEADER_SIZE = DATA_OFFSET + 8;
+
+static int64_t elapsedNs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - since).count();
+}
+
+static void putTag(uint8_t* p, const char* tag) {
+    memcpy(p, tag, 4);
+}
+
+static void putLE16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+static void putLE32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = (v >> (8 * i)) & 0xff;
+}
+
+static void putLE64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = (v >> (8 * i)) & 0xff;
+}
+
+WavSink::WavSink(PcmRingBuffer& buffer,
+                 int sampleRate,
+                 int channels,
+                 int fd,
+                 int recordRate)
+        : mReader(buffer, sampleRate, channels, true, recordRate),
+          mSampleRate(mReader.outputRate()),
+          mChannels(channels),
+          mFd(fd),
+          mFloatBuf(READ_SAMPLES),
+          mPcm16(COALESCE_SAMPLES) {}
+
+
+void WavSink::start() {
+    if (mRunning.load()) {
+        LOGE("Sink already running");
+        return;
+    }
+
+    mRunning.store(true);
+    mThread = std::thread(&WavSink::writeLoop, this);
+}
+
+
+void WavSink::stop() {
+    if (!mRunning.load()) {
+        return;
+    }
+
+    mRunning.store(false);
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void WavSink::writeLoop() {
+    LOGI("writeLoop started");
+
+    if (!writeHeader()) {
+        return;
+    }
+
+    while (!mFailed.load()) {
+        // Read the ring empty once more after stop, then finish
+        bool running = mRunning.load();
+
+        int64_t skipped = 0;
+        size_t space = std::min(mFloatBuf.size(), mPcm16.size() - mPending);
+        size_t read = mReader.read(mFloatBuf.data(), space, skipped);
+
+        if (skipped > 0) {
+            LOGI("Skipping discontinuity of %lld frames", (long long) skipped);
+            std::lock_guard<std::mutex> lock(mStatsMutex);
+            mStats.skippedFrames += skipped;
+            mStats.discontinuities = mReader.discontinuityCount();
+            continue;
+        }
+
+        if (read > 0) {
+            auto convertStart = std::chrono::steady_clock::now();
+            soundtouch::convertFloatToInt16(mFloatBuf.data(), mPcm16.data() + mPending, read);
+            mPending += read;
+            {
+                std::lock_guard<std::mutex> lock(mStatsMutex);
+                mStats.convert.add(elapsedNs(convertStart));
+                mStats.framesQueued += static_cast<int64_t>(read / mChannels);
+                mStats.discontinuities = mReader.discontinuityCount();
+            }
+
+            if (mPending == mPcm16.size()) {
+                flush();
+            }
+            continue;
+        }
+
+        if (!running) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    flush();
+    finishHeader();
+
+    LOGI("WAV finished, %llu data bytes", (unsigned long long) mDataBytes);
+}
+
+// Sizes are only known at the end: the header written first carries
+// placeholders and is rewritten on finish. Small files keep a plain RIFF
+// header with the JUNK chunk in place; larger ones switch to RF64 with a
+// ds64 chunk.
+void WavSink::fillHeader(uint8_t* header, bool final) const {
+    uint16_t blockAlign = static_cast<uint16_t>(mChannels * sizeof(int16_t));
+    uint64_t riffSize = HEADER_SIZE - 8 + mDataBytes;
+    bool rf64 = final && riffSize > 0xffffffffULL;
+
+    memset(header, 0, HEADER_SIZE);
+
+    putTag(header, rf64 ? "RF64" : "RIFF");
+    putLE32(header + 4, final && !rf64 ? static_cast<uint32_t>(riffSize) : 0xffffffff);
+    putTag(header + 8, "WAVE");
+
+    putTag(header + JUNK_OFFSET, rf64 ? "ds64" : "JUNK");
+    putLE32(header + JUNK_OFFSET + 4, JUNK_SIZE);
+    if (rf64) {
+        putLE64(header + JUNK_OFFSET + 8, riffSize);
+        putLE64(header + JUNK_OFFSET + 16, mDataBytes);
+        putLE64(header + JUNK_OFFSET + 24, mDataBytes / blockAlign);
+        putLE32(header + JUNK_OFFSET + 32, 0);  // no table entries
+    }
+
+    putTag(header + FMT_OFFSET, "fmt ");
+    putLE32(header + FMT_OFFSET + 4, 16);
+    putLE16(header + FMT_OFFSET + 8, 1);  // PCM
+    putLE16(header + FMT_OFFSET + 10, static_cast<uint16_t>(mChannels));
+    putLE32(header + FMT_OFFSET + 12, static_cast<uint32_t>(mSampleRate));
+    putLE32(header + FMT_OFFSET + 16, static_cast<uint32_t>(mSampleRate) * blockAlign);
+    putLE16(header + FMT_OFFSET + 20, blockAlign);
+    putLE16(header + FMT_OFFSET + 22, 16);
+
+    putTag(header + DATA_OFFSET, "data");
+    putLE32(header + DATA_OFFSET + 4,
+            final && !rf64 ? static_cast<uint32_t>(mDataBytes) : 0xffffffff);
+}
+
+bool WavSink::writeHeader() {
+    uint8_t header[HEADER_SIZE];
+    fillHeader(header, false);
+    return writeAll(header, sizeof(header));
+}
+
+bool WavSink::finishHeader() {
+    uint8_t header[HEADER_SIZE];
+    fillHeader(header, true);
+
+    if (pwrite(mFd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        LOGE("Failed to update header: %s", strerror(errno));
+        mFailed.store(true);
+        return false;
+    }
+    return true;
+}
+
+bool WavSink::writeAll(const void* data, size_t size) {
+    auto* p = static_cast<const uint8_t*>(data);
+
+    while (size > 0) {
+        ssize_t written = write(mFd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+
+            LOGE("Write failed: %s", strerror(errno));
+            mFailed.store(true);
+            return false;
+        }
+        p += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool WavSink::flush() {
+    if (mPending == 0 || mFailed.load()) {
+        return !mFailed.load();
+    }
+
+    size_t bytes = mPending * sizeof(int16_t);
+    auto writeStart = std::chrono::steady_clock::now();
+    bool ok = writeAll(mPcm16.data(), bytes);
+    if (ok) {
+        mDataBytes += bytes;
+
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        mStats.write.add(elapsedNs(writeStart));
+        mStats.bytesWritten += static_cast<int64_t>(bytes);
+    }
+    mPending = 0;
+    return ok;
+}
+
+RecordingStats WavSink::stats() const {
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    return mStats;
+}
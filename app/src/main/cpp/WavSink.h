@@ -0,0 +1,69 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include "PcmRingBuffer.h"
+#include "PcmStreamReader.h"
+#include "RecordingSink.h"
+
+
+// Streams the recording as 16 bit PCM WAV without any encoding. Samples are
+// coalesced into large buffers before they are written to the fd, and the
+// header sizes are fixed up when the recording stops. Recordings over 4 GB
+// are turned into RF64 through the JUNK chunk reserved in the header.
+class WavSink : public RecordingSink {
+public:
+    // recordRate below sampleRate decimates the stream, 0 keeps its rate
+    WavSink(PcmRingBuffer& buffer,
+            int sampleRate,
+            int channels,
+            int fd,
+            int recordRate = 0);
+
+    void start() override;
+    void stop() override;
+
+    void setPreRoll(std::unique_ptr<PreRollSnapshot> snapshot) override {
+        mReader.setPreRoll(std::move(snapshot));
+    }
+
+    RecordingStats stats() const override;
+
+    // Set when a write to the fd or the final header update failed. The
+    // file then ends at the last complete write or has placeholder sizes.
+    bool failed() const {
+        return mFailed.load();
+    }
+
+    ~WavSink() override {
+        stop();
+    }
+
+private:
+    void writeLoop();
+
+    void fillHeader(uint8_t* header, bool final) const;
+    bool writeHeader();
+    bool finishHeader();
+    bool writeAll(const void* data, size_t size);
+    bool flush();
+
+    PcmStreamReader mReader;
+    int mSampleRate;  // written rate, the stream rate may be higher
+    int mChannels;
+    int mFd;
+
+    std::vector<float> mFloatBuf;
+    std::vector<int16_t> mPcm16;
+    size_t mPending = 0;
+    uint64_t mDataBytes = 0;
+    std::atomic<bool> mFailed{false};
+
+    mutable std::mutex mStatsMutex;
+    RecordingStats mStats;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning{false};
+};
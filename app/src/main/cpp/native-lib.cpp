@@ -4,6 +4,7 @@
 #include <android/log.h>
 #include "soundtouch/include/SoundTouch.h"
 #include "AudioEngine.h"
+#include "Transcoder.h"
 
 using namespace soundtouch;
 
@@ -12,6 +13,10 @@ using namespace soundtouch;
 static std::unique_ptr<AudioEngine> engine;
 static std::mutex engineMutex;
 
+// Transcode jobs run independently of the engine, one at a time
+static std::unique_ptr<Transcoder> transcoder;
+static std::mutex transcoderMutex;
+
 static AudioEngine* getEngine() {
     std::lock_guard<std::mutex> lock(engineMutex);
     if (!engine) {
@@ -104,12 +109,68 @@ Java_com_pragmatsoft_faf_services_audio_NativeWrapper_setGainType(
     if (e) e->setGainType(value);
 }
 
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_setPitchEngine(
+        JNIEnv*, jobject, jint value) {
+    AudioEngine* e = getEngine();
+    if (e) e->setPitchEngine(value);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_setFrequencyShift(
+        JNIEnv*, jobject, jfloat value) {
+    AudioEngine* e = getEngine();
+    if (e) e->setFrequencyShift(value);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_getPitchLatencyFrames(JNIEnv*, jobject) {
+    AudioEngine* e = getEngine();
+    return e ? e->getPitchLatencyFrames() : 0;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_setPreRollSeconds(
+        JNIEnv*, jobject, jint value) {
+    AudioEngine* e = getEngine();
+    if (e) e->setPreRollSeconds(value);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_prepareRecording(
+        JNIEnv*, jobject, jint source, jint sampleRate, jint bitrate) {
+    AudioEngine* e = getEngine();
+    if (e) e->prepareRecording(source, sampleRate, bitrate);
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_pragmatsoft_faf_services_audio_NativeWrapper_startRecording(
-        JNIEnv*, jobject, jint fd) {
+        JNIEnv*, jobject, jint fd, jint sinkType, jint source, jint sampleRate, jint bitrate,
+        jint preRollSeconds) {
+    AudioEngine* e = getEngine();
+    if (e) e->startRecording(fd, sinkType, source, sampleRate, bitrate, preRollSeconds);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_startSegmentedRecording(
+        JNIEnv* env, jobject, jstring directory, jint segmentSeconds, jlong segmentBytes,
+        jint source, jint sampleRate, jint bitrate, jint preRollSeconds) {
     AudioEngine* e = getEngine();
-    if (e) e->startRecording(fd);
+    if (!e) return;
+
+    const char* path = env->GetStringUTFChars(directory, nullptr);
+    std::string dir(path);
+    env->ReleaseStringUTFChars(directory, path);
+
+    e->startSegmentedRecording(dir, segmentSeconds, segmentBytes, source, sampleRate, bitrate,
+                               preRollSeconds);
 }
 
 extern "C"
@@ -117,4 +178,67 @@ JNIEXPORT void JNICALL
 Java_com_pragmatsoft_faf_services_audio_NativeWrapper_stopRecording(JNIEnv*, jobject) {
     AudioEngine* e = getEngine();
     if (e) e->stopRecording();
-}
\ No newline at end of file
+}
+
+// Flattened in the order RecordingStats.fromArray() reads it on the Kotlin side
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_getRecordingStats(JNIEnv* env, jobject) {
+    AudioEngine* e = getEngine();
+    RecordingStats s = e ? e->getRecordingStats() : RecordingStats();
+
+    const jlong values[] = {
+            s.framesQueued, s.bytesWritten, s.droppedSamples, s.skippedFrames,
+            s.discontinuities,
+            s.ringOccupancy, s.ringHighWater, s.ringCapacity,
+            s.codecQueueDepth, s.codecQueueMax,
+            s.convert.count, s.convert.totalNs, s.convert.maxNs,
+            s.encode.count, s.encode.totalNs, s.encode.maxNs,
+            s.write.count, s.write.totalNs, s.write.maxNs,
+            s.firstSampleLatencyNs,
+            s.truncatedInputFrames, s.pitchOverruns
+    };
+    const jint count = sizeof(values) / sizeof(values[0]);
+
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values);
+    }
+    return result;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_startTranscode(
+        JNIEnv*, jobject, jint inFd, jint outFd) {
+    std::lock_guard<std::mutex> lock(transcoderMutex);
+    if (transcoder && transcoder->state() == TranscodeState::Running) {
+        return JNI_FALSE;
+    }
+
+    transcoder = std::make_unique<Transcoder>(inFd, outFd);
+    transcoder->start();
+    return JNI_TRUE;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_getTranscodeState(JNIEnv*, jobject) {
+    std::lock_guard<std::mutex> lock(transcoderMutex);
+    return transcoder ? static_cast<jint>(transcoder->state())
+                      : static_cast<jint>(TranscodeState::Idle);
+}
+
+extern "C"
+JNIEXPORT jfloat JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_getTranscodeProgress(JNIEnv*, jobject) {
+    std::lock_guard<std::mutex> lock(transcoderMutex);
+    return transcoder ? transcoder->progress() : 0.0f;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_pragmatsoft_faf_services_audio_NativeWrapper_releaseTranscode(JNIEnv*, jobject) {
+    std::lock_guard<std::mutex> lock(transcoderMutex);
+    transcoder = nullptr;
+}
@@ -73,6 +73,9 @@ private:
     /// only new data when is put to the pipe.
     uint bufferPos;
 
+    /// Flag: Is the capacity fixed by 'reserve'?
+    bool bFixedCapacity;
+
     /// Rewind the buffer by moving data from position pointed by 'bufferPos' to real
     /// beginning of the buffer.
     void rewind();
@@ -80,6 +83,9 @@ private:
     /// Ensures that the buffer has capacity for at least this many samples.
     void ensureCapacity(uint capacityRequirement);
 
+    /// Reallocates the buffer for this many samples.
+    void reallocate(uint capacity);
+
     /// Returns current capacity.
     uint getCapacity() const;
 
@@ -173,6 +179,12 @@ public:
 
     /// Add silence to end of buffer
     void addSilent(uint nSamples);
+
+    /// Presizes the buffer for 'numSamples' samples and fixes its capacity, so that
+    /// the buffer doesn't allocate memory any more but throws an error if it would
+    /// need to grow. Zero releases the fix. Notice that the capacity in samples
+    /// shrinks if the number of channels is increased.
+    void reserve(uint numSamples);
 };
 
 }
@@ -111,6 +111,22 @@ public:
     virtual uint receiveSamples(uint maxSamples   ///< Remove this many samples from the beginning of pipe.
                                 ) = 0;
 
+    /// Output samples from beginning of the sample buffer without copying them. Sets
+    /// '*samples' to point to the output samples and removes them from the sample
+    /// buffer. The samples pointed to stay valid until the next call that puts
+    /// samples into the pipe, processes or clears it.
+    ///
+    /// \return Number of samples returned.
+    uint receiveSamplesView(const SAMPLETYPE **samples, ///< Receives pointer to the output samples.
+                            uint maxSamples             ///< How many samples to receive at max.
+                            )
+    {
+        const uint num = (maxSamples < numSamples()) ? maxSamples : numSamples();
+
+        *samples = (num > 0) ? ptrBegin() : nullptr;
+        return receiveSamples(num);
+    }
+
     /// Returns number of samples currently available.
     virtual uint numSamples() const = 0;
 
@@ -159,6 +159,11 @@ namespace soundtouch
             #define SOUNDTOUCH_ALLOW_SSE       1
         #endif
 
+        #ifdef SOUNDTOUCH_USE_NEON
+            // Allow NEON optimizations
+            #define SOUNDTOUCH_ALLOW_NEON      1
+        #endif
+
     #endif  // SOUNDTOUCH_INTEGER_SAMPLES
 
     #if ((SOUNDTOUCH_ALLOW_SSE) || (__SSE__) || (SOUNDTOUCH_USE_NEON))
@@ -185,7 +190,9 @@ namespace soundtouch
 // When this #define is active, eliminates a clicking sound when the "rate" or "pitch"
 // parameter setting crosses from value <1 to >=1 or vice versa during processing.
 // Default is off as such crossover is untypical case and involves a slight sound
-// quality compromise.
+// quality compromise. Without it, the crossover passes the rate transposer to the
+// other side of the tempo changer through rate 1, which is seamless when the change
+// ramps over SETTING_PARAMETER_RAMP_MS.
 //#define SOUNDTOUCH_PREVENT_CLICK_AT_RATE_CROSSOVER   1
 
 #endif
@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Sample format conversion routines between 32bit floating point samples and
+/// 16/24bit integer samples.
+///
+/// Float samples are scaled so that the range [-1.0, 1.0) maps to the full
+/// integer range; results are truncated towards zero and saturated to the
+/// integer range. The 16bit conversion can optionally add triangular (TPDF)
+/// dither of +-1 LSB before the truncation.
+///
+/// The routines use NEON, SSE2 or AVX2 instructions when available, and produce
+/// bit-identical results with the plain C++ routines on every platform.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SampleConvert_H
+#define SampleConvert_H
+
+#include "STTypes.h"
+
+namespace soundtouch
+{
+
+/// Number of independent random generator lanes in the dither state. Sample 'i'
+/// of each conversion call draws from lane 'i % SOUNDTOUCH_DITHER_LANES'.
+#define SOUNDTOUCH_DITHER_LANES     8
+
+/// State of the dither noise generator: one xorshift32 generator per lane, so
+/// that SIMD routines can advance all lanes in parallel.
+struct DitherState
+{
+    unsigned int lane[SOUNDTOUCH_DITHER_LANES];
+
+    DitherState(unsigned int seed = 1);
+};
+
+/// Converts float samples to 16bit integers with saturation.
+void convertFloatToInt16(const float *src, short *dest, uint numSamples);
+
+/// Converts float samples to 16bit integers with TPDF dither and saturation.
+void convertFloatToInt16Dither(const float *src, short *dest, uint numSamples,
+                               DitherState &dither);
+
+/// Converts 16bit integer samples to float.
+void convertInt16ToFloat(const short *src, float *dest, uint numSamples);
+
+/// Converts float samples to 24bit integers with saturation. The result is
+/// stored sign-extended into 32bit integers.
+void convertFloatToInt24(const float *src, int *dest, uint numSamples);
+
+}
+
+#endif
@@ -164,6 +164,83 @@ namespace soundtouch
 ///   tempo/pitch/rate/samplerate settings.
 #define SETTING_INITIAL_LATENCY             8
 
+/// Enable/disable FFT based cross-correlation in the tempo changer's full-quality
+/// overlap seek (used when SETTING_USE_QUICKSEEK is disabled). Finds the same
+/// overlap positions as the plain full seek at a fraction of the CPU cost with
+/// large seek windows. Floating point sample builds only.
+#define SETTING_USE_FFT_SEEK                9
+
+/// Enable/disable multi-resolution overlap seek in the tempo changer routine: a
+/// search over all offsets on 4x or 8x decimated signals, refined at full resolution
+/// around the best candidates. Matches better than SETTING_USE_QUICKSEEK at a lower
+/// CPU cost, and overrides the other seek settings when enabled.
+#define SETTING_USE_MULTIRES_SEEK           10
+
+/// Enable/disable predictive overlap seek in the tempo changer routine. Each seek
+/// first probes a narrow window around the offset that keeps the waveform in phase
+/// with the previous sequence, based on an estimate of the pitch period, and falls
+/// back to the seek selected with the other seek settings only if that finds no
+/// good match. Suits voiced speech & other strongly periodic sound. Enabling
+/// resets the statistics below.
+#define SETTING_USE_PREDICTIVE_SEEK         11
+
+/// Call "getSetting" with this ID to query the share of the predictive seeks that
+/// were resolved by the probe around the predicted offset, in 1/1000 units. The
+/// rest fell back to the search over the whole seek window.
+///
+/// This is read-only parameter, i.e. setSetting ignores this parameter
+#define SETTING_PREDICTIVE_SEEK_HIT_RATE    12
+
+/// Call "getSetting" with this ID to query the average number of offsets correlated
+/// per predictive seek by the probes, not counting the fall-back searches.
+///
+/// This is read-only parameter, i.e. setSetting ignores this parameter
+#define SETTING_PREDICTIVE_SEEK_PROBES      13
+
+/// Select the tempo changer engine, one of the TEMPO_ENGINE_... values below.
+/// Changing the engine clears the samples in the processing pipeline.
+#define SETTING_TEMPO_ENGINE                14
+
+/// Tempo changer engine: the default WSOLA routine, which overlaps fixed-length
+/// sequences at the best matching positions. Suits music & general audio, and
+/// is controlled by the sequence, seek window, overlap & seek settings above.
+#define TEMPO_ENGINE_WSOLA                  0
+
+/// Tempo changer engine: pitch-synchronous overlap-add (PSOLA). Repeats or skips
+/// whole pitch periods found by a pitch detector. Meant for speech, where it needs
+/// less lookahead & correlation work than WSOLA. The WSOLA settings don't apply.
+#define TEMPO_ENGINE_PSOLA                  1
+
+/// Tempo changer engine: phase vocoder with phase locking. Stretches the short-time
+/// spectrum, so that larger pitch shifts with the rate transposer stay clear of
+/// the warble of time-domain splicing, at the cost of a frame of latency & some
+/// smearing of transients. Its frame is set by SETTING_VOCODER_FRAME_MS.
+#define TEMPO_ENGINE_PHASE_VOCODER          2
+
+/// Low-latency mode of the WSOLA tempo changer, with the lookahead bound in
+/// milliseconds, or 0 (default) to disable. A sequence is begun as soon as the
+/// seek window is in the input and output as far as the input reaches, instead
+/// of waiting for the whole sequence. If the seek window plus overlap exceed the
+/// bound, the seek window is shortened, so smaller values lower the latency at
+/// the cost of poorer matching overlaps.
+///
+/// In this mode SETTING_INITIAL_LATENCY is also the steady-state latency bound,
+/// as output then follows the input instead of coming in sequence-long batches.
+#define SETTING_LOW_LATENCY_MS              15
+
+/// Duration in milliseconds over which tempo, rate & pitch changes ramp from the
+/// values in use to the new ones, or 0 (default) to apply them at once. Ramping
+/// lets the settings change during processing, e.g. for pitch sweeps, without
+/// clicks or clearing the buffers. The values ramp geometrically in steps of a
+/// few milliseconds of input, and a new change ramps on from where the previous
+/// one has got.
+#define SETTING_PARAMETER_RAMP_MS           16
+
+/// Analysis frame length of the phase vocoder tempo changer in milliseconds,
+/// rounded up to a power of two samples. Default 40 ms, which resolves the
+/// harmonics of low voices also when the rate transposer has lowered them.
+#define SETTING_VOCODER_FRAME_MS            17
+
 
 class SoundTouch : public FIFOProcessor
 {
@@ -174,6 +251,15 @@ private:
     /// Time-stretch class instance
     class TDStretch *pTDStretch;
 
+    /// Pitch-synchronous time-stretch class instance
+    class PSOLAStretch *pPSOLAStretch;
+
+    /// Phase vocoder time-stretch class instance
+    class PhaseVocoderStretch *pVocoderStretch;
+
+    /// The selected one of the time-stretch instances
+    class StretchBase *pStretch;
+
     /// Virtual pitch parameter. Effective rate & tempo are calculated from these parameters.
     double virtualRate;
 
@@ -193,18 +279,61 @@ private:
     /// Accumulator for how many samples in total have been read out from the processing so far
     long   samplesOutput;
 
-    /// Calculates effective rate & tempo valuescfrom 'virtualRate', 'virtualTempo' and
-    /// 'virtualPitch' parameters.
+    /// Control values in use, which follow the 'virtual...' parameters over a ramp
+    /// if 'rampMs' is set. Effective rate & tempo are calculated from these.
+    double rampedRate;
+    double rampedTempo;
+    double rampedPitch;
+
+    /// Duration of the control value ramps in milliseconds
+    int    rampMs;
+
+    /// Input samples left until the ramped control values reach the virtual ones
+    uint   rampRemaining;
+
+    /// Position of the rate transposer in the pipeline, 'TRANSPOSE_...'
+    int    transposerPosition;
+
+    /// The rate transposer is to be drained & taken out of the pipeline when the
+    /// current step of a ramp has been processed
+    bool   bDrainTransposer;
+
+    /// Largest input block, tempo & rate ratio and output left unreceived that the
+    /// buffers have been reserved for by 'reserve', zero block if not reserved
+    uint   reservedFrames;
+    double reservedRatio;
+    uint   reservedBacklog;
+
+    /// Calculates effective rate & tempo valuescfrom 'rampedRate', 'rampedTempo' and
+    /// 'rampedPitch' parameters.
     void calcEffectiveRateAndTempo();
 
+    /// Starts ramping the control values in use to the 'virtual...' parameters, or
+    /// sets them at once if there's no ramp. Returns false, changing nothing, if
+    /// they're out of the range reserved by 'reserve'.
+    bool updateControls();
+
+    /// Advances the control value ramp by 'numSamples' samples of input
+    void advanceRamp(uint numSamples);
+
+    /// Points the rate transposer to the buffers of the tempo changer it's chained with
+    /// in the current processing order
+    void chainStages();
+
+    /// Takes the drained rate transposer out of the pipeline
+    void bypassTransposer();
+
+    /// Processes 'nSamples' of input with the current control values
+    void processBlock(const SAMPLETYPE *samples, uint nSamples);
+
 protected :
     /// Number of channels
     uint  channels;
 
-    /// Effective 'rate' value calculated from 'virtualRate', 'virtualTempo' and 'virtualPitch'
+    /// Effective 'rate' value calculated from 'rampedRate', 'rampedTempo' and 'rampedPitch'
     double rate;
 
-    /// Effective 'tempo' value calculated from 'virtualRate', 'virtualTempo' and 'virtualPitch'
+    /// Effective 'tempo' value calculated from 'rampedRate', 'rampedTempo' and 'rampedPitch'
     double tempo;
 
 public:
@@ -219,32 +348,50 @@ public:
 
     /// Sets new rate control value. Normal rate = 1.0, smaller values
     /// represent slower rate, larger faster rates.
-    void setRate(double newRate);
+    ///
+    /// Returns false and keeps the previous value if the new one would take the
+    /// effective tempo or rate out of the range reserved by 'reserve'.
+    bool setRate(double newRate);
 
     /// Sets new tempo control value. Normal tempo = 1.0, smaller values
     /// represent slower tempo, larger faster tempo.
-    void setTempo(double newTempo);
+    ///
+    /// Returns false and keeps the previous value if the new one would take the
+    /// effective tempo or rate out of the range reserved by 'reserve'.
+    bool setTempo(double newTempo);
 
     /// Sets new rate control value as a difference in percents compared
     /// to the original rate (-50 .. +100 %)
-    void setRateChange(double newRate);
+    ///
+    /// Returns false and keeps the previous value if the new one would take the
+    /// effective tempo or rate out of the range reserved by 'reserve'.
+    bool setRateChange(double newRate);
 
     /// Sets new tempo control value as a difference in percents compared
     /// to the original tempo (-50 .. +100 %)
-    void setTempoChange(double newTempo);
+    ///
+    /// Returns false and keeps the previous value if the new one would take the
+    /// effective tempo or rate out of the range reserved by 'reserve'.
+    bool setTempoChange(double newTempo);
 
     /// Sets new pitch control value. Original pitch = 1.0, smaller values
     /// represent lower pitches, larger values higher pitch.
-    void setPitch(double newPitch);
+    ///
+    /// Returns false and keeps the previous value if the new one would take the
+    /// effective tempo or rate out of the range reserved by 'reserve'.
+    bool setPitch(double newPitch);
 
     /// Sets pitch change in octaves compared to the original pitch
     /// (-1.00 .. +1.00)
-    void setPitchOctaves(double newPitch);
+    ///
+    /// Returns false and keeps the previous value if the new one would take the
+    /// effective tempo or rate out of the range reserved by 'reserve'.
+    bool setPitchOctaves(double newPitch);
 
     /// Sets pitch change in semi-tones compared to the original pitch
     /// (-12 .. +12)
-    void setPitchSemiTones(int newPitch);
-    void setPitchSemiTones(double newPitch);
+    bool setPitchSemiTones(int newPitch);
+    bool setPitchSemiTones(double newPitch);
 
     /// Sets the number of channels, 1 = mono, 2 = stereo
     void setChannels(uint numChannels);
@@ -279,6 +426,23 @@ public:
     /// in the middle of a sound stream.
     void flush();
 
+    /// Presizes all the processing buffers for real-time use, for input blocks of up
+    /// to 'maxBlockFrames' samples with the effective tempo & rate each between
+    /// 1/'maxRatio' and 'maxRatio'. After this the processing, flushing & clearing,
+    /// and tempo, rate & pitch changes within the range don't allocate memory, as
+    /// long as the output is received after each block so that there's at most a
+    /// block's output left in it.
+    ///
+    /// Exceeding the reservation is refused instead of allocating: 'tryPutSamples'
+    /// returns false for a larger block or more output left unreceived, & the tempo,
+    /// rate & pitch setters for values out of the range, so that a real-time
+    /// caller doesn't need to catch exceptions. 'putSamples' throws a
+    /// runtime_error exception for the block, as does a change of the sample rate
+    /// or channels. 'setSetting'
+    /// returns false for the settings that resize the buffers, so set those first.
+    /// Zero 'maxBlockFrames' ends the reservation.
+    void reserve(uint maxBlockFrames, double maxRatio = 2.0);
+
     /// Adds 'numSamples' pcs of samples from the 'samples' memory position into
     /// the input of the object. Notice that sample rate _has_to_ be set before
     /// calling this function, otherwise throws a runtime_error exception.
@@ -289,6 +453,11 @@ public:
                                                     ///< contains data for both channels.
             ) override;
 
+    /// Like 'putSamples', but returns false instead of throwing when the block or
+    /// the output left unreceived exceed the buffers reserved by 'reserve', or the
+    /// sample rate or channels aren't set. The samples are then left unprocessed.
+    bool tryPutSamples(const SAMPLETYPE *samples, uint numSamples);
+
     /// Output samples from beginning of the sample buffer. Copies requested samples to
     /// output buffer and removes them from the sample buffer. If there are less than
     /// 'numsample' samples in the buffer, returns all that available.
@@ -12,7 +12,9 @@ LOCAL_SRC_FILES := soundtouch-jni.cpp ../../SoundTouch/AAFilter.cpp  ../../Sound
                 ../../SoundTouch/RateTransposer.cpp ../../SoundTouch/SoundTouch.cpp \
                 ../../SoundTouch/InterpolateCubic.cpp ../../SoundTouch/InterpolateLinear.cpp \
                 ../../SoundTouch/InterpolateShannon.cpp ../../SoundTouch/TDStretch.cpp \
-                ../../SoundTouch/BPMDetect.cpp ../../SoundTouch/PeakFinder.cpp 
+                ../../SoundTouch/BPMDetect.cpp ../../SoundTouch/PeakFinder.cpp \
+                ../../SoundTouch/RealFFT.cpp ../../SoundTouch/PSOLAStretch.cpp \
+                ../../SoundTouch/PhaseVocoderStretch.cpp ../../SoundTouch/SampleConvert.cpp
 
 # for native audio
 LOCAL_SHARED_LIBRARIES += -lgcc 
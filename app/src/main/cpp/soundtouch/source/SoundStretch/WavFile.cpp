@@ -47,6 +47,7 @@
 
 #include "WavFile.h"
 #include "STTypes.h"
+#include "SampleConvert.h"
 
 using namespace std;
 
@@ -406,12 +407,8 @@ int WavInFile::read(float* buffer, int maxElems)
     case 2:
     {
         short* temp2 = (short*)temp;
-        double conv = 1.0 / 32768.0;
-        for (int i = 0; i < numElems; i++)
-        {
-            short value = temp2[i];
-            buffer[i] = (float)(_swap16(value) * conv);
-        }
+        _swap16Buffer(temp2, numElems);
+        soundtouch::convertInt16ToFloat(temp2, buffer, numElems);
         break;
     }
 
@@ -937,22 +934,24 @@ void WavOutFile::write(const float* buffer, int numElems)
     case 2:
     {
         short* temp2 = (short*)temp;
-        for (int i = 0; i < numElems; i++)
-        {
-            short value = (short)saturate(buffer[i] * 32768.0f, -32768.0f, 32767.0f);
-            temp2[i] = _swap16(value);
-        }
+        soundtouch::convertFloatToInt16(buffer, temp2, numElems);
+        _swap16Buffer(temp2, numElems);
         break;
     }
 
     case 3:
     {
         char* temp2 = (char*)temp;
-        for (int i = 0; i < numElems; i++)
+        int values[256];
+        for (int i = 0; i < numElems; i += 256)
         {
-            int value = saturate(buffer[i] * 8388608.0f, -8388608.0f, 8388607.0f);
-            *((int*)temp2) = _swap32(value);
-            temp2 += 3;
+            int count = (numElems - i < 256) ? numElems - i : 256;
+            soundtouch::convertFloatToInt24(buffer + i, values, count);
+            for (int j = 0; j < count; j++)
+            {
+                *((int*)temp2) = _swap32(values[j]);
+                temp2 += 3;
+            }
         }
         break;
     }
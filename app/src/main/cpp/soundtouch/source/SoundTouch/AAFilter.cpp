@@ -78,6 +78,9 @@ AAFilter::AAFilter(uint len)
 {
     pFIR = FIRFilter::newInstance();
     cutoffFreq = 0.5;
+    length = 0;
+    work = nullptr;
+    coeffs = nullptr;
     setLength(len);
 }
 
@@ -85,6 +88,8 @@ AAFilter::AAFilter(uint len)
 AAFilter::~AAFilter()
 {
     delete pFIR;
+    delete[] work;
+    delete[] coeffs;
 }
 
 
@@ -101,6 +106,13 @@ void AAFilter::setCutoffFreq(double newCutoffFreq)
 // Sets number of FIR filter taps
 void AAFilter::setLength(uint newLength)
 {
+    if (newLength != length)
+    {
+        delete[] work;
+        delete[] coeffs;
+        work = new double[newLength];
+        coeffs = new SAMPLETYPE[newLength];
+    }
     length = newLength;
     calculateCoeffs();
 }
@@ -113,17 +125,12 @@ void AAFilter::calculateCoeffs()
     double cntTemp, temp, tempCoeff,h, w;
     double wc;
     double scaleCoeff, sum;
-    double *work;
-    SAMPLETYPE *coeffs;
 
     assert(length >= 2);
     assert(length % 4 == 0);
     assert(cutoffFreq >= 0);
     assert(cutoffFreq <= 0.5);
 
-    work = new double[length];
-    coeffs = new SAMPLETYPE[length];
-
     wc = 2.0 * PI * cutoffFreq;
     tempCoeff = TWOPI / (double)length;
 
@@ -176,9 +183,6 @@ void AAFilter::calculateCoeffs()
     pFIR->setCoefficients(coeffs, length, 14);
 
     _DEBUG_SAVE_AAFIR_COEFFS(coeffs, length);
-
-    delete[] work;
-    delete[] coeffs;
 }
 
 
@@ -54,6 +54,11 @@ protected:
     /// num of filter taps
     uint length;
 
+    /// Work arrays of 'calculateCoeffs', allocated with the length so that a new
+    /// cutoff frequency doesn't allocate memory
+    double *work;
+    SAMPLETYPE *coeffs;
+
     /// Calculate the FIR coefficients realizing the given cutoff-frequency
     void calculateCoeffs();
 public:
@@ -55,6 +55,7 @@ FIFOSampleBuffer::FIFOSampleBuffer(int numChannels)
     samplesInBuffer = 0;
     bufferPos = 0;
     channels = (uint)numChannels;
+    bFixedCapacity = false;
     ensureCapacity(32);     // allocate initial capacity
 }
 
@@ -75,6 +76,9 @@ void FIFOSampleBuffer::setChannels(int numChannels)
 
     if (!verifyNumberOfChannels(numChannels)) return;
 
+    // 'bufferPos' counts in samples of the old channel count
+    rewind();
+
     usedBytes = channels * samplesInBuffer;
     channels = (uint)numChannels;
     samplesInBuffer = usedBytes / channels;
@@ -134,7 +138,7 @@ void FIFOSampleBuffer::putSamples(uint nSamples)
 SAMPLETYPE *FIFOSampleBuffer::ptrEnd(uint slackCapacity)
 {
     ensureCapacity(samplesInBuffer + slackCapacity);
-    return buffer + samplesInBuffer * channels;
+    return buffer + (bufferPos + samplesInBuffer) * channels;
 }
 
 
@@ -156,39 +160,69 @@ SAMPLETYPE *FIFOSampleBuffer::ptrBegin()
 // 'capacityRequirement' number of samples. The buffer is grown in steps of
 // 4 kilobytes to eliminate the need for frequently growing up the buffer,
 // as well as to round the buffer size up to the virtual memory page size.
+// The samples are rewound to the beginning of the buffer only when there's
+// too little space left after them, rather than every time samples are put,
+// and the buffer is grown to twice the requirement so that the samples in it
+// don't need rewinding every few times either.
 void FIFOSampleBuffer::ensureCapacity(uint capacityRequirement)
 {
-    SAMPLETYPE *tempUnaligned, *temp;
-
     if (capacityRequirement > getCapacity())
     {
-        // enlarge the buffer in 4kbyte steps (round up to next 4k boundary)
-        sizeInBytes = (capacityRequirement * channels * sizeof(SAMPLETYPE) + 4095) & (uint)-4096;
-        assert(sizeInBytes % 2 == 0);
-        tempUnaligned = new SAMPLETYPE[sizeInBytes / sizeof(SAMPLETYPE) + 16 / sizeof(SAMPLETYPE)];
-        if (tempUnaligned == nullptr)
+        if (bFixedCapacity)
         {
-            ST_THROW_RT_ERROR("Couldn't allocate memory!\n");
+            ST_THROW_RT_ERROR("FIFOSampleBuffer : Reserved capacity exceeded");
         }
-        // Align the buffer to begin at 16byte cache line boundary for optimal performance
-        temp = (SAMPLETYPE *)SOUNDTOUCH_ALIGN_POINTER_16(tempUnaligned);
-        if (samplesInBuffer)
-        {
-            memcpy(temp, ptrBegin(), samplesInBuffer * channels * sizeof(SAMPLETYPE));
-        }
-        delete[] bufferUnaligned;
-        buffer = temp;
-        bufferUnaligned = tempUnaligned;
-        bufferPos = 0;
+        reallocate(2 * capacityRequirement);
     }
-    else
+    else if (bufferPos + capacityRequirement > getCapacity())
     {
-        // simply rewind the buffer (if necessary)
+        // simply rewind the buffer
         rewind();
     }
 }
 
 
+// Reallocates the buffer for 'capacity' samples, rounded up to the next 4 kilobytes
+// i.e. the virtual memory page size, and moves the samples to its beginning.
+void FIFOSampleBuffer::reallocate(uint capacity)
+{
+    SAMPLETYPE *tempUnaligned, *temp;
+
+    sizeInBytes = (capacity * channels * sizeof(SAMPLETYPE) + 4095) & (uint)-4096;
+    assert(sizeInBytes % 2 == 0);
+    tempUnaligned = new SAMPLETYPE[sizeInBytes / sizeof(SAMPLETYPE) + 16 / sizeof(SAMPLETYPE)];
+    if (tempUnaligned == nullptr)
+    {
+        ST_THROW_RT_ERROR("Couldn't allocate memory!\n");
+    }
+    // Align the buffer to begin at 16byte cache line boundary for optimal performance
+    temp = (SAMPLETYPE *)SOUNDTOUCH_ALIGN_POINTER_16(tempUnaligned);
+    if (samplesInBuffer)
+    {
+        memcpy(temp, ptrBegin(), samplesInBuffer * channels * sizeof(SAMPLETYPE));
+    }
+    delete[] bufferUnaligned;
+    buffer = temp;
+    bufferUnaligned = tempUnaligned;
+    bufferPos = 0;
+}
+
+
+// Presizes the buffer for 'numSamples' samples and fixes the capacity, so that
+// the buffer doesn't allocate memory until the fix is released with zero.
+void FIFOSampleBuffer::reserve(uint numSamples)
+{
+    bFixedCapacity = false;
+    if (numSamples == 0) return;
+
+    if (numSamples > getCapacity())
+    {
+        reallocate(numSamples);
+    }
+    bFixedCapacity = true;
+}
+
+
 // Returns the current buffer capacity in terms of samples
 uint FIFOSampleBuffer::getCapacity() const
 {
@@ -230,6 +264,7 @@ uint FIFOSampleBuffer::receiveSamples(uint maxSamples)
 
         temp = samplesInBuffer;
         samplesInBuffer = 0;
+        bufferPos = 0;
         return temp;
     }
 
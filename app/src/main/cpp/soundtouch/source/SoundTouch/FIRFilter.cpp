@@ -206,17 +206,21 @@ void FIRFilter::setCoefficients(const SAMPLETYPE *coeffs, uint newLength, uint u
     assert(newLength > 0);
     if (newLength % 8) ST_THROW_RT_ERROR("FIR filter length not divisible by 8");
 
+    // reallocate only if the length changes, as the cutoff changes with the rate
+    if ((newLength != length) || (filterCoeffs == nullptr))
+    {
+        delete[] filterCoeffs;
+        filterCoeffs = new SAMPLETYPE[newLength];
+        delete[] filterCoeffsStereo;
+        filterCoeffsStereo = new SAMPLETYPE[newLength*2];
+    }
+
     lengthDiv8 = newLength / 8;
     length = lengthDiv8 * 8;
     assert(length == newLength);
 
     resultDivFactor = uResultDivFactor;
 
-    delete[] filterCoeffs;
-    filterCoeffs = new SAMPLETYPE[length];
-    delete[] filterCoeffsStereo;
-    filterCoeffsStereo = new SAMPLETYPE[length*2];
-
 #ifdef SOUNDTOUCH_FLOAT_SAMPLES
     // scale coefficients already here if using floating samples
     const double scale = ::pow(0.5, (int)resultDivFactor);;
@@ -287,7 +291,7 @@ FIRFilter * FIRFilter::newInstance()
     uExtensions = detectCPUextensions();
     (void)uExtensions;
 
-    // Check if MMX/SSE instruction set extensions supported by CPU
+    // Check which instruction set extensions are supported by CPU, widest first
 
 #ifdef SOUNDTOUCH_ALLOW_MMX
     // MMX routines available only with integer sample types
@@ -298,6 +302,24 @@ FIRFilter * FIRFilter::newInstance()
     else
 #endif // SOUNDTOUCH_ALLOW_MMX
 
+#if defined(SOUNDTOUCH_ALLOW_AVX512) && defined(SOUNDTOUCH_ALLOW_AVX2) && defined(SOUNDTOUCH_ALLOW_SSE)
+    if (uExtensions & SUPPORT_AVX512)
+    {
+        // AVX-512 support, implies AVX2 and FMA
+        return ::new FIRFilterAVX512;
+    }
+    else
+#endif // SOUNDTOUCH_ALLOW_AVX512
+
+#if defined(SOUNDTOUCH_ALLOW_AVX2) && defined(SOUNDTOUCH_ALLOW_SSE)
+    if ((uExtensions & (SUPPORT_AVX2 | SUPPORT_FMA)) == (SUPPORT_AVX2 | SUPPORT_FMA))
+    {
+        // AVX2 and FMA support
+        return ::new FIRFilterAVX2;
+    }
+    else
+#endif // SOUNDTOUCH_ALLOW_AVX2
+
 #ifdef SOUNDTOUCH_ALLOW_SSE
     if (uExtensions & SUPPORT_SSE)
     {
@@ -307,6 +329,15 @@ FIRFilter * FIRFilter::newInstance()
     else
 #endif // SOUNDTOUCH_ALLOW_SSE
 
+#ifdef SOUNDTOUCH_ALLOW_NEON
+    if (uExtensions & SUPPORT_NEON)
+    {
+        // NEON support
+        return ::new FIRFilterNEON;
+    }
+    else
+#endif // SOUNDTOUCH_ALLOW_NEON
+
     {
         // ISA optimizations not supported, use plain C version
         return ::new FIRFilter;
@@ -132,6 +132,45 @@ public:
 
 #endif // SOUNDTOUCH_ALLOW_SSE
 
+
+#if defined(SOUNDTOUCH_ALLOW_AVX2) && defined(SOUNDTOUCH_ALLOW_SSE)
+    /// Class that implements AVX2/FMA optimized functions exclusive for floating point samples type.
+    /// Uses the coefficients of the base class as they are.
+    class FIRFilterAVX2 : public FIRFilter
+    {
+    protected:
+        virtual uint evaluateFilterStereo(float *dest, const float *src, uint numSamples) const override;
+        virtual uint evaluateFilterMono(float *dest, const float *src, uint numSamples) const override;
+    };
+
+#endif // SOUNDTOUCH_ALLOW_AVX2
+
+
+#if defined(SOUNDTOUCH_ALLOW_AVX512) && defined(SOUNDTOUCH_ALLOW_AVX2) && defined(SOUNDTOUCH_ALLOW_SSE)
+    /// Class that implements AVX-512 optimized functions exclusive for floating point samples type.
+    /// Samples left over from the 512-bit blocks are filtered by the AVX2 routines.
+    class FIRFilterAVX512 : public FIRFilterAVX2
+    {
+    protected:
+        virtual uint evaluateFilterStereo(float *dest, const float *src, uint numSamples) const override;
+        virtual uint evaluateFilterMono(float *dest, const float *src, uint numSamples) const override;
+    };
+
+#endif // SOUNDTOUCH_ALLOW_AVX512
+
+
+#ifdef SOUNDTOUCH_ALLOW_NEON
+    /// Class that implements NEON optimized functions exclusive for floating point samples type.
+    /// Uses the coefficients of the base class as they are.
+    class FIRFilterNEON : public FIRFilter
+    {
+    protected:
+        virtual uint evaluateFilterStereo(float *dest, const float *src, uint numSamples) const override;
+        virtual uint evaluateFilterMono(float *dest, const float *src, uint numSamples) const override;
+    };
+
+#endif // SOUNDTOUCH_ALLOW_NEON
+
 }
 
 #endif  // FIRFilter_H
@@ -62,6 +62,11 @@ public:
     {
         return 1;
     }
+
+    virtual double getFract() const override
+    {
+        return fract;
+    }
 };
 
 }
@@ -60,6 +60,12 @@ void InterpolateLinearInteger::resetRegisters()
 }
 
 
+double InterpolateLinearInteger::getFract() const
+{
+    return (double)iFract / SCALE;
+}
+
+
 // Transposes the sample rate of the given samples using linear interpolation.
 // 'Mono' version of the routine. Returns the number of samples returned in
 // the "dest" buffer
@@ -65,6 +65,8 @@ public:
     {
         return 0;
     }
+
+    virtual double getFract() const override;
 };
 
 
@@ -91,6 +93,11 @@ public:
     {
         return 0;
     }
+
+    double getFract() const
+    {
+        return fract;
+    }
 };
 
 }
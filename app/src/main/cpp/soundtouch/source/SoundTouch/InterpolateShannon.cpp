@@ -3,9 +3,9 @@
 /// Sample interpolation routine using 8-tap band-limited Shannon interpolation
 /// with kaiser window.
 ///
-/// Notice. This algorithm is remarkably much heavier than linear or cubic
-/// interpolation, and not remarkably better than cubic algorithm. Thus mostly
-/// for experimental purposes
+/// The windowed sinc kernel is tabulated at SHANNON_PHASES fractional positions
+/// and interpolated linearly between them, so that each output sample costs
+/// an 8-tap dot product instead of eight sin() evaluations.
 ///
 /// Author        : Copyright (c) Olli Parviainen
 /// Author e-mail : oparviai 'at' iki.fi
@@ -38,6 +38,12 @@
 #include "InterpolateShannon.h"
 #include "STTypes.h"
 
+#ifdef SOUNDTOUCH_ALLOW_NEON
+// NEON is part of the ARM target the library is built for, and is only
+// enabled with float samples
+#include <arm_neon.h>
+#endif
+
 using namespace soundtouch;
 
 
@@ -56,9 +62,44 @@ static const double _kaiser8[8] =
 };
 
 
+#define PI 3.1415926536
+#define sinc(x) (sin(PI * (x)) / (PI * (x)))
+
+
+/// Kernel coefficients at SHANNON_PHASES + 1 fractional positions from 0 to 1
+/// inclusive, SHANNON_TAPS per position. Shared by all the instances.
+class ShannonKernel
+{
+public:
+    float coeffs[(SHANNON_PHASES + 1) * SHANNON_TAPS];
+
+    ShannonKernel()
+    {
+        for (int p = 0; p <= SHANNON_PHASES; p ++)
+        {
+            double fract = (double)p / SHANNON_PHASES;
+            for (int k = 0; k < SHANNON_TAPS; k ++)
+            {
+                double x = (double)(k - 3) - fract;
+                double c = (fabs(x) < 1e-9) ? 1.0 : sinc(x);   // sinc(0) = 1
+                coeffs[p * SHANNON_TAPS + k] = (float)(c * _kaiser8[k]);
+            }
+        }
+    }
+};
+
+
+static const float *getShannonKernel()
+{
+    static const ShannonKernel kernel;
+    return kernel.coeffs;
+}
+
+
 InterpolateShannon::InterpolateShannon()
 {
     fract = 0;
+    pKernel = getShannonKernel();
 }
 
 
@@ -68,8 +109,59 @@ void InterpolateShannon::resetRegisters()
 }
 
 
-#define PI 3.1415926536
-#define sinc(x) (sin(PI * (x)) / (PI * (x)))
+/// Interpolates the kernel at position 'fract' into 'coeffs'
+inline void InterpolateShannon::kernelAt(float *coeffs) const
+{
+    double pos = fract * SHANNON_PHASES;
+    int phase = (int)pos;
+    float t = (float)(pos - phase);
+    const float *c0 = pKernel + phase * SHANNON_TAPS;
+    const float *c1 = c0 + SHANNON_TAPS;
+
+    for (int k = 0; k < SHANNON_TAPS; k ++)
+    {
+        coeffs[k] = c0[k] + t * (c1[k] - c0[k]);
+    }
+}
+
+
+#ifndef SOUNDTOUCH_ALLOW_NEON
+
+/// 8-tap dot product. Four independent partial sums, so that the compiler can
+/// keep them in one vector register.
+static inline float dot8(const float *coeffs, const SAMPLETYPE *src)
+{
+    float sum[4] = {0, 0, 0, 0};
+    for (int k = 0; k < 8; k += 4)
+    {
+        for (int j = 0; j < 4; j ++)
+        {
+            sum[j] += coeffs[k + j] * src[k + j];
+        }
+    }
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+
+/// 8-tap dot products of the interleaved stereo samples. The samples are read
+/// contiguously with each coefficient used for a pair of them: the even partial
+/// sums get the left channel and the odd ones the right.
+static inline void dot8Stereo(const float *coeffs, const SAMPLETYPE *src, float &out0, float &out1)
+{
+    float sum[4] = {0, 0, 0, 0};
+    for (int k = 0; k < 16; k += 4)
+    {
+        for (int j = 0; j < 4; j ++)
+        {
+            sum[j] += coeffs[(k + j) >> 1] * src[k + j];
+        }
+    }
+    out0 = sum[0] + sum[2];
+    out1 = sum[1] + sum[3];
+}
+
+#endif // SOUNDTOUCH_ALLOW_NEON
+
 
 /// Transpose mono audio. Returns number of produced output samples, and
 /// updates "srcSamples" to amount of consumed source samples
@@ -84,24 +176,19 @@ int InterpolateShannon::transposeMono(SAMPLETYPE *pdest,
     i = 0;
     while (srcCount < srcSampleEnd)
     {
-        double out;
+        float coeffs[SHANNON_TAPS];
+        float out;
         assert(fract < 1.0);
 
-        out  = psrc[0] * sinc(-3.0 - fract) * _kaiser8[0];
-        out += psrc[1] * sinc(-2.0 - fract) * _kaiser8[1];
-        out += psrc[2] * sinc(-1.0 - fract) * _kaiser8[2];
-        if (fract < 1e-6)
-        {
-            out += psrc[3] * _kaiser8[3];     // sinc(0) = 1
-        }
-        else
-        {
-            out += psrc[3] * sinc(- fract) * _kaiser8[3];
-        }
-        out += psrc[4] * sinc( 1.0 - fract) * _kaiser8[4];
-        out += psrc[5] * sinc( 2.0 - fract) * _kaiser8[5];
-        out += psrc[6] * sinc( 3.0 - fract) * _kaiser8[6];
-        out += psrc[7] * sinc( 4.0 - fract) * _kaiser8[7];
+        kernelAt(coeffs);
+#ifdef SOUNDTOUCH_ALLOW_NEON
+        float32x4_t sum = vmulq_f32(vld1q_f32(coeffs), vld1q_f32(psrc));
+        sum = vmlaq_f32(sum, vld1q_f32(coeffs + 4), vld1q_f32(psrc + 4));
+        float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+        out = vget_lane_f32(vpadd_f32(pair, pair), 0);
+#else
+        out = dot8(coeffs, psrc);
+#endif
 
         pdest[i] = (SAMPLETYPE)out;
         i ++;
@@ -132,25 +219,26 @@ int InterpolateShannon::transposeStereo(SAMPLETYPE *pdest,
     i = 0;
     while (srcCount < srcSampleEnd)
     {
-        double out0, out1, w;
+        float coeffs[SHANNON_TAPS];
+        float out0, out1;
         assert(fract < 1.0);
 
-        w = sinc(-3.0 - fract) * _kaiser8[0];
-        out0 = psrc[0] * w; out1 = psrc[1] * w;
-        w = sinc(-2.0 - fract) * _kaiser8[1];
-        out0 += psrc[2] * w; out1 += psrc[3] * w;
-        w = sinc(-1.0 - fract) * _kaiser8[2];
-        out0 += psrc[4] * w; out1 += psrc[5] * w;
-        w = _kaiser8[3] * ((fract < 1e-5) ? 1.0 : sinc(- fract));   // sinc(0) = 1
-        out0 += psrc[6] * w; out1 += psrc[7] * w;
-        w = sinc( 1.0 - fract) * _kaiser8[4];
-        out0 += psrc[8] * w; out1 += psrc[9] * w;
-        w = sinc( 2.0 - fract) * _kaiser8[5];
-        out0 += psrc[10] * w; out1 += psrc[11] * w;
-        w = sinc( 3.0 - fract) * _kaiser8[6];
-        out0 += psrc[12] * w; out1 += psrc[13] * w;
-        w = sinc( 4.0 - fract) * _kaiser8[7];
-        out0 += psrc[14] * w; out1 += psrc[15] * w;
+        kernelAt(coeffs);
+#ifdef SOUNDTOUCH_ALLOW_NEON
+        // deinterleave the channels while loading
+        float32x4x2_t lo = vld2q_f32(psrc);
+        float32x4x2_t hi = vld2q_f32(psrc + 8);
+        float32x4_t c0 = vld1q_f32(coeffs);
+        float32x4_t c1 = vld1q_f32(coeffs + 4);
+        float32x4_t sum0 = vmlaq_f32(vmulq_f32(c0, lo.val[0]), c1, hi.val[0]);
+        float32x4_t sum1 = vmlaq_f32(vmulq_f32(c0, lo.val[1]), c1, hi.val[1]);
+        float32x2_t pair = vpadd_f32(vadd_f32(vget_low_f32(sum0), vget_high_f32(sum0)),
+                                     vadd_f32(vget_low_f32(sum1), vget_high_f32(sum1)));
+        out0 = vget_lane_f32(pair, 0);
+        out1 = vget_lane_f32(pair, 1);
+#else
+        dot8Stereo(coeffs, psrc, out0, out1);
+#endif
 
         pdest[2*i]   = (SAMPLETYPE)out0;
         pdest[2*i+1] = (SAMPLETYPE)out1;
@@ -43,6 +43,13 @@
 namespace soundtouch
 {
 
+/// Number of kernel positions tabulated between two input samples; the kernel
+/// is interpolated linearly between them
+#define SHANNON_PHASES      512
+
+/// Kernel length in input samples
+#define SHANNON_TAPS        8
+
 class InterpolateShannon : public TransposerBase
 {
 protected:
@@ -58,6 +65,11 @@ protected:
 
     double fract;
 
+    /// Tabulated kernel, shared by all the instances
+    const float *pKernel;
+
+    void kernelAt(float *coeffs) const;
+
 public:
     InterpolateShannon();
 
@@ -67,6 +79,11 @@ public:
     {
         return 3;
     }
+
+    virtual double getFract() const override
+    {
+        return fract;
+    }
 };
 
 }
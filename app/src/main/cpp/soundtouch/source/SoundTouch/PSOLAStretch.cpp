@@ -0,0 +1,490 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Pitch-synchronous overlap-add (PSOLA) tempo changer for speech.
+///
+/// The input is split into pitch periods by marks placed incrementally, each
+/// one detected period after the previous one. The period ending at a mark is
+/// found by the autocorrelation of the signal before the mark, so detecting a
+/// mark needs no input beyond it.
+///
+/// Each output grain is the input around one mark, windowed with a rising half
+/// as long as the previous output interval and a falling half one period long.
+/// The next grain is placed one period later, so the falling half of a grain &
+/// the rising half of the next one always overlap exactly and sum to one. The
+/// tempo is changed by choosing the mark for each grain: the one closest to
+/// where the input has advanced to by 'tempo' times the output, which repeats
+/// or skips whole periods as needed.
+///
+/// Author        : Copyright (c) Olli Parviainen
+/// Author e-mail : oparviai 'at' iki.fi
+/// SoundTouch WWW: http://www.surina.net/soundtouch
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "PSOLAStretch.h"
+
+using namespace soundtouch;
+
+#define max(x, y) (((x) > (y)) ? (x) : (y))
+#define min(x, y) (((x) < (y)) ? (x) : (y))
+
+#ifndef M_PI
+#define M_PI        3.14159265358979323846
+#endif
+
+
+PSOLAStretch::PSOLAStretch() : StretchBase(&outputBuffer)
+{
+    channels = 2;
+    sampleRate = 0;
+    tempo = 1.0;
+
+    pAccumulator = nullptr;
+    pMono = nullptr;
+    pDecimated = nullptr;
+    pCoarseCorr = nullptr;
+
+    for (int i = 0; i < PSOLA_WINDOW_SIZE; i ++)
+    {
+        double s = sin(0.5 * M_PI * i / PSOLA_WINDOW_SIZE);
+        window[i] = (float)(s * s);
+    }
+
+    setSampleRate(44100);
+}
+
+
+PSOLAStretch::~PSOLAStretch()
+{
+    delete[] pAccumulator;
+    delete[] pMono;
+    delete[] pDecimated;
+    delete[] pCoarseCorr;
+}
+
+
+// Sets the sample rate, which scales the pitch search range
+void PSOLAStretch::setSampleRate(int newSampleRate)
+{
+    if ((newSampleRate <= 0) || (newSampleRate == sampleRate)) return;
+
+    sampleRate = newSampleRate;
+    minPeriod = sampleRate / PSOLA_MAX_PITCH_HZ;
+    maxPeriod = sampleRate / PSOLA_MIN_PITCH_HZ;
+    unvoicedPeriod = sampleRate * PSOLA_UNVOICED_MS / 1000;
+    corrLength = sampleRate * PSOLA_CORR_MS / 1000;
+
+    // search the coarse lags at about 8kHz resolution
+    coarseStep = sampleRate / 8000;
+    if (coarseStep < 1) coarseStep = 1;
+
+    allocateBuffers();
+}
+
+
+// Sets the number of channels, 1 = mono, 2 = stereo
+void PSOLAStretch::setChannels(int numChannels)
+{
+    if (!verifyNumberOfChannels(numChannels) ||
+        (channels == numChannels)) return;
+
+    channels = numChannels;
+    inputBuffer.setChannels(channels);
+    outputBuffer.setChannels(channels);
+
+    allocateBuffers();
+}
+
+
+void PSOLAStretch::allocateBuffers()
+{
+    delete[] pAccumulator;
+    delete[] pMono;
+    delete[] pDecimated;
+    delete[] pCoarseCorr;
+
+    // a grain spans at most two periods
+    pAccumulator = new float[2 * maxPeriod * channels];
+
+    const int numDecimated = (corrLength + maxPeriod) / coarseStep + 2;
+    pMono = new float[numDecimated * coarseStep];
+    pDecimated = new float[numDecimated];
+    pCoarseCorr = new float[numDecimated];
+
+    clearInput();
+}
+
+
+// Sets new target tempo. Normal tempo = 1.0, smaller values represent slower
+// tempo, larger faster tempo.
+void PSOLAStretch::setTempo(double newTempo)
+{
+    tempo = newTempo;
+}
+
+
+// Clears the input buffer
+void PSOLAStretch::clearInput()
+{
+    inputBuffer.clear();
+    memset(pAccumulator, 0, 2 * maxPeriod * channels * sizeof(float));
+
+    // Begin with unvoiced marks until there's input enough for the pitch detector
+    markA.pos = 0;
+    markA.period = unvoicedPeriod;
+    markA.voiced = false;
+    markB = markA;
+    markB.pos = unvoicedPeriod;
+    inputTime = 0;
+    prevHop = 0;
+}
+
+
+// Clears all the samples in the object
+void PSOLAStretch::clear()
+{
+    outputBuffer.clear();
+    clearInput();
+}
+
+
+// Returns the normalized correlation of 'length' samples at 'ref' & 'cmp', with
+// 'refEnergy' the energy of 'ref'
+static float normalizedCorr(const float *ref, const float *cmp, int length, float refEnergy)
+{
+    float xy = 0;
+    float yy = 0;
+
+    for (int i = 0; i < length; i ++)
+    {
+        xy += ref[i] * cmp[i];
+        yy += cmp[i] * cmp[i];
+    }
+    return (refEnergy * yy > 1e-12f) ? xy / sqrtf(refEnergy * yy) : 0;
+}
+
+
+// Returns the pitch period ending at input position 'pos', from the normalized
+// autocorrelation of the 'corrLength' samples before 'pos'. The lags are first
+// searched on the input decimated by 'coarseStep', and the peak found there is
+// refined at full resolution. Of coarse peaks almost as high as the best one,
+// the shortest lag is taken to prefer the pitch period over its multiples.
+//
+// If the previous mark was voiced, only lags around its period are searched at
+// first, which besides saving work keeps the period from jumping an octave.
+int PSOLAStretch::detectPeriod(int pos, int previous)
+{
+    const int step = coarseStep;
+    const int numDecimated = (corrLength + maxPeriod) / step + 2;
+    const int length = numDecimated * step;
+    const int begin = pos - length;
+    const int corrDecimated = corrLength / step;
+    int i, k;
+
+    if (begin < 0)
+    {
+        // not enough history yet
+        return 0;
+    }
+
+    // Mono mix of the history before 'pos', and its sums over 'step' samples
+    const SAMPLETYPE *src = inputBuffer.ptrBegin() + channels * begin;
+    for (i = 0; i < length; i ++)
+    {
+        float sum = 0;
+        for (int c = 0; c < channels; c ++)
+        {
+            sum += (float)src[channels * i + c];
+        }
+        pMono[i] = sum;
+    }
+    for (i = 0; i < numDecimated; i ++)
+    {
+        float sum = 0;
+        for (int j = 0; j < step; j ++)
+        {
+            sum += pMono[i * step + j];
+        }
+        pDecimated[i] = sum;
+    }
+
+    // the correlated signals end at 'pos'
+    const float *ref = pMono + length - corrLength;
+    const float *refDecimated = pDecimated + numDecimated - corrDecimated;
+
+    float refEnergy = 0;
+    for (i = 0; i < corrDecimated; i ++)
+    {
+        refEnergy += refDecimated[i] * refDecimated[i];
+    }
+    if (refEnergy < 1e-12f)
+    {
+        return 0;
+    }
+
+    const int minLag = (minPeriod + step - 1) / step;
+    const int maxLag = maxPeriod / step;
+    int low = minLag;
+    int high = maxLag;
+    if (previous > 0)
+    {
+        low = max(minLag, (int)(0.7 * previous / step));
+        high = min(maxLag, (int)(1.4 * previous / step) + 1);
+    }
+
+    for (;;)
+    {
+        // Coarse search, with the energy of the lagged signal updated as it slides
+        float lagEnergy = 0;
+        for (i = 0; i < corrDecimated; i ++)
+        {
+            lagEnergy += refDecimated[i - low] * refDecimated[i - low];
+        }
+
+        float best = 0;
+        for (k = low; k <= high; k ++)
+        {
+            const float *cmp = refDecimated - k;
+            float xy = 0;
+            for (i = 0; i < corrDecimated; i ++)
+            {
+                xy += refDecimated[i] * cmp[i];
+            }
+            float corr = (lagEnergy > 1e-12f) ? xy / sqrtf(refEnergy * lagEnergy) : 0;
+            pCoarseCorr[k - low] = corr;
+            if (corr > best) best = corr;
+
+            lagEnergy += cmp[-1] * cmp[-1] - cmp[corrDecimated - 1] * cmp[corrDecimated - 1];
+        }
+
+        if (best >= 0.9f * PSOLA_VOICING_THRESHOLD)
+        {
+            // The first local maximum almost as high as the best one
+            for (k = 0; pCoarseCorr[k] < 0.9f * best; k ++) {}
+            while ((k + low < high) && (pCoarseCorr[k + 1] > pCoarseCorr[k]))
+            {
+                k ++;
+            }
+
+            // Parabolic interpolation between the neighbouring coarse lags
+            double peak = k + low;
+            if ((k > 0) && (k + low < high))
+            {
+                const double c0 = pCoarseCorr[k - 1];
+                const double c1 = pCoarseCorr[k];
+                const double c2 = pCoarseCorr[k + 1];
+                const double curve = c0 - 2 * c1 + c2;
+                if (curve < 0)
+                {
+                    peak += 0.5 * (c0 - c2) / curve;
+                }
+            }
+
+            // Refine at full resolution by climbing from the interpolated peak to
+            // the neighbouring local maximum
+            float fullEnergy = 0;
+            for (i = 0; i < corrLength; i ++)
+            {
+                fullEnergy += ref[i] * ref[i];
+            }
+
+            int lag = max(minPeriod, min(maxPeriod, (int)(peak * step + 0.5)));
+            float corr = normalizedCorr(ref, ref - lag, corrLength, fullEnergy);
+            for (int dir = -1; dir <= 1; dir += 2)
+            {
+                for (int steps = 0; steps < step; steps ++)
+                {
+                    const int next = lag + dir;
+                    if ((next < minPeriod) || (next > maxPeriod)) break;
+                    const float nextCorr = normalizedCorr(ref, ref - next, corrLength, fullEnergy);
+                    if (nextCorr <= corr) break;
+                    lag = next;
+                    corr = nextCorr;
+                }
+            }
+            if (corr >= PSOLA_VOICING_THRESHOLD) return lag;
+        }
+
+        if ((low == minLag) && (high == maxLag)) break;
+
+        // lost the track, search all the lags
+        low = minLag;
+        high = maxLag;
+    }
+
+    return 0;
+}
+
+
+// Overlap-adds the grain around input position 'pos' to the accumulator, which
+// begins from where the rising half of the grain begins.
+//
+// The first marks are at the very beginning of the input, and when the tempo is
+// slow the grain around one is repeated with a rising half longer than the input
+// before the mark. The part of the rising half before the input is left out.
+void PSOLAStretch::addGrain(int pos, int rising, int falling)
+{
+    const int skip = max(0, rising - pos);
+    const SAMPLETYPE *src = inputBuffer.ptrBegin() + channels * (pos - rising + skip);
+    float *dest = pAccumulator + channels * skip;
+    int i, c;
+
+    assert(pos >= 0);
+    assert(rising + falling <= 2 * maxPeriod);
+
+    for (i = skip; i < rising; i ++)
+    {
+        const float w = window[i * PSOLA_WINDOW_SIZE / rising];
+        for (c = 0; c < channels; c ++)
+        {
+            dest[c] += w * (float)src[c];
+        }
+        src += channels;
+        dest += channels;
+    }
+
+    for (i = 0; i < falling; i ++)
+    {
+        const float w = 1.0f - window[i * PSOLA_WINDOW_SIZE / falling];
+        for (c = 0; c < channels; c ++)
+        {
+            dest[c] += w * (float)src[c];
+        }
+        src += channels;
+        dest += channels;
+    }
+}
+
+
+// Moves the first 'count' accumulated samples to the output
+void PSOLAStretch::outputAccumulated(int count)
+{
+    const int total = 2 * maxPeriod * channels;
+    const int num = count * channels;
+    SAMPLETYPE *dest = outputBuffer.ptrEnd((uint)count);
+
+    for (int i = 0; i < num; i ++)
+    {
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+        float value = pAccumulator[i];
+        value += (value >= 0) ? 0.5f : -0.5f;
+        if (value > 32767.0f) value = 32767.0f;
+        if (value < -32768.0f) value = -32768.0f;
+        dest[i] = (SAMPLETYPE)value;
+#else
+        dest[i] = pAccumulator[i];
+#endif
+    }
+    outputBuffer.putSamples((uint)count);
+
+    memmove(pAccumulator, pAccumulator + num, (total - num) * sizeof(float));
+    memset(pAccumulator + total - num, 0, num * sizeof(float));
+}
+
+
+// Makes as many output grains as the input suffices for
+void PSOLAStretch::processSamples()
+{
+    const int available = (int)inputBuffer.numSamples();
+
+    for (;;)
+    {
+        // Advance the marks until they bracket the input time. A mark is placed
+        // one period after the previous one and must be inside the input.
+        while (markB.pos <= inputTime)
+        {
+            const int next = markB.pos + markB.period;
+            if (next >= available) break;
+
+            const int period = detectPeriod(next, markB.voiced ? markB.period : 0);
+            markA = markB;
+            markB.pos = next;
+            markB.voiced = (period > 0);
+            markB.period = markB.voiced ? period : unvoicedPeriod;
+        }
+        if (markB.pos <= inputTime) break;
+
+        // The grain is taken around the mark closest to the input time, once the
+        // input extends a period beyond the mark
+        const PitchMark &mark = (inputTime - markA.pos <= markB.pos - inputTime) ? markA : markB;
+        if (mark.pos + mark.period > available) break;
+
+        addGrain(mark.pos, prevHop, mark.period);
+        outputAccumulated(prevHop);
+
+        prevHop = mark.period;
+        inputTime += tempo * mark.period;
+    }
+
+    // Drop the input that neither the grains nor the pitch detector reach back to
+    int drop = markA.pos - ((corrLength + maxPeriod) / coarseStep + 2) * coarseStep;
+    if (drop > 0)
+    {
+        inputBuffer.receiveSamples((uint)drop);
+        markA.pos -= drop;
+        markB.pos -= drop;
+        inputTime -= drop;
+    }
+}
+
+
+// Adds 'numsamples' pcs of samples from the 'samples' memory position into
+// the input of the object.
+void PSOLAStretch::putSamples(const SAMPLETYPE *samples, uint nSamples)
+{
+    inputBuffer.putSamples(samples, nSamples);
+    processSamples();
+}
+
+
+// Processes the samples added directly to the input buffer
+void PSOLAStretch::processInput()
+{
+    processSamples();
+}
+
+
+// Presizes the input buffer for processing up to 'maxInput' samples at a time.
+// Returns the most samples output at a time.
+uint PSOLAStretch::reserve(uint maxInput, double minTempo, double /*maxTempo*/)
+{
+    if (maxInput == 0)
+    {
+        inputBuffer.reserve(0);
+        return 0;
+    }
+
+    // The input kept between the calls reaches from what the pitch detector needs
+    // before the first mark to a period beyond the mark after it
+    const int hold = ((corrLength + maxPeriod) / coarseStep + 2) * coarseStep +
+                     2 * maxPeriod + unvoicedPeriod;
+    inputBuffer.reserve((uint)hold + maxInput);
+
+    // the input time may run a grain ahead of the input, and the output a grain
+    // ahead of the input time
+    return (uint)((hold + maxInput) / minTempo) + 2 * (uint)maxPeriod;
+}
@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Pitch-synchronous overlap-add (PSOLA) tempo changer for speech. Places pitch
+/// marks one pitch period apart with an incremental pitch detector, and builds
+/// the output of two-period grains taken around the marks, so that every grain
+/// joins the previous one in phase without searching for the overlap position.
+///
+/// Author        : Copyright (c) Olli Parviainen
+/// Author e-mail : oparviai 'at' iki.fi
+/// SoundTouch WWW: http://www.surina.net/soundtouch
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PSOLAStretch_H
+#define PSOLAStretch_H
+
+#include "STTypes.h"
+#include "FIFOSampleBuffer.h"
+#include "TDStretch.h"
+
+namespace soundtouch
+{
+
+/// Range of voice pitch that the pitch mark detector searches for, in Hz
+#define PSOLA_MIN_PITCH_HZ      60
+#define PSOLA_MAX_PITCH_HZ      400
+
+/// Length of the signal that the pitch detector correlates, in milliseconds
+#define PSOLA_CORR_MS           10
+
+/// Pitch mark interval in unvoiced sound, in milliseconds
+#define PSOLA_UNVOICED_MS       5
+
+/// Normalized autocorrelation at the detected period above which the sound is
+/// taken as voiced
+#define PSOLA_VOICING_THRESHOLD 0.6
+
+/// Resolution of the grain window table
+#define PSOLA_WINDOW_SIZE       1024
+
+
+/// Pitch-synchronous overlap-add tempo changer
+class PSOLAStretch : public StretchBase
+{
+protected:
+    /// Pitch mark: position in 'inputBuffer' and the pitch period ending at it,
+    /// or the unvoiced mark interval if the sound isn't voiced there
+    struct PitchMark
+    {
+        int pos;
+        int period;
+        bool voiced;
+    };
+
+    int channels;
+    int sampleRate;
+    double tempo;
+
+    /// Pitch period search range, the unvoiced mark interval and the correlation
+    /// length of the pitch detector, in samples
+    int minPeriod;
+    int maxPeriod;
+    int unvoicedPeriod;
+    int corrLength;
+
+    /// Lag & sample step of the coarse pitch search
+    int coarseStep;
+
+    /// Consecutive analysis marks around 'inputTime', markA.pos <= inputTime < markB.pos
+    PitchMark markA;
+    PitchMark markB;
+
+    /// Input position that the next output grain should be taken from
+    double inputTime;
+
+    /// Output interval from the previous grain to the next one, i.e. the width of
+    /// the rising half of the next grain
+    int prevHop;
+
+    /// Output not finished yet, beginning from the center of the previous grain
+    float *pAccumulator;
+
+    /// Mono mix of the pitch detector's input, the same decimated for the coarse
+    /// search & the coarse correlations
+    float *pMono;
+    float *pDecimated;
+    float *pCoarseCorr;
+
+    /// Rising half of the grain window, sin^2 over [0, pi/2). The falling half
+    /// is one minus this, so that overlapping halves always sum to one.
+    float window[PSOLA_WINDOW_SIZE];
+
+    FIFOSampleBuffer inputBuffer;
+    FIFOSampleBuffer outputBuffer;
+
+    void allocateBuffers();
+
+    /// Returns the pitch period ending at input position 'pos', or zero if the
+    /// sound there isn't voiced. 'previous' is the period at the previous mark,
+    /// zero if that wasn't voiced.
+    int detectPeriod(int pos, int previous);
+
+    /// Overlap-adds the grain around input position 'pos' to the accumulator
+    void addGrain(int pos, int rising, int falling);
+
+    /// Moves the first 'count' accumulated samples to the output
+    void outputAccumulated(int count);
+
+    void processSamples();
+
+public:
+    PSOLAStretch();
+    virtual ~PSOLAStretch() override;
+
+    /// Returns the output buffer object
+    FIFOSampleBuffer *getOutput() override { return &outputBuffer; };
+
+    /// Returns the input buffer object
+    FIFOSampleBuffer *getInput() override { return &inputBuffer; };
+
+    /// Sets new target tempo. Normal tempo = 1.0, smaller values represent slower
+    /// tempo, larger faster tempo.
+    void setTempo(double newTempo) override;
+
+    /// Sets the number of channels, 1 = mono, 2 = stereo
+    void setChannels(int numChannels) override;
+
+    /// Sets the sample rate, which scales the pitch search range
+    void setSampleRate(int newSampleRate);
+
+    /// Clears the input buffer
+    void clearInput() override;
+
+    /// Clears all the samples in the object
+    virtual void clear() override;
+
+    /// Adds 'numSamples' pcs of samples from the 'samples' memory position into
+    /// the input of the object.
+    virtual void putSamples(const SAMPLETYPE *samples, uint numSamples) override;
+
+    /// Processes the samples added directly to the input buffer
+    void processInput() override;
+
+    /// Presizes the input buffer. The work buffers depend only on the sample rate
+    /// & channels, and are allocated when those are set.
+    uint reserve(uint maxInput, double minTempo, double maxTempo) override;
+
+    /// return nominal input sample requirement for triggering a processing batch,
+    /// i.e. one pitch period at the input
+    int getInputSampleReq() const override
+    {
+        return (int)(getOutputBatchSize() * tempo + 0.5);
+    }
+
+    /// return nominal output sample amount when running a processing batch, i.e.
+    /// the latest pitch period
+    int getOutputBatchSize() const override
+    {
+        return (prevHop > 0) ? prevHop : unvoicedPeriod;
+    }
+
+    /// return approximate initial input-output latency: the grain around a pitch
+    /// mark is output when the input reaches a period beyond the mark, and the mark
+    /// may lie half a period beyond the position the grain is needed for.
+    int getLatency() const override
+    {
+        return maxPeriod + maxPeriod / 2;
+    }
+};
+
+}
+
+#endif
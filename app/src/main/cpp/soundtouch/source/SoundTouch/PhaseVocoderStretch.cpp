@@ -0,0 +1,385 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Phase vocoder tempo changer with identity phase locking.
+///
+/// The input is analysed in Hann-windowed frames whose start advances by
+/// 'tempo' times the synthesis hop, and each frame is resynthesized one
+/// synthesis hop, a quarter of the frame, after the previous one. For every
+/// spectral peak, the phase advance since the previous frame gives the exact
+/// frequency, from which the peak's phase is advanced over the synthesis hop.
+/// The bins in the peak's region, up to half-way to the neighbouring peaks,
+/// keep their analysed phase relative to the peak ("identity phase locking",
+/// Laroche & Dolson), so that the partials stay coherent across their bins
+/// and the vertical phase relations of the input are kept.
+///
+/// At tempo 1 the synthesis phases equal the analysed ones, and the input is
+/// reconstructed exactly.
+///
+/// Author        : Copyright (c) Olli Parviainen
+/// Author e-mail : oparviai 'at' iki.fi
+/// SoundTouch WWW: http://www.surina.net/soundtouch
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "PhaseVocoderStretch.h"
+
+using namespace soundtouch;
+
+#ifndef M_PI
+#define M_PI        3.14159265358979323846
+#endif
+
+
+// Wraps phase 'x' to -pi .. pi
+static inline float princarg(float x)
+{
+    return x - (float)(2 * M_PI) * floorf((x + (float)M_PI) * (float)(0.5 / M_PI));
+}
+
+
+PhaseVocoderStretch::PhaseVocoderStretch() : StretchBase(&outputBuffer)
+{
+    channels = 2;
+    sampleRate = 44100;
+    frameMs = VOCODER_DEFAULT_FRAME_MS;
+    tempo = 1.0;
+
+    pWindow = nullptr;
+    pFrame = nullptr;
+    pMagnitude = nullptr;
+    pPhase = nullptr;
+    pPeaks = nullptr;
+    pPrevPhase = nullptr;
+    pSynthPhase = nullptr;
+    pAccumulator = nullptr;
+
+    allocateBuffers();
+}
+
+
+PhaseVocoderStretch::~PhaseVocoderStretch()
+{
+    delete[] pWindow;
+    delete[] pFrame;
+    delete[] pMagnitude;
+    delete[] pPhase;
+    delete[] pPeaks;
+    delete[] pPrevPhase;
+    delete[] pSynthPhase;
+    delete[] pAccumulator;
+}
+
+
+// Sets the sample rate, which scales the frame length
+void PhaseVocoderStretch::setSampleRate(int newSampleRate)
+{
+    if ((newSampleRate <= 0) || (newSampleRate == sampleRate)) return;
+
+    sampleRate = newSampleRate;
+    allocateBuffers();
+}
+
+
+// Sets the analysis frame length in milliseconds
+void PhaseVocoderStretch::setFrameMs(int newFrameMs)
+{
+    if ((newFrameMs <= 0) || (newFrameMs == frameMs)) return;
+
+    frameMs = newFrameMs;
+    allocateBuffers();
+}
+
+
+// Sets the number of channels, 1 = mono, 2 = stereo
+void PhaseVocoderStretch::setChannels(int numChannels)
+{
+    if (!verifyNumberOfChannels(numChannels) ||
+        (channels == numChannels)) return;
+
+    channels = numChannels;
+    inputBuffer.setChannels(channels);
+    outputBuffer.setChannels(channels);
+
+    allocateBuffers();
+}
+
+
+void PhaseVocoderStretch::allocateBuffers()
+{
+    delete[] pWindow;
+    delete[] pFrame;
+    delete[] pMagnitude;
+    delete[] pPhase;
+    delete[] pPeaks;
+    delete[] pPrevPhase;
+    delete[] pSynthPhase;
+    delete[] pAccumulator;
+
+    // at least a few bins per synthesis hop
+    frameLength = RealFFT::lengthFor(sampleRate * frameMs / 1000);
+    if (frameLength < 8 * VOCODER_OVERLAP) frameLength = 8 * VOCODER_OVERLAP;
+    synthesisHop = frameLength / VOCODER_OVERLAP;
+    numBins = frameLength / 2 + 1;
+    fft.setLength(frameLength);
+
+    pWindow = new float[frameLength];
+    for (int i = 0; i < frameLength; i ++)
+    {
+        // periodic, so that the squared windows overlapping at each sample sum to
+        // a constant
+        pWindow[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / frameLength));
+    }
+
+    pFrame = new float[frameLength];
+    pMagnitude = new float[numBins];
+    pPhase = new float[numBins];
+    pPeaks = new int[numBins];
+    pPrevPhase = new float[numBins * channels];
+    pSynthPhase = new float[numBins * channels];
+    pAccumulator = new float[frameLength * channels];
+
+    clearInput();
+}
+
+
+// Sets new target tempo. Normal tempo = 1.0, smaller values represent slower
+// tempo, larger faster tempo.
+void PhaseVocoderStretch::setTempo(double newTempo)
+{
+    tempo = newTempo;
+}
+
+
+// Clears the input buffer
+void PhaseVocoderStretch::clearInput()
+{
+    inputBuffer.clear();
+    memset(pAccumulator, 0, frameLength * channels * sizeof(float));
+    inputTime = 0;
+    prevFrameStart = 0;
+    bFirstFrame = true;
+}
+
+
+// Clears all the samples in the object
+void PhaseVocoderStretch::clear()
+{
+    outputBuffer.clear();
+    clearInput();
+}
+
+
+// Transforms channel 'channel' of the frame at input position 'start', moves the
+// phases of its bins from the previous output frame over the synthesis hop, and
+// overlap-adds the resynthesized frame to the accumulator.
+void PhaseVocoderStretch::processFrame(int start, int hop, int channel)
+{
+    const SAMPLETYPE *src = inputBuffer.ptrBegin() + channels * start + channel;
+    const int half = frameLength / 2;
+    const float binScale = (float)(2 * M_PI) / (float)frameLength;
+    float *prevPhase = pPrevPhase + channel * numBins;
+    float *synthPhase = pSynthPhase + channel * numBins;
+    float *dest = pAccumulator + channel;
+    int i, k, numPeaks;
+
+    for (i = 0; i < frameLength; i ++)
+    {
+        pFrame[i] = pWindow[i] * (float)src[channels * i];
+    }
+    fft.forward(pFrame);
+
+    // Magnitudes & phases, the DC & Nyquist terms being real
+    pMagnitude[0] = fabsf(pFrame[0]);
+    pPhase[0] = (pFrame[0] < 0) ? (float)M_PI : 0;
+    pMagnitude[half] = fabsf(pFrame[1]);
+    pPhase[half] = (pFrame[1] < 0) ? (float)M_PI : 0;
+    for (k = 1; k < half; k ++)
+    {
+        const float re = pFrame[2 * k];
+        const float im = pFrame[2 * k + 1];
+        pMagnitude[k] = sqrtf(re * re + im * im);
+        pPhase[k] = atan2f(im, re);
+    }
+
+    // Peaks: bins above their neighbours on both sides
+    numPeaks = 0;
+    for (k = VOCODER_PEAK_NEIGHBOURS; k < numBins - VOCODER_PEAK_NEIGHBOURS; k ++)
+    {
+        const float m = pMagnitude[k];
+        bool peak = (m > 1e-9f);
+        for (i = 1; peak && (i <= VOCODER_PEAK_NEIGHBOURS); i ++)
+        {
+            peak = (m > pMagnitude[k - i]) && (m >= pMagnitude[k + i]);
+        }
+        if (peak) pPeaks[numPeaks ++] = k;
+    }
+
+    if (bFirstFrame || (hop <= 0) || (numPeaks == 0))
+    {
+        // nothing to continue from
+        memcpy(synthPhase, pPhase, numBins * sizeof(float));
+    }
+    else
+    {
+        const float stretch = (float)synthesisHop / (float)hop;
+        int regionStart = 0;
+
+        for (i = 0; i < numPeaks; i ++)
+        {
+            const int peak = pPeaks[i];
+            const int regionEnd = (i + 1 < numPeaks) ? (peak + pPeaks[i + 1] + 1) / 2 : numBins;
+
+            // The phase advance of the bin centre over a hop, modulo 2pi in integers
+            // as the advance itself grows large. The deviation from it measures how
+            // far the peak's frequency is from the bin centre.
+            const float expected = binScale * (float)((peak * hop) % frameLength);
+            const float deviation = princarg(pPhase[peak] - prevPhase[peak] - expected);
+            const float advance = binScale * (float)((peak * synthesisHop) % frameLength) +
+                                  deviation * stretch;
+            const float peakPhase = princarg(synthPhase[peak] + advance);
+
+            // the region around the peak keeps its phases relative to the peak
+            for (k = regionStart; k < regionEnd; k ++)
+            {
+                synthPhase[k] = princarg(peakPhase + pPhase[k] - pPhase[peak]);
+            }
+            regionStart = regionEnd;
+        }
+    }
+    memcpy(prevPhase, pPhase, numBins * sizeof(float));
+
+    // Resynthesize, & overlap-add with the window applied again. The squared Hann
+    // windows overlapping at each sample sum to 3/8 of the overlap.
+    pFrame[0] = pMagnitude[0] * cosf(synthPhase[0]);
+    pFrame[1] = pMagnitude[half] * cosf(synthPhase[half]);
+    for (k = 1; k < half; k ++)
+    {
+        pFrame[2 * k] = pMagnitude[k] * cosf(synthPhase[k]);
+        pFrame[2 * k + 1] = pMagnitude[k] * sinf(synthPhase[k]);
+    }
+    fft.inverse(pFrame);
+
+    const float gain = 8.0f / (3.0f * VOCODER_OVERLAP);
+    for (i = 0; i < frameLength; i ++)
+    {
+        dest[channels * i] += gain * pWindow[i] * pFrame[i];
+    }
+}
+
+
+// Moves the first 'count' accumulated samples to the output
+void PhaseVocoderStretch::outputAccumulated(int count)
+{
+    const int total = frameLength * channels;
+    const int num = count * channels;
+    SAMPLETYPE *dest = outputBuffer.ptrEnd((uint)count);
+
+    for (int i = 0; i < num; i ++)
+    {
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+        float value = pAccumulator[i];
+        value += (value >= 0) ? 0.5f : -0.5f;
+        if (value > 32767.0f) value = 32767.0f;
+        if (value < -32768.0f) value = -32768.0f;
+        dest[i] = (SAMPLETYPE)value;
+#else
+        dest[i] = pAccumulator[i];
+#endif
+    }
+    outputBuffer.putSamples((uint)count);
+
+    memmove(pAccumulator, pAccumulator + num, (total - num) * sizeof(float));
+    memset(pAccumulator + total - num, 0, num * sizeof(float));
+}
+
+
+// Makes as many output frames as the input suffices for
+void PhaseVocoderStretch::processSamples()
+{
+    const int available = (int)inputBuffer.numSamples();
+    int drop;
+
+    for (;;)
+    {
+        const int start = (int)(inputTime + 0.5);
+        if (start + frameLength > available) break;
+
+        for (int c = 0; c < channels; c ++)
+        {
+            processFrame(start, start - prevFrameStart, c);
+        }
+        bFirstFrame = false;
+        outputAccumulated(synthesisHop);
+
+        prevFrameStart = start;
+        inputTime += tempo * synthesisHop;
+    }
+
+    // Drop the input before the next frame
+    drop = (int)inputTime;
+    if (drop > available) drop = available;
+    if (drop > 0)
+    {
+        inputBuffer.receiveSamples((uint)drop);
+        inputTime -= drop;
+        prevFrameStart -= drop;
+    }
+}
+
+
+// Adds 'numsamples' pcs of samples from the 'samples' memory position into
+// the input of the object.
+void PhaseVocoderStretch::putSamples(const SAMPLETYPE *samples, uint nSamples)
+{
+    inputBuffer.putSamples(samples, nSamples);
+    processSamples();
+}
+
+
+// Processes the samples added directly to the input buffer
+void PhaseVocoderStretch::processInput()
+{
+    processSamples();
+}
+
+
+// Presizes the input buffer for processing up to 'maxInput' samples at a time.
+// Returns the most samples output at a time.
+uint PhaseVocoderStretch::reserve(uint maxInput, double minTempo, double /*maxTempo*/)
+{
+    if (maxInput == 0)
+    {
+        inputBuffer.reserve(0);
+        return 0;
+    }
+
+    // less than a frame is left over between the calls
+    inputBuffer.reserve((uint)frameLength + maxInput);
+
+    // a hop of output per 'tempo' hops of input, plus one for the rounding
+    return (uint)((frameLength + maxInput) / minTempo) + 2 * (uint)synthesisHop;
+}
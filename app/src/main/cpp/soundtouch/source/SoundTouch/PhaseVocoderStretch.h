@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Phase vocoder tempo changer. Analyses the input in overlapping FFT frames and
+/// resynthesizes them at a different hop, advancing the phase of each spectral
+/// peak by its measured frequency and locking the bins around a peak to it, so
+/// that larger pitch shifts stay clear of the phasiness of the plain vocoder and
+/// the warble of time-domain splicing.
+///
+/// Author        : Copyright (c) Olli Parviainen
+/// Author e-mail : oparviai 'at' iki.fi
+/// SoundTouch WWW: http://www.surina.net/soundtouch
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PhaseVocoderStretch_H
+#define PhaseVocoderStretch_H
+
+#include "STTypes.h"
+#include "FIFOSampleBuffer.h"
+#include "TDStretch.h"
+#include "RealFFT.h"
+
+namespace soundtouch
+{
+
+/// Default analysis frame length in milliseconds. The frame is rounded up to a
+/// power of two samples for the FFT.
+#define VOCODER_DEFAULT_FRAME_MS    40
+
+/// Number of frames overlapping at each output sample, i.e. the synthesis hop is
+/// the frame length divided by this
+#define VOCODER_OVERLAP             4
+
+/// A bin is a spectral peak if its magnitude exceeds this many bins on each side
+#define VOCODER_PEAK_NEIGHBOURS     1
+
+
+/// Phase vocoder tempo changer
+class PhaseVocoderStretch : public StretchBase
+{
+protected:
+    int channels;
+    int sampleRate;
+    int frameMs;
+    double tempo;
+
+    /// Frame length & synthesis hop in samples, and the number of spectral bins
+    /// from DC to Nyquist
+    int frameLength;
+    int synthesisHop;
+    int numBins;
+
+    RealFFT fft;
+
+    /// Hann window, used both for analysis and synthesis
+    float *pWindow;
+
+    /// Frame being transformed, the magnitude & phase of its bins, and the peaks
+    /// found among them
+    float *pFrame;
+    float *pMagnitude;
+    float *pPhase;
+    int *pPeaks;
+
+    /// Analysis phase of the previous frame & synthesis phase of the previous
+    /// output frame, 'numBins' per channel
+    float *pPrevPhase;
+    float *pSynthPhase;
+
+    /// Output not finished yet, beginning from the start of the latest frame
+    float *pAccumulator;
+
+    /// Input position of the next analysis frame, and the start of the previous
+    /// one, or no previous frame if 'bFirstFrame' is set
+    double inputTime;
+    int prevFrameStart;
+    bool bFirstFrame;
+
+    FIFOSampleBuffer inputBuffer;
+    FIFOSampleBuffer outputBuffer;
+
+    void allocateBuffers();
+
+    /// Transforms channel 'channel' of the frame at input position 'start' with
+    /// the analysis hop 'hop' from the previous frame, & overlap-adds it to the
+    /// accumulator
+    void processFrame(int start, int hop, int channel);
+
+    /// Moves the first 'count' accumulated samples to the output
+    void outputAccumulated(int count);
+
+    void processSamples();
+
+public:
+    PhaseVocoderStretch();
+    virtual ~PhaseVocoderStretch() override;
+
+    /// Returns the output buffer object
+    FIFOSampleBuffer *getOutput() override { return &outputBuffer; };
+
+    /// Returns the input buffer object
+    FIFOSampleBuffer *getInput() override { return &inputBuffer; };
+
+    /// Sets new target tempo. Normal tempo = 1.0, smaller values represent slower
+    /// tempo, larger faster tempo.
+    void setTempo(double newTempo) override;
+
+    /// Sets the number of channels, 1 = mono, 2 = stereo
+    void setChannels(int numChannels) override;
+
+    /// Sets the sample rate, which scales the frame length
+    void setSampleRate(int newSampleRate);
+
+    /// Sets the analysis frame length in milliseconds. Longer frames resolve the
+    /// frequencies better for larger pitch shifts, at the cost of latency & of
+    /// smearing transients.
+    void setFrameMs(int newFrameMs);
+
+    /// Returns the analysis frame length in milliseconds
+    int getFrameMs() const
+    {
+        return frameMs;
+    }
+
+    /// Clears the input buffer
+    void clearInput() override;
+
+    /// Clears all the samples in the object
+    virtual void clear() override;
+
+    /// Adds 'numSamples' pcs of samples from the 'samples' memory position into
+    /// the input of the object.
+    virtual void putSamples(const SAMPLETYPE *samples, uint numSamples) override;
+
+    /// Processes the samples added directly to the input buffer
+    void processInput() override;
+
+    /// Presizes the input buffer. The work buffers depend only on the frame length
+    /// & channels, and are allocated when those are set.
+    uint reserve(uint maxInput, double minTempo, double maxTempo) override;
+
+    /// return nominal input sample requirement for triggering a processing batch,
+    /// i.e. one frame
+    int getInputSampleReq() const override
+    {
+        return frameLength;
+    }
+
+    /// return nominal output sample amount when running a processing batch, i.e.
+    /// one synthesis hop
+    int getOutputBatchSize() const override
+    {
+        return synthesisHop;
+    }
+
+    /// return approximate initial input-output latency: the first output hop comes
+    /// when the input reaches a frame
+    int getLatency() const override
+    {
+        return frameLength;
+    }
+};
+
+}
+
+#endif
@@ -58,6 +58,9 @@ RateTransposer::RateTransposer() : FIFOProcessor(&outputBuffer)
         false;
 #endif
 
+    pInputBuffer = &inputBuffer;
+    pOutputBuffer = &outputBuffer;
+
     // Instantiates the anti-alias filter
     pAAFilter = new AAFilter(64);
     pTransposer = TransposerBase::newInstance();
@@ -121,26 +124,173 @@ void RateTransposer::setRate(double newRate)
 // the input of the object.
 void RateTransposer::putSamples(const SAMPLETYPE *samples, uint nSamples)
 {
-    processSamples(samples, nSamples);
+    if (nSamples == 0) return;
+
+    // Store samples to input buffer
+    pInputBuffer->putSamples(samples, nSamples);
+    processSamples();
 }
 
 
-// Transposes sample rate by applying anti-alias filter to prevent folding.
-// Returns amount of samples returned in the "dest" buffer.
-// The maximum amount of samples that can be returned at a time is set by
-// the 'set_returnBuffer_size' function.
-void RateTransposer::processSamples(const SAMPLETYPE *src, uint nSamples)
+// Processes the samples added directly to the input buffer
+void RateTransposer::processInput()
 {
-    if (nSamples == 0) return;
+    processSamples();
+}
 
-    // Store samples to input buffer
-    inputBuffer.putSamples(src, nSamples);
+
+// Chains the transposer with the adjacent stages' buffers, nullptr for own buffer
+void RateTransposer::setBuffers(FIFOSampleBuffer *input, FIFOSampleBuffer *output)
+{
+    if (input == nullptr) input = &inputBuffer;
+    if (output == nullptr) output = &outputBuffer;
+
+    if (input != pInputBuffer)
+    {
+        // carry the samples not transposed yet over to the new input
+        input->moveSamples(*pInputBuffer);
+        pInputBuffer = input;
+    }
+    pOutputBuffer = output;
+}
+
+
+// Moves the samples not transposed yet to the output as they are, and resets the
+// transposer.
+void RateTransposer::drain(const SAMPLETYPE *samples, uint numSamples)
+{
+    const double rate = pTransposer->rate;
+    const int latency = pTransposer->getLatency();
+    int end;
+    uint held;
+
+    if (numSamples > 0)
+    {
+        pInputBuffer->putSamples(samples, numSamples);
+    }
+
+    // Number of positions that the interpolation can advance over the input, taking
+    // the samples that it looks ahead & those the pre-filter holds as approximate.
+    // The fraction that's left after rounding is a fraction of one sample at most.
+    end = (int)pInputBuffer->numSamples() - 2 * latency - 1;
+    if (bUseAAFilter && (rate >= 1.0))
+    {
+        end += (int)midBuffer.numSamples() - (int)pAAFilter->getLength();
+    }
+    if (end > 0)
+    {
+        // keep on the same side of rate 1, so that the filter arrangement holds
+        const double fract = pTransposer->getFract();
+
+        pTransposer->setRate((rate < 1.0) ? (end - fract) / end : (end + 1.0 - fract) / end);
+        processSamples();
+        pTransposer->setRate(rate);
+    }
+    held = latency + ((pTransposer->getFract() >= 0.5) ? 1 : 0);
+
+    // The interpolation looks back 'latency' samples from the next position, and
+    // the anti-alias filter has output up to the middle of the samples it holds
+    if (bUseAAFilter)
+    {
+        const uint half = pAAFilter->getLength() / 2;
+
+        if (pTransposer->rate < 1.0f)
+        {
+            // transposed samples waiting for the filter
+            midBuffer.receiveSamples(half);
+        }
+        else
+        {
+            // filtered samples waiting for the transposer, before those in the input
+            midBuffer.receiveSamples(held);
+            held = half;
+        }
+        pOutputBuffer->moveSamples(midBuffer);
+    }
+    pInputBuffer->receiveSamples(held);
+    pOutputBuffer->moveSamples(*pInputBuffer);
+    pTransposer->resetRegisters();
+}
+
+
+// Copies the last 'count' of the 'numSamples' samples at 'history' to 'dest',
+// padding with silence if there are fewer
+static void putHistory(FIFOSampleBuffer &dest, const SAMPLETYPE *history, uint numSamples, uint count)
+{
+    if (count > numSamples)
+    {
+        dest.addSilent(count - numSamples);
+        count = numSamples;
+    }
+    dest.putSamples(history + (numSamples - count) * dest.getChannels(), count);
+}
+
+
+// Resets the transposer & fills its history with the last samples at 'history'.
+void RateTransposer::prime(const SAMPLETYPE *history, uint numSamples)
+{
+    const uint latency = (uint)pTransposer->getLatency();
+
+    inputBuffer.clear();
+    midBuffer.clear();
+    pTransposer->resetRegisters();
+
+    // The next input sample is output first once the interpolation & the filter
+    // have their lookahead past it
+    if (bUseAAFilter == false)
+    {
+        putHistory(*pInputBuffer, history, numSamples, latency);
+    }
+    else if (pTransposer->rate < 1.0f)
+    {
+        putHistory(*pInputBuffer, history, numSamples, latency);
+        putHistory(midBuffer, history, numSamples, pAAFilter->getLength() / 2);
+    }
+    else
+    {
+        putHistory(*pInputBuffer, history, numSamples, pAAFilter->getLength() / 2);
+        putHistory(midBuffer, history, numSamples, latency);
+    }
+}
+
+
+// Primes the transposer with the history kept by 'keepHistory'.
+void RateTransposer::prime()
+{
+    prime(historyBuffer.ptrBegin(), historyBuffer.numSamples());
+}
+
+
+// Keeps the last of the 'numSamples' samples at 'samples' for 'prime'.
+void RateTransposer::keepHistory(const SAMPLETYPE *samples, uint numSamples)
+{
+    uint length = pAAFilter->getLength() / 2;
+
+    if (length < (uint)pTransposer->getLatency()) length = (uint)pTransposer->getLatency();
+    if (numSamples > length)
+    {
+        samples += (numSamples - length) * historyBuffer.getChannels();
+        numSamples = length;
+    }
+    historyBuffer.putSamples(samples, numSamples);
+    if (historyBuffer.numSamples() > length)
+    {
+        historyBuffer.receiveSamples(historyBuffer.numSamples() - length);
+    }
+}
+
+
+// Transposes the samples in the input buffer to the output buffer, applying
+// anti-alias filter to prevent folding.
+void RateTransposer::processSamples()
+{
+    if (pInputBuffer->isEmpty()) return;
 
     // If anti-alias filter is turned off, simply transpose without applying
     // the filter
     if (bUseAAFilter == false)
     {
-        (void)pTransposer->transpose(outputBuffer, inputBuffer);
+        (void)pTransposer->transpose(*pOutputBuffer, *pInputBuffer);
         return;
     }
 
@@ -153,10 +303,10 @@ void RateTransposer::processSamples(const SAMPLETYPE *src, uint nSamples)
         // the samples and then apply the anti-alias filter to remove aliasing.
 
         // Transpose the samples, store the result to end of "midBuffer"
-        pTransposer->transpose(midBuffer, inputBuffer);
+        pTransposer->transpose(midBuffer, *pInputBuffer);
 
         // Apply the anti-alias filter for transposed samples in midBuffer
-        pAAFilter->evaluate(outputBuffer, midBuffer);
+        pAAFilter->evaluate(*pOutputBuffer, midBuffer);
     }
     else
     {
@@ -165,10 +315,10 @@ void RateTransposer::processSamples(const SAMPLETYPE *src, uint nSamples)
         // over the lover frequencies), then transpose.
 
         // Apply the anti-alias filter for samples in inputBuffer
-        pAAFilter->evaluate(midBuffer, inputBuffer);
+        pAAFilter->evaluate(midBuffer, *pInputBuffer);
 
         // Transpose the AA-filtered samples in "midBuffer"
-        pTransposer->transpose(outputBuffer, midBuffer);
+        pTransposer->transpose(*pOutputBuffer, midBuffer);
     }
 }
 
@@ -183,6 +333,7 @@ void RateTransposer::setChannels(int nChannels)
     inputBuffer.setChannels(nChannels);
     midBuffer.setChannels(nChannels);
     outputBuffer.setChannels(nChannels);
+    historyBuffer.setChannels(nChannels);
 }
 
 
@@ -192,11 +343,13 @@ void RateTransposer::clear()
     outputBuffer.clear();
     midBuffer.clear();
     inputBuffer.clear();
+    historyBuffer.clear();
+    pInputBuffer->clear();
     pTransposer->resetRegisters();
 
     // prefill buffer to avoid losing first samples at beginning of stream
     int prefill = getLatency();
-    inputBuffer.addSilent(prefill);
+    pInputBuffer->addSilent(prefill);
 }
 
 
@@ -207,7 +360,7 @@ int RateTransposer::isEmpty() const
 
     res = FIFOProcessor::isEmpty();
     if (res == 0) return 0;
-    return inputBuffer.isEmpty();
+    return pInputBuffer->isEmpty();
 }
 
 
@@ -219,6 +372,36 @@ int RateTransposer::getLatency() const
 }
 
 
+// Presizes the buffers for up to 'maxInput' samples at a time. Returns the most
+// samples output at a time.
+uint RateTransposer::reserve(uint maxInput, double minRate)
+{
+    if (maxInput == 0)
+    {
+        inputBuffer.reserve(0);
+        midBuffer.reserve(0);
+        historyBuffer.reserve(0);
+        return 0;
+    }
+
+    // Besides the new samples, the input holds the prefill or what the transposer &
+    // the anti-alias filter leave over from the previous batch. The filter is
+    // accounted for even if disabled, so that it can be enabled later on.
+    const uint filterLength = pAAFilter->getLength();
+    const uint held = maxInput + (uint)pTransposer->getLatency() + 2 * filterLength + 8;
+    inputBuffer.reserve(held);
+
+    // as in TransposerBase::transpose
+    const uint transposed = (uint)(held / minRate) + 8;
+    midBuffer.reserve(transposed + filterLength);
+
+    // the kept history & the samples added before trimming it
+    historyBuffer.reserve(filterLength + 8);
+
+    return transposed + filterLength;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // TransposerBase - Base class for interpolation
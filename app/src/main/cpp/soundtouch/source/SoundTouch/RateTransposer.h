@@ -83,6 +83,10 @@ public:
     virtual void setChannels(int channels);
     virtual int getLatency() const = 0;
 
+    /// Returns the position of the next output between the input samples that it's
+    /// interpolated from, 0 .. 1
+    virtual double getFract() const = 0;
+
     virtual void resetRegisters() = 0;
 
     // static factory function
@@ -112,22 +116,59 @@ protected:
     /// Output sample buffer
     FIFOSampleBuffer outputBuffer;
 
+    /// The last samples of the pipeline's output, kept by 'keepHistory'
+    FIFOSampleBuffer historyBuffer;
+
+    /// Buffers that the transposer reads & writes: 'inputBuffer' & 'outputBuffer',
+    /// or those of the adjacent stages when chained with them by 'setBuffers'
+    FIFOSampleBuffer *pInputBuffer;
+    FIFOSampleBuffer *pOutputBuffer;
+
     bool bUseAAFilter;
 
 
-    /// Transposes sample rate by applying anti-alias filter to prevent folding.
-    /// Returns amount of samples returned in the "dest" buffer.
-    /// The maximum amount of samples that can be returned at a time is set by
-    /// the 'set_returnBuffer_size' function.
-    void processSamples(const SAMPLETYPE *src,
-                        uint numSamples);
+    /// Transposes the samples in the input buffer to the output buffer, applying
+    /// anti-alias filter to prevent folding.
+    void processSamples();
 
 public:
     RateTransposer();
     virtual ~RateTransposer() override;
 
     /// Returns the output buffer object
-    FIFOSamplePipe *getOutput() { return &outputBuffer; };
+    FIFOSampleBuffer *getOutput() { return &outputBuffer; };
+
+    /// Chains the transposer with the adjacent stages of a pipeline: it reads the
+    /// input from 'input' and writes the output to 'output' instead of its own
+    /// buffers, so that the samples aren't copied from a stage to the next. nullptr
+    /// selects the own buffer. Samples not transposed yet move to the new input.
+    void setBuffers(FIFOSampleBuffer *input, FIFOSampleBuffer *output);
+
+    /// Processes the samples added directly to the input buffer set by 'setBuffers'
+    void processInput();
+
+    /// Adds 'numSamples' samples from 'samples' to the input & transposes the input
+    /// at a rate close to the current one that takes the interpolation to a whole
+    /// input sample at its end. Then moves the samples not transposed yet to the
+    /// output as they are, as if at rate 1, and resets the transposer. Used when
+    /// taking the transposer out of the pipeline at rate 1, so that the output
+    /// continues without skipping, repeating or jumping by a fraction of a sample.
+    void drain(const SAMPLETYPE *samples, uint numSamples);
+
+    /// Resets the transposer & fills its history, that the interpolation & the
+    /// anti-alias filter look back at, with the last of the 'numSamples' samples at
+    /// 'history', missing ones with silence. Used when putting the transposer into
+    /// the pipeline, 'history' being the samples passed so far, so that the output
+    /// continues from the next input sample. Call after setting the rate.
+    void prime(const SAMPLETYPE *history, uint numSamples);
+
+    /// Same with the history kept by 'keepHistory'
+    void prime();
+
+    /// Keeps the last of the 'numSamples' samples at 'samples', as many as 'prime'
+    /// looks back at. Called with the pipeline's output, for priming the transposer
+    /// when it's put after the tempo changer, where its own input is gone already.
+    void keepHistory(const SAMPLETYPE *samples, uint numSamples);
 
     /// Return anti-alias filter object
     AAFilter *getAAFilter();
@@ -157,6 +198,13 @@ public:
 
     /// Return approximate initial input-output latency
     int getLatency() const;
+
+    /// Presizes the own input buffer & the buffer between the transposing & the
+    /// anti-alias filter for up to 'maxInput' samples at a time with the rate down
+    /// to 'minRate', and fixes their capacity so that the processing & rate changes
+    /// don't allocate memory. Zero 'maxInput' releases the fix. Returns the most
+    /// samples output at a time, for presizing the output buffer.
+    uint reserve(uint maxInput, double minRate);
 };
 
 }
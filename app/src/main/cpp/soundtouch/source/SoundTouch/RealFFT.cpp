@@ -0,0 +1,306 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Radix-2 FFT for real-valued data. See 'RealFFT.h' for the spectrum layout.
+///
+/// Author        : Copyright (c) Olli Parviainen
+/// Author e-mail : oparviai 'at' iki.fi
+/// SoundTouch WWW: http://www.surina.net/soundtouch
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <math.h>
+#include "RealFFT.h"
+#include "STTypes.h"
+
+using namespace soundtouch;
+
+#ifndef M_PI
+#define M_PI        3.14159265358979323846
+#endif
+
+
+RealFFT::RealFFT()
+{
+    length = 0;
+    stageRe = nullptr;
+    stageIm = nullptr;
+    splitRe = nullptr;
+    splitIm = nullptr;
+    workRe = nullptr;
+    workIm = nullptr;
+    bitReverse = nullptr;
+}
+
+
+RealFFT::~RealFFT()
+{
+    delete[] stageRe;
+    delete[] stageIm;
+    delete[] splitRe;
+    delete[] splitIm;
+    delete[] workRe;
+    delete[] workIm;
+    delete[] bitReverse;
+}
+
+
+int RealFFT::lengthFor(int count)
+{
+    int n = 8;
+    while (n < count)
+    {
+        n *= 2;
+    }
+    return n;
+}
+
+
+void RealFFT::setLength(int newLength)
+{
+    int i;
+
+    if ((newLength < 8) || (newLength & (newLength - 1)))
+    {
+        ST_THROW_RT_ERROR("RealFFT length must be a power of two, at least 8");
+    }
+    if (newLength == length) return;
+
+    delete[] stageRe;
+    delete[] stageIm;
+    delete[] splitRe;
+    delete[] splitIm;
+    delete[] workRe;
+    delete[] workIm;
+    delete[] bitReverse;
+
+    length = newLength;
+    const int half = length / 2;
+
+    // The passes of half-spans 4, 8, .. half/2 take 4 + 8 + .. = half - 4 twiddles,
+    // and the twiddles of half-span 'span' begin at offset 'span - 4'
+    stageRe = new float[half];
+    stageIm = new float[half];
+    for (int span = 4; span < half; span *= 2)
+    {
+        for (i = 0; i < span; i ++)
+        {
+            double phase = -M_PI * i / span;
+            stageRe[span - 4 + i] = (float)cos(phase);
+            stageIm[span - 4 + i] = (float)sin(phase);
+        }
+    }
+
+    splitRe = new float[half / 2 + 1];
+    splitIm = new float[half / 2 + 1];
+    for (i = 0; i <= half / 2; i ++)
+    {
+        double phase = -2.0 * M_PI * i / length;
+        splitRe[i] = (float)cos(phase);
+        splitIm[i] = (float)sin(phase);
+    }
+
+    workRe = new float[half];
+    workIm = new float[half];
+
+    bitReverse = new int[half];
+    int bits = 0;
+    while ((1 << bits) < half) bits ++;
+    for (i = 0; i < half; i ++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b ++)
+        {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bitReverse[i] = r;
+    }
+}
+
+
+void RealFFT::transformWork()
+{
+    const int half = length / 2;
+    float *re = workRe;
+    float *im = workIm;
+
+    // Passes of size 2 & 4 together; their twiddles are 1 and -i, so no multiplications
+    for (int i = 0; i < half; i += 4)
+    {
+        const float r0 = re[i] + re[i + 1];
+        const float i0 = im[i] + im[i + 1];
+        const float r1 = re[i] - re[i + 1];
+        const float i1 = im[i] - im[i + 1];
+        const float r2 = re[i + 2] + re[i + 3];
+        const float i2 = im[i + 2] + im[i + 3];
+        const float r3 = re[i + 2] - re[i + 3];
+        const float i3 = im[i + 2] - im[i + 3];
+
+        re[i] = r0 + r2;
+        im[i] = i0 + i2;
+        re[i + 2] = r0 - r2;
+        im[i + 2] = i0 - i2;
+        re[i + 1] = r1 + i3;
+        im[i + 1] = i1 - r3;
+        re[i + 3] = r1 - i3;
+        im[i + 3] = i1 + r3;
+    }
+
+    // Remaining passes run over contiguous real, imaginary & twiddle arrays, which
+    // lets the compiler vectorize the butterflies. The upper & lower halves of a
+    // block never overlap, which GCC can't prove by itself.
+    for (int span = 4; span < half; span *= 2)
+    {
+        const float *wr = stageRe + span - 4;
+        const float *wi = stageIm + span - 4;
+
+        for (int start = 0; start < half; start += 2 * span)
+        {
+            float *pr = re + start;
+            float *pi = im + start;
+            float *qr = pr + span;
+            float *qi = pi + span;
+
+            #pragma GCC ivdep
+            for (int j = 0; j < span; j ++)
+            {
+                const float tr = qr[j] * wr[j] - qi[j] * wi[j];
+                const float ti = qr[j] * wi[j] + qi[j] * wr[j];
+                qr[j] = pr[j] - tr;
+                qi[j] = pi[j] - ti;
+                pr[j] += tr;
+                pi[j] += ti;
+            }
+        }
+    }
+}
+
+
+void RealFFT::forward(float *data)
+{
+    const int half = length / 2;
+    int i;
+
+    assert(length > 0);
+
+    // Even samples as the real parts, odd samples as the imaginary parts
+    for (i = 0; i < half; i ++)
+    {
+        workRe[bitReverse[i]] = data[2 * i];
+        workIm[bitReverse[i]] = data[2 * i + 1];
+    }
+
+    transformWork();
+
+    // Split the half-length spectrum Z into the spectra of the even & odd samples,
+    // Fe(k) = (Z(k) + Z*(N/2-k)) / 2 and Fo(k) = (Z(k) - Z*(N/2-k)) / 2i, and combine
+    // them into X(k) = Fe(k) + W^k Fo(k) and X(N/2-k) = (Fe(k) - W^k Fo(k))*
+    data[0] = workRe[0] + workIm[0];
+    data[1] = workRe[0] - workIm[0];
+
+    for (int k = 1; k <= half / 2; k ++)
+    {
+        const int m = half - k;
+        const float ar = workRe[k];
+        const float ai = workIm[k];
+        const float br = workRe[m];
+        const float bi = workIm[m];
+
+        const float er = 0.5f * (ar + br);
+        const float ei = 0.5f * (ai - bi);
+        const float or_ = 0.5f * (ai + bi);
+        const float oi = -0.5f * (ar - br);
+
+        const float tr = splitRe[k] * or_ - splitIm[k] * oi;
+        const float ti = splitRe[k] * oi + splitIm[k] * or_;
+
+        data[2 * k] = er + tr;
+        data[2 * k + 1] = ei + ti;
+        data[2 * m] = er - tr;
+        data[2 * m + 1] = ti - ei;
+    }
+}
+
+
+void RealFFT::inverse(float *data)
+{
+    const int half = length / 2;
+    const float scale = 1.0f / (float)half;
+    int i;
+
+    assert(length > 0);
+
+    // Undo the split of forward(): Fe(k) = (X(k) + X*(N/2-k)) / 2,
+    // Fo(k) = (X(k) - X*(N/2-k)) W^-k / 2 and Z(k) = Fe(k) + i Fo(k).
+    // The inverse transform is done as the forward transform of Z*, whose result
+    // is conjugated back when storing.
+    workRe[0] = 0.5f * (data[0] + data[1]);
+    workIm[0] = -0.5f * (data[0] - data[1]);
+
+    for (int k = 1; k <= half / 2; k ++)
+    {
+        const int m = half - k;
+        const float ar = data[2 * k];
+        const float ai = data[2 * k + 1];
+        const float br = data[2 * m];
+        const float bi = data[2 * m + 1];
+
+        const float er = 0.5f * (ar + br);
+        const float ei = 0.5f * (ai - bi);
+        const float dr = 0.5f * (ar - br);
+        const float di = 0.5f * (ai + bi);
+
+        const float or_ = dr * splitRe[k] + di * splitIm[k];
+        const float oi = di * splitRe[k] - dr * splitIm[k];
+
+        workRe[bitReverse[k]] = er - oi;
+        workIm[bitReverse[k]] = -(ei + or_);
+        workRe[bitReverse[m]] = er + oi;
+        workIm[bitReverse[m]] = ei - or_;
+    }
+
+    transformWork();
+
+    for (i = 0; i < half; i ++)
+    {
+        data[2 * i] = workRe[i] * scale;
+        data[2 * i + 1] = -workIm[i] * scale;
+    }
+}
+
+
+void RealFFT::multiplyConjugate(float *a, const float *b) const
+{
+    // DC & Nyquist terms are real
+    a[0] *= b[0];
+    a[1] *= b[1];
+
+    for (int i = 2; i < length; i += 2)
+    {
+        const float ar = a[i];
+        const float ai = a[i + 1];
+        a[i] = ar * b[i] + ai * b[i + 1];
+        a[i + 1] = ai * b[i] - ar * b[i + 1];
+    }
+}
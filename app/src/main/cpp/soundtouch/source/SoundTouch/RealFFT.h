@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Radix-2 FFT for real-valued data. The real sequence is transformed as a
+/// half-length complex sequence and then split into the spectrum of the real
+/// data, so a transform costs about half of a complex FFT of the same length.
+///
+/// The spectrum is stored in place in the "packed" order: element 0 holds the
+/// DC term, element 1 the Nyquist term (both are real), followed by the real &
+/// imaginary parts of the bins 1 .. N/2-1.
+///
+/// Author        : Copyright (c) Olli Parviainen
+/// Author e-mail : oparviai 'at' iki.fi
+/// SoundTouch WWW: http://www.surina.net/soundtouch
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RealFFT_H
+#define RealFFT_H
+
+namespace soundtouch
+{
+
+class RealFFT
+{
+protected:
+    /// Transform length in real samples, a power of two
+    int length;
+
+    /// Twiddle factors exp(-2*pi*i*j/size) of each butterfly pass from size 8 on,
+    /// stored pass after pass so that a pass reads them contiguously
+    float *stageRe;
+    float *stageIm;
+
+    /// Twiddle factors exp(-2*pi*i*k/length) for splitting the half-length
+    /// spectrum into the spectrum of the real sequence, k = 0 .. length/4
+    float *splitRe;
+    float *splitIm;
+
+    /// Half-length complex work sequence, as separate real & imaginary parts
+    float *workRe;
+    float *workIm;
+
+    /// Bit-reversal permutation of the half-length complex sequence
+    int *bitReverse;
+
+    /// In-place forward FFT of the bit-reversed work sequence. The result isn't scaled.
+    void transformWork();
+
+public:
+    RealFFT();
+    ~RealFFT();
+
+    /// Sets the transform length, which must be a power of two and at least 8.
+    /// Allocates the tables, so call this outside of the real-time processing path.
+    void setLength(int newLength);
+
+    /// Returns the transform length in real samples
+    int getLength() const
+    {
+        return length;
+    }
+
+    /// Returns the smallest power of two transform length that holds 'count' samples
+    static int lengthFor(int count);
+
+    /// Transforms the 'length' real samples in 'data' in place into the packed spectrum.
+    void forward(float *data);
+
+    /// Transforms a packed spectrum in 'data' in place back into real samples,
+    /// including the 1/length scaling, so that inverse(forward(x)) == x.
+    void inverse(float *data);
+
+    /// Multiplies packed spectrum 'a' by the complex conjugate of packed spectrum 'b'
+    /// in place. Followed by inverse(), this gives the circular cross-correlation
+    /// of the two sequences.
+    void multiplyConjugate(float *a, const float *b) const;
+};
+
+}
+
+#endif
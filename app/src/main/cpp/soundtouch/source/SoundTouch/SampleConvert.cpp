@@ -0,0 +1,332 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Sample format conversion routines. The plain C++ routines here are the
+/// reference implementation; SIMD versions are selected at runtime and must
+/// produce bit-identical output.
+///
+/// NEON routines are in this file as NEON is a compile-time choice on ARM.
+/// SSE2 routines are in 'sse_optimized.cpp' and AVX2 in 'avx2_optimized.cpp'.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "SampleConvert.h"
+#include "SampleConvertSIMD.h"
+#include "cpu_detect.h"
+
+#ifdef SOUNDTOUCH_USE_NEON
+    #include <arm_neon.h>
+#endif
+
+using namespace soundtouch;
+
+
+DitherState::DitherState(unsigned int seed)
+{
+    // spread the seed over the lanes; xorshift state must not be zero
+    for (int i = 0; i < SOUNDTOUCH_DITHER_LANES; i ++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        lane[i] = seed ? seed : 0x9e3779b9u;
+    }
+}
+
+
+// Saturates a scaled float sample to the given integer range and truncates it
+static inline int saturate(float fvalue, float minval, float maxval)
+{
+    if (fvalue > maxval)
+    {
+        fvalue = maxval;
+    }
+    else if (fvalue < minval)
+    {
+        fvalue = minval;
+    }
+    return (int)fvalue;
+}
+
+
+// Advances one xorshift32 generator lane
+static inline unsigned int xorshift32(unsigned int &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+
+// Triangular noise in range (-1, 1) from the difference of the two 16bit
+// halves of a random word. Computed in integers so the result is exact.
+static inline float tpdfNoise(unsigned int rnd)
+{
+    return (float)((int)(rnd >> 16) - (int)(rnd & 0xffff)) * (1.0f / 65536.0f);
+}
+
+
+#ifdef SOUNDTOUCH_USE_NEON
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// NEON routines
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Saturates scaled samples to 16bit range and truncates them
+static inline int16x4_t neonToInt16(float32x4_t v, float32x4_t vMin, float32x4_t vMax)
+{
+    v = vminq_f32(vmaxq_f32(v, vMin), vMax);
+    return vqmovn_s32(vcvtq_s32_f32(v));
+}
+
+
+static uint convertFloatToInt16NEON(const float *src, short *dest, uint numSamples)
+{
+    const float32x4_t vScale = vdupq_n_f32(32768.0f);
+    const float32x4_t vMin = vdupq_n_f32(-32768.0f);
+    const float32x4_t vMax = vdupq_n_f32(32767.0f);
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 8)
+    {
+        int16x4_t lo = neonToInt16(vmulq_f32(vld1q_f32(src + i), vScale), vMin, vMax);
+        int16x4_t hi = neonToInt16(vmulq_f32(vld1q_f32(src + i + 4), vScale), vMin, vMax);
+        vst1q_s16(dest + i, vcombine_s16(lo, hi));
+    }
+    return count;
+}
+
+
+static inline float32x4_t neonTpdfNoise(uint32x4_t &state)
+{
+    state = veorq_u32(state, vshlq_n_u32(state, 13));
+    state = veorq_u32(state, vshrq_n_u32(state, 17));
+    state = veorq_u32(state, vshlq_n_u32(state, 5));
+
+    int32x4_t hi = vreinterpretq_s32_u32(vshrq_n_u32(state, 16));
+    int32x4_t lo = vreinterpretq_s32_u32(vandq_u32(state, vdupq_n_u32(0xffff)));
+    return vmulq_n_f32(vcvtq_f32_s32(vsubq_s32(hi, lo)), 1.0f / 65536.0f);
+}
+
+
+static uint convertFloatToInt16DitherNEON(const float *src, short *dest, uint numSamples, DitherState &dither)
+{
+    const float32x4_t vScale = vdupq_n_f32(32768.0f);
+    const float32x4_t vMin = vdupq_n_f32(-32768.0f);
+    const float32x4_t vMax = vdupq_n_f32(32767.0f);
+    uint32x4_t state0 = vld1q_u32(dither.lane);
+    uint32x4_t state1 = vld1q_u32(dither.lane + 4);
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 8)
+    {
+        float32x4_t v0 = vmlaq_f32(neonTpdfNoise(state0), vld1q_f32(src + i), vScale);
+        float32x4_t v1 = vmlaq_f32(neonTpdfNoise(state1), vld1q_f32(src + i + 4), vScale);
+        int16x4_t lo = neonToInt16(v0, vMin, vMax);
+        int16x4_t hi = neonToInt16(v1, vMin, vMax);
+        vst1q_s16(dest + i, vcombine_s16(lo, hi));
+    }
+
+    vst1q_u32(dither.lane, state0);
+    vst1q_u32(dither.lane + 4, state1);
+    return count;
+}
+
+
+static uint convertInt16ToFloatNEON(const short *src, float *dest, uint numSamples)
+{
+    const float scale = 1.0f / 32768.0f;
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 8)
+    {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_f32(dest + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(dest + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+    return count;
+}
+
+
+static uint convertFloatToInt24NEON(const float *src, int *dest, uint numSamples)
+{
+    const float32x4_t vScale = vdupq_n_f32(8388608.0f);
+    const float32x4_t vMin = vdupq_n_f32(-8388608.0f);
+    const float32x4_t vMax = vdupq_n_f32(8388607.0f);
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 4)
+    {
+        float32x4_t v = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i), vScale), vMin), vMax);
+        vst1q_s32(dest + i, vcvtq_s32_f32(v));
+    }
+    return count;
+}
+
+#endif // SOUNDTOUCH_USE_NEON
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Public routines: SIMD for the bulk of the samples, C++ for the remainder
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// The SSE2 choice is in a block of its own, as integer sample builds have AVX2
+// without SSE2 and the 'else' must not take the remainder loop instead.
+
+void soundtouch::convertFloatToInt16(const float *src, short *dest, uint numSamples)
+{
+    uint done = 0;
+    uint uExtensions = detectCPUextensions();
+    (void)uExtensions;
+
+#if defined(SOUNDTOUCH_USE_NEON)
+    done = convertFloatToInt16NEON(src, dest, numSamples);
+#else
+  #ifdef SOUNDTOUCH_ALLOW_AVX2
+    if (uExtensions & SUPPORT_AVX2)
+    {
+        done = convertFloatToInt16AVX2(src, dest, numSamples);
+    }
+    else
+  #endif
+    {
+  #ifdef SOUNDTOUCH_ALLOW_SSE2
+        if (uExtensions & SUPPORT_SSE2)
+        {
+            done = convertFloatToInt16SSE2(src, dest, numSamples);
+        }
+  #endif
+    }
+#endif
+
+    for (uint i = done; i < numSamples; i ++)
+    {
+        dest[i] = (short)saturate(src[i] * 32768.0f, -32768.0f, 32767.0f);
+    }
+}
+
+
+void soundtouch::convertFloatToInt16Dither(const float *src, short *dest, uint numSamples,
+                                           DitherState &dither)
+{
+    uint done = 0;
+    uint uExtensions = detectCPUextensions();
+    (void)uExtensions;
+
+#if defined(SOUNDTOUCH_USE_NEON)
+    done = convertFloatToInt16DitherNEON(src, dest, numSamples, dither);
+#else
+  #ifdef SOUNDTOUCH_ALLOW_AVX2
+    if (uExtensions & SUPPORT_AVX2)
+    {
+        done = convertFloatToInt16DitherAVX2(src, dest, numSamples, dither);
+    }
+    else
+  #endif
+    {
+  #ifdef SOUNDTOUCH_ALLOW_SSE2
+        if (uExtensions & SUPPORT_SSE2)
+        {
+            done = convertFloatToInt16DitherSSE2(src, dest, numSamples, dither);
+        }
+  #endif
+    }
+#endif
+
+    // SIMD routines process whole lane groups, so the remainder starts from lane 0
+    for (uint i = done; i < numSamples; i ++)
+    {
+        unsigned int rnd = xorshift32(dither.lane[i % SOUNDTOUCH_DITHER_LANES]);
+        float value = src[i] * 32768.0f + tpdfNoise(rnd);
+        dest[i] = (short)saturate(value, -32768.0f, 32767.0f);
+    }
+}
+
+
+void soundtouch::convertInt16ToFloat(const short *src, float *dest, uint numSamples)
+{
+    uint done = 0;
+    uint uExtensions = detectCPUextensions();
+    (void)uExtensions;
+
+#if defined(SOUNDTOUCH_USE_NEON)
+    done = convertInt16ToFloatNEON(src, dest, numSamples);
+#else
+  #ifdef SOUNDTOUCH_ALLOW_AVX2
+    if (uExtensions & SUPPORT_AVX2)
+    {
+        done = convertInt16ToFloatAVX2(src, dest, numSamples);
+    }
+    else
+  #endif
+    {
+  #ifdef SOUNDTOUCH_ALLOW_SSE2
+        if (uExtensions & SUPPORT_SSE2)
+        {
+            done = convertInt16ToFloatSSE2(src, dest, numSamples);
+        }
+  #endif
+    }
+#endif
+
+    for (uint i = done; i < numSamples; i ++)
+    {
+        dest[i] = (float)src[i] * (1.0f / 32768.0f);
+    }
+}
+
+
+void soundtouch::convertFloatToInt24(const float *src, int *dest, uint numSamples)
+{
+    uint done = 0;
+    uint uExtensions = detectCPUextensions();
+    (void)uExtensions;
+
+#if defined(SOUNDTOUCH_USE_NEON)
+    done = convertFloatToInt24NEON(src, dest, numSamples);
+#else
+  #ifdef SOUNDTOUCH_ALLOW_AVX2
+    if (uExtensions & SUPPORT_AVX2)
+    {
+        done = convertFloatToInt24AVX2(src, dest, numSamples);
+    }
+    else
+  #endif
+    {
+  #ifdef SOUNDTOUCH_ALLOW_SSE2
+        if (uExtensions & SUPPORT_SSE2)
+        {
+            done = convertFloatToInt24SSE2(src, dest, numSamples);
+        }
+  #endif
+    }
+#endif
+
+    for (uint i = done; i < numSamples; i ++)
+    {
+        dest[i] = saturate(src[i] * 8388608.0f, -8388608.0f, 8388607.0f);
+    }
+}
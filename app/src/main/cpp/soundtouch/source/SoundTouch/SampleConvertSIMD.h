@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Declarations of the SIMD sample format conversion routines. Each routine
+/// converts the largest multiple of SOUNDTOUCH_DITHER_LANES samples and returns
+/// that count; the caller converts the remaining samples with the C++ routines.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SampleConvertSIMD_H
+#define SampleConvertSIMD_H
+
+#include "STTypes.h"
+#include "SampleConvert.h"
+
+// SSE2 is part of the x86-64 baseline; 32bit x86 builds need it enabled explicitly
+#if defined(SOUNDTOUCH_ALLOW_SSE) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+    #define SOUNDTOUCH_ALLOW_SSE2   1
+#endif
+
+// AVX2 routines are compiled with AVX2 code generation enabled for themselves
+// only, and selected at runtime
+#if defined(SOUNDTOUCH_ALLOW_AVX2) && !defined(SOUNDTOUCH_ALLOW_X86_OPTIMIZATIONS)
+    #undef SOUNDTOUCH_ALLOW_AVX2
+#endif
+
+namespace soundtouch
+{
+
+#ifdef SOUNDTOUCH_ALLOW_SSE2
+    uint convertFloatToInt16SSE2(const float *src, short *dest, uint numSamples);
+    uint convertFloatToInt16DitherSSE2(const float *src, short *dest, uint numSamples, DitherState &dither);
+    uint convertInt16ToFloatSSE2(const short *src, float *dest, uint numSamples);
+    uint convertFloatToInt24SSE2(const float *src, int *dest, uint numSamples);
+#endif
+
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+    uint convertFloatToInt16AVX2(const float *src, short *dest, uint numSamples);
+    uint convertFloatToInt16DitherAVX2(const float *src, short *dest, uint numSamples, DitherState &dither);
+    uint convertInt16ToFloatAVX2(const short *src, float *dest, uint numSamples);
+    uint convertFloatToInt24AVX2(const float *src, int *dest, uint numSamples);
+#endif
+
+}
+
+#endif
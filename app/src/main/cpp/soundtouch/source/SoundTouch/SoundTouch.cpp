@@ -70,6 +70,8 @@
 
 #include "SoundTouch.h"
 #include "TDStretch.h"
+#include "PSOLAStretch.h"
+#include "PhaseVocoderStretch.h"
 #include "RateTransposer.h"
 #include "cpu_detect.h"
 
@@ -78,6 +80,32 @@ using namespace soundtouch;
 /// test if two floating point numbers are equal
 #define TEST_FLOAT_EQUAL(a, b)  (fabs(a - b) < 1e-10)
 
+/// Input samples per step of the control value ramps
+#define RAMP_STEP_SAMPLES       128
+
+/// Positions of the rate transposer in the processing pipeline
+enum
+{
+    TRANSPOSE_BEFORE_TEMPO,     ///< transposing the rate down, before the tempo changer
+    TRANSPOSE_BYPASSED,         ///< at rate 1, out of the pipeline
+    TRANSPOSE_AFTER_TEMPO       ///< transposing the rate up, after the tempo changer
+};
+
+
+// Returns the position of the rate transposer in the pipeline at rate 'rate'. The
+// transposer changes sides only through rate 1, where it is out of the pipeline,
+// so that the tempo changer is never rechained with samples in process.
+static int positionAtRate(double rate)
+{
+#ifdef SOUNDTOUCH_PREVENT_CLICK_AT_RATE_CROSSOVER
+    (void)rate;
+    return TRANSPOSE_AFTER_TEMPO;
+#else
+    if (TEST_FLOAT_EQUAL(rate, 1.0)) return TRANSPOSE_BYPASSED;
+    return (rate < 1.0) ? TRANSPOSE_BEFORE_TEMPO : TRANSPOSE_AFTER_TEMPO;
+#endif
+}
+
 
 /// Print library version string for autoconf
 extern "C" void soundtouch_ac_test()
@@ -92,22 +120,34 @@ SoundTouch::SoundTouch()
 
     pRateTransposer = new RateTransposer();
     pTDStretch = TDStretch::newInstance();
-
-    setOutPipe(pTDStretch);
+    pPSOLAStretch = new PSOLAStretch();
+    pVocoderStretch = new PhaseVocoderStretch();
+    pStretch = pTDStretch;
 
     rate = tempo = 0;
+    transposerPosition = TRANSPOSE_BYPASSED;
+    bDrainTransposer = false;
+
+    setOutPipe(pStretch);
+    chainStages();
+
+    reservedFrames = 0;
+    reservedRatio = 1.0;
+    reservedBacklog = 0;
 
     virtualPitch =
     virtualRate =
     virtualTempo = 1.0;
 
-    calcEffectiveRateAndTempo();
+    rampMs = 0;
+    rampRemaining = 0;
+    bSrateSet = false;
+    updateControls();
 
     samplesExpectedOut = 0;
     samplesOutput = 0;
 
     channels = 0;
-    bSrateSet = false;
 }
 
 
@@ -115,6 +155,8 @@ SoundTouch::~SoundTouch()
 {
     delete pRateTransposer;
     delete pTDStretch;
+    delete pPSOLAStretch;
+    delete pVocoderStretch;
 }
 
 
@@ -139,139 +181,393 @@ void SoundTouch::setChannels(uint numChannels)
 {
     if (!verifyNumberOfChannels(numChannels)) return;
 
+    if ((reservedFrames > 0) && (numChannels != channels))
+    {
+        ST_THROW_RT_ERROR("SoundTouch : Can't change the number of channels of reserved buffers");
+    }
+
     channels = numChannels;
     pRateTransposer->setChannels((int)numChannels);
     pTDStretch->setChannels((int)numChannels);
+    pPSOLAStretch->setChannels((int)numChannels);
+    pVocoderStretch->setChannels((int)numChannels);
 }
 
 
 // Sets new rate control value. Normal rate = 1.0, smaller values
 // represent slower rate, larger faster rates.
-void SoundTouch::setRate(double newRate)
+bool SoundTouch::setRate(double newRate)
 {
+    const double oldValue = virtualRate;
+
     virtualRate = newRate;
-    calcEffectiveRateAndTempo();
+    if (!updateControls())
+    {
+        virtualRate = oldValue;
+        return false;
+    }
+    return true;
 }
 
 
 // Sets new rate control value as a difference in percents compared
 // to the original rate (-50 .. +100 %)
-void SoundTouch::setRateChange(double newRate)
+bool SoundTouch::setRateChange(double newRate)
 {
+    const double oldValue = virtualRate;
+
     virtualRate = 1.0 + 0.01 * newRate;
-    calcEffectiveRateAndTempo();
+    if (!updateControls())
+    {
+        virtualRate = oldValue;
+        return false;
+    }
+    return true;
 }
 
 
 // Sets new tempo control value. Normal tempo = 1.0, smaller values
 // represent slower tempo, larger faster tempo.
-void SoundTouch::setTempo(double newTempo)
+bool SoundTouch::setTempo(double newTempo)
 {
+    const double oldValue = virtualTempo;
+
     virtualTempo = newTempo;
-    calcEffectiveRateAndTempo();
+    if (!updateControls())
+    {
+        virtualTempo = oldValue;
+        return false;
+    }
+    return true;
 }
 
 
 // Sets new tempo control value as a difference in percents compared
 // to the original tempo (-50 .. +100 %)
-void SoundTouch::setTempoChange(double newTempo)
+bool SoundTouch::setTempoChange(double newTempo)
 {
+    const double oldValue = virtualTempo;
+
     virtualTempo = 1.0 + 0.01 * newTempo;
-    calcEffectiveRateAndTempo();
+    if (!updateControls())
+    {
+        virtualTempo = oldValue;
+        return false;
+    }
+    return true;
 }
 
 
 // Sets new pitch control value. Original pitch = 1.0, smaller values
 // represent lower pitches, larger values higher pitch.
-void SoundTouch::setPitch(double newPitch)
+bool SoundTouch::setPitch(double newPitch)
 {
+    const double oldValue = virtualPitch;
+
     virtualPitch = newPitch;
-    calcEffectiveRateAndTempo();
+    if (!updateControls())
+    {
+        virtualPitch = oldValue;
+        return false;
+    }
+    return true;
 }
 
 
 // Sets pitch change in octaves compared to the original pitch
 // (-1.00 .. +1.00)
-void SoundTouch::setPitchOctaves(double newPitch)
+bool SoundTouch::setPitchOctaves(double newPitch)
 {
+    const double oldValue = virtualPitch;
+
     virtualPitch = exp(0.69314718056 * newPitch);
-    calcEffectiveRateAndTempo();
+    if (!updateControls())
+    {
+        virtualPitch = oldValue;
+        return false;
+    }
+    return true;
 }
 
 
 // Sets pitch change in semi-tones compared to the original pitch
 // (-12 .. +12)
-void SoundTouch::setPitchSemiTones(int newPitch)
+bool SoundTouch::setPitchSemiTones(int newPitch)
 {
-    setPitchOctaves((double)newPitch / 12.0);
+    return setPitchOctaves((double)newPitch / 12.0);
 }
 
 
-void SoundTouch::setPitchSemiTones(double newPitch)
+bool SoundTouch::setPitchSemiTones(double newPitch)
 {
-    setPitchOctaves(newPitch / 12.0);
+    return setPitchOctaves(newPitch / 12.0);
+}
+
+
+// Returns true if 'value' is between 1/'ratio' and 'ratio'
+static bool isInRange(double value, double ratio)
+{
+    return (value * ratio >= 1.0 - 1e-9) && (value <= ratio + 1e-9);
 }
 
 
 // Calculates 'effective' rate and tempo values from the
-// nominal control values.
+// control values in use.
 void SoundTouch::calcEffectiveRateAndTempo()
 {
     double oldTempo = tempo;
     double oldRate = rate;
+    int newPosition;
 
-    tempo = virtualTempo / virtualPitch;
-    rate = virtualPitch * virtualRate;
+    tempo = rampedTempo / rampedPitch;
+    rate = rampedPitch * rampedRate;
+    if ((reservedFrames > 0) && (!isInRange(tempo, reservedRatio) || !isInRange(rate, reservedRatio)))
+    {
+        // only a ramp already heading out of the range when 'reserve' was called
+        // gets here; stay at the last values within it
+        tempo = oldTempo;
+        rate = oldRate;
+        return;
+    }
 
-    if (!TEST_FLOAT_EQUAL(rate,oldRate)) pRateTransposer->setRate(rate);
-    if (!TEST_FLOAT_EQUAL(tempo, oldTempo)) pTDStretch->setTempo(tempo);
+    if (!TEST_FLOAT_EQUAL(tempo, oldTempo))
+    {
+        pTDStretch->setTempo(tempo);
+        pPSOLAStretch->setTempo(tempo);
+        pVocoderStretch->setTempo(tempo);
+    }
 
-#ifndef SOUNDTOUCH_PREVENT_CLICK_AT_RATE_CROSSOVER
-    if (rate <= 1.0f)
+    newPosition = positionAtRate(rate);
+    if ((newPosition != transposerPosition) && (transposerPosition != TRANSPOSE_BYPASSED))
     {
-        if (output != pTDStretch)
+        if (rampRemaining > 0)
         {
-            FIFOSamplePipe *tempoOut;
+            // A ramp taking the transposer out of its side of rate 1 stops at 1 for
+            // the step, over which the transposer drains, so that the samples then
+            // pass as they are. It keeps its rate until drained.
+            rate = 1.0;
+            bDrainTransposer = true;
+            return;
+        }
 
-            assert(output == pRateTransposer);
-            // move samples in the current output buffer to the output of pTDStretch
-            tempoOut = pTDStretch->getOutput();
-            tempoOut->moveSamples(*output);
-            // move samples in pitch transposer's store buffer to tempo changer's input
-            // deprecated : pTDStretch->moveSamples(*pRateTransposer->getStore());
+        // take the transposer out of the pipeline, passing on what it holds as if at
+        // rate 1, before the new rate changes how it would transpose that
+        pRateTransposer->drain(nullptr, 0);
+        bypassTransposer();
+    }
+
+    if (!TEST_FLOAT_EQUAL(rate,oldRate)) pRateTransposer->setRate(rate);
 
-            output = pTDStretch;
+    if (newPosition != transposerPosition)
+    {
+        // put the transposer into the pipeline with the samples passed so far as its
+        // history, so that it continues from the next sample on
+        if (newPosition == TRANSPOSE_BEFORE_TEMPO)
+        {
+            FIFOSampleBuffer *tempoIn = pStretch->getInput();
+
+            pRateTransposer->prime(tempoIn->ptrBegin(), tempoIn->numSamples());
         }
+        else
+        {
+            // the history is the last of the output, kept as it was output; what's
+            // still unreceived of it moves to the transposer's output
+            pRateTransposer->prime();
+            pRateTransposer->getOutput()->moveSamples(*pStretch->getOutput());
+            output = pRateTransposer;
+        }
+        transposerPosition = newPosition;
+        chainStages();
+    }
+}
+
+
+// Starts ramping the control values in use to the nominal ones, or sets them at
+// once if there's no ramp.
+bool SoundTouch::updateControls()
+{
+    int sampleRate;
+
+    if ((reservedFrames > 0) &&
+        (!isInRange(virtualTempo / virtualPitch, reservedRatio) ||
+         !isInRange(virtualPitch * virtualRate, reservedRatio)))
+    {
+        return false;
+    }
+
+    pTDStretch->getParameters(&sampleRate, nullptr, nullptr, nullptr);
+    rampRemaining = bSrateSet ? (uint)(rampMs * sampleRate / 1000) : 0;
+    if (rampRemaining == 0)
+    {
+        advanceRamp(0);
+    }
+    return true;
+}
+
+
+// Advances the control value ramp by 'numSamples' samples of input.
+void SoundTouch::advanceRamp(uint numSamples)
+{
+    if (numSamples >= rampRemaining)
+    {
+        rampedRate = virtualRate;
+        rampedTempo = virtualTempo;
+        rampedPitch = virtualPitch;
     }
     else
-#endif
     {
-        if (output != pRateTransposer)
-        {
-            FIFOSamplePipe *transOut;
+        // geometric steps, so that the effective rate & tempo move monotonously
+        // between their initial & final values, and the pitch evenly in semitones
+        const double step = (double)numSamples / (double)rampRemaining;
 
-            assert(output == pTDStretch);
-            // move samples in the current output buffer to the output of pRateTransposer
-            transOut = pRateTransposer->getOutput();
-            transOut->moveSamples(*output);
-            // move samples in tempo changer's input to pitch transposer's input
-            pRateTransposer->moveSamples(*pTDStretch->getInput());
+        rampedRate *= pow(virtualRate / rampedRate, step);
+        rampedTempo *= pow(virtualTempo / rampedTempo, step);
+        rampedPitch *= pow(virtualPitch / rampedPitch, step);
+    }
+    calcEffectiveRateAndTempo();
 
-            output = pRateTransposer;
-        }
+    if (numSamples < rampRemaining)
+    {
+        rampRemaining -= numSamples;
+    }
+    else
+    {
+        // a step that stops at rate 1 to drain the transposer still has one to follow
+        rampRemaining = bDrainTransposer ? 1 : 0;
+    }
+}
+
+
+// Chains the rate transposer with the tempo changer in the current processing
+// order: the stage first in the order writes its output directly to the input
+// buffer of the other, so the samples aren't copied between them.
+void SoundTouch::chainStages()
+{
+    switch (transposerPosition)
+    {
+        case TRANSPOSE_BEFORE_TEMPO :
+            // transposing before timestretch
+            pRateTransposer->setBuffers(nullptr, pStretch->getInput());
+            break;
+
+        case TRANSPOSE_AFTER_TEMPO :
+            // timestretch before transposing
+            pRateTransposer->setBuffers(pStretch->getOutput(), nullptr);
+            break;
+
+        default :
+            // out of the pipeline
+            pRateTransposer->setBuffers(nullptr, nullptr);
+            break;
     }
 }
 
 
+// Takes the drained rate transposer out of the pipeline. If it was after the tempo
+// changer, the tempo changer's output is the output again.
+void SoundTouch::bypassTransposer()
+{
+    pRateTransposer->setBuffers(nullptr, nullptr);
+    if (transposerPosition == TRANSPOSE_AFTER_TEMPO)
+    {
+        output = pStretch;
+        pStretch->getOutput()->moveSamples(*pRateTransposer->getOutput());
+    }
+    transposerPosition = TRANSPOSE_BYPASSED;
+    bDrainTransposer = false;
+}
+
+
 // Sets sample rate.
 void SoundTouch::setSampleRate(uint srate)
 {
+    if (reservedFrames > 0)
+    {
+        int sampleRate;
+
+        pTDStretch->getParameters(&sampleRate, nullptr, nullptr, nullptr);
+        if ((int)srate != sampleRate)
+        {
+            ST_THROW_RT_ERROR("SoundTouch : Can't change the sample rate of reserved buffers");
+        }
+        return;
+    }
+
     // set sample rate, leave other tempo changer parameters as they are.
     pTDStretch->setParameters((int)srate);
+    pPSOLAStretch->setSampleRate((int)srate);
+    pVocoderStretch->setSampleRate((int)srate);
     bSrateSet = true;
 }
 
 
+// Presizes the processing buffers for input blocks of up to 'maxBlockFrames'
+// samples with the effective tempo & rate between 1/'maxRatio' and 'maxRatio',
+// and fixes their capacity so that the processing doesn't allocate memory.
+void SoundTouch::reserve(uint maxBlockFrames, double maxRatio)
+{
+    uint transposed, stretched, input, temp;
+
+    if (maxBlockFrames == 0)
+    {
+        reservedFrames = 0;
+        pRateTransposer->reserve(0, 1.0);
+        pTDStretch->reserve(0, 1.0, 1.0);
+        pPSOLAStretch->reserve(0, 1.0, 1.0);
+        pVocoderStretch->reserve(0, 1.0, 1.0);
+        pRateTransposer->getOutput()->reserve(0);
+        pTDStretch->getOutput()->reserve(0);
+        pPSOLAStretch->getOutput()->reserve(0);
+        pVocoderStretch->getOutput()->reserve(0);
+        return;
+    }
+
+    if (bSrateSet == false)
+    {
+        ST_THROW_RT_ERROR("SoundTouch : Sample rate not defined");
+    }
+    else if (channels == 0)
+    {
+        ST_THROW_RT_ERROR("SoundTouch : Number of channels not defined");
+    }
+    if (maxRatio < 1.0) maxRatio = 1.0 / maxRatio;
+    if (!isInRange(tempo, maxRatio) || !isInRange(rate, maxRatio))
+    {
+        ST_THROW_RT_ERROR("SoundTouch : Tempo or rate out of the range to reserve");
+    }
+
+    // The transposer comes first when transposing the rate down, getting the blocks
+    // & feeding the tempo changer, otherwise last, getting what the tempo changer
+    // outputs. Both tempo changers are reserved, as the tempo changes apply to both
+    // & the engine may be switched.
+    transposed = pRateTransposer->reserve(maxBlockFrames, 1.0 / maxRatio);
+    input = (transposed > maxBlockFrames) ? transposed : maxBlockFrames;
+    stretched = pTDStretch->reserve(input, 1.0 / maxRatio, maxRatio);
+    temp = pPSOLAStretch->reserve(input, 1.0 / maxRatio, maxRatio);
+    if (temp > stretched) stretched = temp;
+    temp = pVocoderStretch->reserve(input, 1.0 / maxRatio, maxRatio);
+    if (temp > stretched) stretched = temp;
+#ifdef SOUNDTOUCH_PREVENT_CLICK_AT_RATE_CROSSOVER
+    transposed = pRateTransposer->reserve(stretched, 1.0 / maxRatio);
+#else
+    temp = pRateTransposer->reserve(stretched, 1.0);
+    if (temp > transposed) transposed = temp;
+#endif
+    reservedBacklog = (transposed > stretched) ? transposed : stretched;
+
+    // The output buffers hold what a block produces on top of what was left in
+    // them, and pass the samples over from one to another when the order changes.
+    // Flushing leaves in the output what was in the pipeline, also within a block.
+    pRateTransposer->getOutput()->reserve(2 * reservedBacklog);
+    pTDStretch->getOutput()->reserve(2 * reservedBacklog);
+    pPSOLAStretch->getOutput()->reserve(2 * reservedBacklog);
+    pVocoderStretch->getOutput()->reserve(2 * reservedBacklog);
+
+    reservedFrames = maxBlockFrames;
+    reservedRatio = maxRatio;
+}
+
+
 // Adds 'numSamples' pcs of samples from the 'samples' memory position into
 // the input of the object.
 void SoundTouch::putSamples(const SAMPLETYPE *samples, uint nSamples)
@@ -284,27 +580,100 @@ void SoundTouch::putSamples(const SAMPLETYPE *samples, uint nSamples)
     {
         ST_THROW_RT_ERROR("SoundTouch : Number of channels not defined");
     }
+    else if (!tryPutSamples(samples, nSamples))
+    {
+        ST_THROW_RT_ERROR("SoundTouch : Block or unreceived output exceeds the reserved buffers");
+    }
+}
+
+
+// Adds the samples like 'putSamples', but returns false instead of throwing when the
+// block or unreceived output exceed the reserved buffers.
+bool SoundTouch::tryPutSamples(const SAMPLETYPE *samples, uint nSamples)
+{
+    if ((bSrateSet == false) || (channels == 0))
+    {
+        return false;
+    }
+    if ((reservedFrames > 0) &&
+        ((nSamples > reservedFrames) || (numSamples() > reservedBacklog)))
+    {
+        return false;
+    }
+
+    // ramp the control values in short steps, so that the changes are smooth
+    // regardless of the block size
+    while ((rampRemaining > 0) && (nSamples > 0))
+    {
+        const uint step = (nSamples < RAMP_STEP_SAMPLES) ? nSamples : RAMP_STEP_SAMPLES;
+
+        advanceRamp(step);
+        processBlock(samples, step);
+        samples += step * channels;
+        nSamples -= step;
+    }
+    if (nSamples > 0)
+    {
+        processBlock(samples, nSamples);
+    }
+    return true;
+}
+
+
+// Processes 'nSamples' of input with the current control values.
+void SoundTouch::processBlock(const SAMPLETYPE *samples, uint nSamples)
+{
+    const uint numOutput = numSamples();
 
     // accumulate how many samples are expected out from processing, given the current
     // processing setting
     samplesExpectedOut += (double)nSamples / ((double)rate * (double)tempo);
 
-#ifndef SOUNDTOUCH_PREVENT_CLICK_AT_RATE_CROSSOVER
-    if (rate <= 1.0f)
+    switch (transposerPosition)
     {
-        // transpose the rate down, output the transposed sound to tempo changer buffer
-        assert(output == pTDStretch);
-        pRateTransposer->putSamples(samples, nSamples);
-        pTDStretch->moveSamples(*pRateTransposer);
+        case TRANSPOSE_BEFORE_TEMPO :
+            // transpose the rate down, output the transposed sound to tempo changer buffer
+            assert(output == pStretch);
+            if (bDrainTransposer)
+            {
+                pRateTransposer->drain(samples, nSamples);
+            }
+            else
+            {
+                pRateTransposer->putSamples(samples, nSamples);
+            }
+            pStretch->processInput();
+            break;
+
+        case TRANSPOSE_AFTER_TEMPO :
+            // evaluate the tempo changer, then transpose the rate up,
+            assert(output == pRateTransposer);
+            pStretch->putSamples(samples, nSamples);
+            if (bDrainTransposer)
+            {
+                pRateTransposer->drain(nullptr, 0);
+            }
+            else
+            {
+                pRateTransposer->processInput();
+            }
+            break;
+
+        default :
+            // at rate 1 only the tempo changer
+            assert(output == pStretch);
+            pStretch->putSamples(samples, nSamples);
+            break;
     }
-    else
-#endif
+    if (bDrainTransposer)
     {
-        // evaluate the tempo changer, then transpose the rate up,
-        assert(output == pRateTransposer);
-        pTDStretch->putSamples(samples, nSamples);
-        pRateTransposer->moveSamples(*pTDStretch);
+        bypassTransposer();
     }
+
+    // the transposer keeps the last of the output for the history that it needs
+    // if it's put after the tempo changer, after which the output is gone
+    pRateTransposer->keepHistory(output->ptrBegin() + numOutput * channels,
+                                 numSamples() - numOutput);
 }
 
 
@@ -319,28 +688,28 @@ void SoundTouch::flush()
 {
     int i;
     int numStillExpected;
-    SAMPLETYPE *buff = new SAMPLETYPE[128 * channels];
+    // static so that flushing doesn't allocate memory
+    static const SAMPLETYPE buff[128 * SOUNDTOUCH_MAX_CHANNELS] = {0};
+    // within the reserved block size
+    const uint blockSize = ((reservedFrames > 0) && (reservedFrames < 128)) ? reservedFrames : 128;
 
     // how many samples are still expected to output
     numStillExpected = (int)((long)(samplesExpectedOut + 0.5) - samplesOutput);
     if (numStillExpected < 0) numStillExpected = 0;
 
-    memset(buff, 0, 128 * channels * sizeof(SAMPLETYPE));
     // "Push" the last active samples out from the processing pipeline by
     // feeding blank samples into the processing pipeline until new,
     // processed samples appear in the output (not however, more than
     // 24ksamples in any case)
-    for (i = 0; (numStillExpected > (int)numSamples()) && (i < 200); i ++)
+    for (i = 0; (numStillExpected > (int)numSamples()) && (i < 200 * 128); i += blockSize)
     {
-        putSamples(buff, 128);
+        putSamples(buff, blockSize);
     }
 
     adjustAmountOfSamples(numStillExpected);
 
-    delete[] buff;
-
     // Clear input buffers
-    pTDStretch->clearInput();
+    pStretch->clearInput();
     // yet leave the output intouched as that's where the
     // flushed samples are!
 }
@@ -355,6 +724,26 @@ bool SoundTouch::setSetting(int settingId, int value)
     // read current tdstretch routine parameters
     pTDStretch->getParameters(&sampleRate, &sequenceMs, &seekWindowMs, &overlapMs);
 
+    if (reservedFrames > 0)
+    {
+        switch (settingId)
+        {
+            case SETTING_AA_FILTER_LENGTH :
+            case SETTING_USE_FFT_SEEK :
+            case SETTING_USE_MULTIRES_SEEK :
+            case SETTING_SEQUENCE_MS :
+            case SETTING_SEEKWINDOW_MS :
+            case SETTING_OVERLAP_MS :
+            case SETTING_LOW_LATENCY_MS :
+            case SETTING_VOCODER_FRAME_MS :
+                // these would resize the reserved buffers
+                return false;
+
+            default :
+                break;
+        }
+    }
+
     switch (settingId)
     {
         case SETTING_USE_AA_FILTER :
@@ -372,6 +761,21 @@ bool SoundTouch::setSetting(int settingId, int value)
             pTDStretch->enableQuickSeek((value != 0) ? true : false);
             return true;
 
+        case SETTING_USE_FFT_SEEK :
+            // enables / disables FFT based full seeking in tempo routine
+            pTDStretch->enableFFTSeek((value != 0) ? true : false);
+            return true;
+
+        case SETTING_USE_MULTIRES_SEEK :
+            // enables / disables tempo routine multi-resolution seeking
+            pTDStretch->enableMultiResSeek((value != 0) ? true : false);
+            return true;
+
+        case SETTING_USE_PREDICTIVE_SEEK :
+            // enables / disables tempo routine predictive seeking
+            pTDStretch->enablePredictiveSeek((value != 0) ? true : false);
+            return true;
+
         case SETTING_SEQUENCE_MS:
             // change time-stretch sequence duration parameter
             pTDStretch->setParameters(sampleRate, value, seekWindowMs, overlapMs);
@@ -387,6 +791,57 @@ bool SoundTouch::setSetting(int settingId, int value)
             pTDStretch->setParameters(sampleRate, sequenceMs, seekWindowMs, value);
             return true;
 
+        case SETTING_TEMPO_ENGINE:
+        {
+            // select the tempo changer engine
+            StretchBase *pNewStretch;
+            if (value == TEMPO_ENGINE_WSOLA)
+            {
+                pNewStretch = pTDStretch;
+            }
+            else if (value == TEMPO_ENGINE_PSOLA)
+            {
+                pNewStretch = pPSOLAStretch;
+            }
+            else if (value == TEMPO_ENGINE_PHASE_VOCODER)
+            {
+                pNewStretch = pVocoderStretch;
+            }
+            else
+            {
+                return false;
+            }
+
+            if (pNewStretch != pStretch)
+            {
+                if (output == pStretch)
+                {
+                    output = pNewStretch;
+                }
+                pStretch = pNewStretch;
+                chainStages();
+                clear();
+            }
+            return true;
+        }
+
+        case SETTING_LOW_LATENCY_MS:
+            // change low-latency mode of the tempo changer
+            pTDStretch->setLowLatency(value);
+            return true;
+
+        case SETTING_PARAMETER_RAMP_MS:
+            // change the duration of the control value ramps, for the next change
+            if (value < 0) return false;
+            rampMs = value;
+            return true;
+
+        case SETTING_VOCODER_FRAME_MS:
+            // change the frame length of the phase vocoder
+            if (value <= 0) return false;
+            pVocoderStretch->setFrameMs(value);
+            return true;
+
         default :
             return false;
     }
@@ -412,6 +867,15 @@ int SoundTouch::getSetting(int settingId) const
         case SETTING_USE_QUICKSEEK :
             return (uint)pTDStretch->isQuickSeekEnabled();
 
+        case SETTING_USE_FFT_SEEK :
+            return (uint)pTDStretch->isFFTSeekEnabled();
+
+        case SETTING_USE_MULTIRES_SEEK :
+            return (uint)pTDStretch->isMultiResSeekEnabled();
+
+        case SETTING_USE_PREDICTIVE_SEEK :
+            return (uint)pTDStretch->isPredictiveSeekEnabled();
+
         case SETTING_SEQUENCE_MS:
             pTDStretch->getParameters(nullptr, &temp, nullptr, nullptr);
             return temp;
@@ -426,23 +890,21 @@ int SoundTouch::getSetting(int settingId) const
 
         case SETTING_NOMINAL_INPUT_SEQUENCE :
         {
-            int size = pTDStretch->getInputSampleReq();
+            int size = pStretch->getInputSampleReq();
 
-#ifndef SOUNDTOUCH_PREVENT_CLICK_AT_RATE_CROSSOVER
-            if (rate <= 1.0)
+            if (transposerPosition == TRANSPOSE_BEFORE_TEMPO)
             {
                 // transposing done before timestretch, which impacts latency
                 return (int)(size * rate + 0.5);
             }
-#endif
             return size;
         }
 
         case SETTING_NOMINAL_OUTPUT_SEQUENCE :
         {
-            int size = pTDStretch->getOutputBatchSize();
+            int size = pStretch->getOutputBatchSize();
 
-            if (rate > 1.0)
+            if (transposerPosition == TRANSPOSE_AFTER_TEMPO)
             {
                 // transposing done after timestretch, which impacts latency
                 return (int)(size / rate + 0.5);
@@ -452,24 +914,61 @@ int SoundTouch::getSetting(int settingId) const
 
         case SETTING_INITIAL_LATENCY:
         {
-            double latency = pTDStretch->getLatency();
+            // Each stage's latency is in samples of its own input, and is scaled
+            // to samples of the whole chain's input by the stages before it
+            double latency = pStretch->getLatency();
             int latency_tr = pRateTransposer->getLatency();
 
-#ifndef SOUNDTOUCH_PREVENT_CLICK_AT_RATE_CROSSOVER
-            if (rate <= 1.0)
+            switch (transposerPosition)
             {
-                // transposing done before timestretch, which impacts latency
-                latency = (latency + latency_tr) * rate;
-            }
-            else
-#endif
-            {
-                latency += (double)latency_tr / rate;
+                case TRANSPOSE_BEFORE_TEMPO :
+                    // transposing done before timestretch, which outputs 1/rate
+                    // samples per input sample
+                    latency = latency_tr + latency * rate;
+                    break;
+
+                case TRANSPOSE_AFTER_TEMPO :
+                    // timestretch done before transposing, which outputs 1/tempo
+                    // samples per input sample
+                    latency += latency_tr * tempo;
+                    break;
+
+                default :
+                    // no transposing at rate 1
+                    break;
             }
 
             return (int)(latency + 0.5);
         }
 
+        case SETTING_PREDICTIVE_SEEK_HIT_RATE:
+        {
+            const PredictiveSeekStats &stats = pTDStretch->getPredictiveSeekStats();
+            if (stats.seeks == 0) return 0;
+            return (int)((1000.0 * stats.hits) / stats.seeks + 0.5);
+        }
+
+        case SETTING_PREDICTIVE_SEEK_PROBES:
+        {
+            const PredictiveSeekStats &stats = pTDStretch->getPredictiveSeekStats();
+            if (stats.seeks == 0) return 0;
+            return (int)((double)stats.probes / stats.seeks + 0.5);
+        }
+
+        case SETTING_TEMPO_ENGINE:
+            if (pStretch == pPSOLAStretch) return TEMPO_ENGINE_PSOLA;
+            if (pStretch == pVocoderStretch) return TEMPO_ENGINE_PHASE_VOCODER;
+            return TEMPO_ENGINE_WSOLA;
+
+        case SETTING_LOW_LATENCY_MS:
+            return pTDStretch->getLowLatency();
+
+        case SETTING_PARAMETER_RAMP_MS:
+            return rampMs;
+
+        case SETTING_VOCODER_FRAME_MS:
+            return pVocoderStretch->getFrameMs();
+
         default :
             return 0;
     }
@@ -482,8 +981,9 @@ void SoundTouch::clear()
 {
     samplesExpectedOut = 0;
     samplesOutput = 0;
+    // the transposer's prefill may go to the tempo changer's output, so clear that first
+    pStretch->clear();
     pRateTransposer->clear();
-    pTDStretch->clear();
 }
 
 
@@ -491,9 +991,9 @@ void SoundTouch::clear()
 uint SoundTouch::numUnprocessedSamples() const
 {
     FIFOSamplePipe * psp;
-    if (pTDStretch)
+    if (pStretch)
     {
-        psp = pTDStretch->getInput();
+        psp = pStretch->getInput();
         if (psp)
         {
             return psp->numSamples();
@@ -40,6 +40,7 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <assert.h>
@@ -61,17 +62,31 @@ using namespace soundtouch;
  *****************************************************************************/
 
 
-TDStretch::TDStretch() : FIFOProcessor(&outputBuffer)
+TDStretch::TDStretch() : StretchBase(&outputBuffer)
 {
     bQuickSeek = false;
+    bFFTSeek = false;
+    bMultiResSeek = false;
+    bReserved = false;
+    bPredictiveSeek = false;
     channels = 2;
 
     pMidBuffer = nullptr;
     pMidBufferUnaligned = nullptr;
+    pSeekRef = nullptr;
+    pSeekMid = nullptr;
+
+    decimatedBuffer.setChannels(1);
+    decimChannels = 0;
+    decimStart = 0;
+    pDecimatedMid = nullptr;
+    decimatedMidSize = 0;
+    memset(&predictStats, 0, sizeof(predictStats));
     overlapLength = 0;
 
     bAutoSeqSetting = true;
     bAutoSeekSetting = true;
+    lookaheadMs = 0;
 
     tempo = 1.0f;
     setParameters(44100, DEFAULT_SEQUENCE_MS, DEFAULT_SEEKWINDOW_MS, DEFAULT_OVERLAP_MS);
@@ -85,6 +100,9 @@ TDStretch::TDStretch() : FIFOProcessor(&outputBuffer)
 TDStretch::~TDStretch()
 {
     delete[] pMidBufferUnaligned;
+    delete[] pSeekRef;
+    delete[] pSeekMid;
+    delete[] pDecimatedMid;
 }
 
 
@@ -197,8 +215,13 @@ void TDStretch::clearMidBuffer()
 void TDStretch::clearInput()
 {
     inputBuffer.clear();
+    decimatedBuffer.clear();
+    decimStart = 0;
+    bSeekContinuation = false;
+    seekPeriod = 0;
     clearMidBuffer();
     isBeginning = true;
+    inSequence = false;
     maxnorm = 0;
     maxnormf = 1e8;
     skipFract = 0;
@@ -229,13 +252,140 @@ bool TDStretch::isQuickSeekEnabled() const
 }
 
 
+// Enables/disables the FFT based full position seeking
+void TDStretch::enableFFTSeek(bool enable)
+{
+    bFFTSeek = enable;
+    prepareFFTSeek();
+}
+
+
+// Returns nonzero if the FFT based seeking is enabled.
+bool TDStretch::isFFTSeekEnabled() const
+{
+    return bFFTSeek;
+}
+
+
+// Enables/disables the multi-resolution position seeking
+void TDStretch::enableMultiResSeek(bool enable)
+{
+    bMultiResSeek = enable;
+    decimChannels = 0;    // rebuild the decimated input
+    prepareMultiResSeek();
+}
+
+
+// Returns nonzero if the multi-resolution seeking is enabled.
+bool TDStretch::isMultiResSeekEnabled() const
+{
+    return bMultiResSeek;
+}
+
+
+// Enables/disables the predictive position seeking
+void TDStretch::enablePredictiveSeek(bool enable)
+{
+    if (enable && !bPredictiveSeek)
+    {
+        memset(&predictStats, 0, sizeof(predictStats));
+        bSeekContinuation = false;
+        seekPeriod = 0;
+    }
+    bPredictiveSeek = enable;
+}
+
+
+// Returns nonzero if the predictive seeking is enabled.
+bool TDStretch::isPredictiveSeekEnabled() const
+{
+    return bPredictiveSeek;
+}
+
+
+// Sets the low-latency mode with the lookahead bound in milliseconds, zero to disable
+void TDStretch::setLowLatency(int newLookaheadMs)
+{
+    lookaheadMs = (newLookaheadMs > 0) ? newLookaheadMs : 0;
+
+    // recalculate the seek window & 'sampleReq'
+    setTempo(tempo);
+}
+
+
+// Returns the low-latency mode lookahead bound in milliseconds, zero if off
+int TDStretch::getLowLatency() const
+{
+    return lookaheadMs;
+}
+
+
+// Presizes the buffers for processing up to 'maxInput' samples at a time with the
+// tempo between 'minTempo' and 'maxTempo'. Returns the most samples output at a time.
+uint TDStretch::reserve(uint maxInput, double minTempo, double maxTempo)
+{
+    if (maxInput == 0)
+    {
+        bReserved = false;
+        inputBuffer.reserve(0);
+        decimatedBuffer.reserve(0);
+        return 0;
+    }
+
+    // The automatic sequence & seek window lengths are each monotonic in tempo, so
+    // their longest in the range are at its ends. Setting those tempos also sizes
+    // the FFT & multi-resolution seek buffers, which then stay at the larger size.
+    const double curTempo = tempo;
+    int window, seek;
+
+    bReserved = true;
+    setTempo(minTempo);
+    window = seekWindowLength;
+    seek = seekLength;
+    setTempo(maxTempo);
+    window = max(window, seekWindowLength);
+    seek = max(seek, seekLength);
+    setTempo(curTempo);
+
+    // The input left over between the calls stays below 'sampleReq', and each
+    // sequence outputs a window less overlap per 'tempo' times as much input. The
+    // input left over at a fast tempo may be output at a slow one.
+    const int hold = max((int)(maxTempo * (window - overlapLength) + 1.0) + overlapLength, window) + seek;
+    inputBuffer.reserve((uint)hold + maxInput);
+    decimatedBuffer.reserve(((uint)hold + maxInput) / MULTIRES_DECIMATION + 1);
+
+    return (uint)((hold + maxInput) / minTempo) + (uint)window;
+}
+
+
 // Seeks for the optimal overlap-mixing position.
 int TDStretch::seekBestOverlapPosition(const SAMPLETYPE *refPos)
 {
-    if (bQuickSeek)
+    if (bPredictiveSeek)
+    {
+        return seekBestOverlapPositionPredictive(refPos);
+    }
+    return seekBestOverlapPositionWide(refPos);
+}
+
+
+// Seeks for the optimal overlap-mixing position over the whole seek window.
+int TDStretch::seekBestOverlapPositionWide(const SAMPLETYPE *refPos)
+{
+    if (bMultiResSeek)
+    {
+        return seekBestOverlapPositionMultiRes(refPos);
+    }
+    else if (bQuickSeek)
     {
         return seekBestOverlapPositionQuick(refPos);
     }
+#ifdef SOUNDTOUCH_FLOAT_SAMPLES
+    else if (bFFTSeek)
+    {
+        return seekBestOverlapPositionFFT(refPos);
+    }
+#endif
     else
     {
         return seekBestOverlapPositionFull(refPos);
@@ -334,6 +484,376 @@ int TDStretch::seekBestOverlapPositionFull(const SAMPLETYPE *refPos)
 }
 
 
+// Sizes the FFT & its buffers for the current seek & overlap lengths. The correlation
+// is linear rather than circular as long as the transform holds the whole seek range
+// plus one overlap, so no zero padding beyond that is needed. Buffers only grow, so
+// this allocates only when the parameters change to larger values.
+void TDStretch::prepareFFTSeek()
+{
+    if (!bFFTSeek) return;
+
+    int length = RealFFT::lengthFor(channels * (seekLength - 1 + overlapLength));
+    if (length == seekFFT.getLength()) return;
+
+    // keep the reserved transform when the seek range shrinks; the zero padding
+    // beyond the range doesn't change the correlation
+    if (bReserved && (length < seekFFT.getLength())) return;
+
+    if (length > seekFFT.getLength())
+    {
+        delete[] pSeekRef;
+        delete[] pSeekMid;
+        pSeekRef = new float[length];
+        pSeekMid = new float[length];
+    }
+    seekFFT.setLength(length);
+}
+
+
+// Seeks for the optimal overlap-mixing position with the same criterion as the full
+// seek, but calculates the cross-correlation of all offsets at once as the inverse
+// transform of X(k) Y*(k). The normalizing energy of each offset is updated as a
+// sliding window instead of being recalculated.
+//
+// Cost is three FFTs of the seek range, O(N log N), instead of the
+// O(seekLength * overlapLength) of the full seek.
+int TDStretch::seekBestOverlapPositionFFT(const SAMPLETYPE *refPos)
+{
+    int i;
+
+    prepareFFTSeek();
+
+    const int fftLength = seekFFT.getLength();
+    const int ovlSamples = channels * overlapLength;
+    const int refSamples = channels * (seekLength - 1) + ovlSamples;
+
+    for (i = 0; i < refSamples; i ++)
+    {
+        pSeekRef[i] = (float)refPos[i];
+    }
+    memset(pSeekRef + refSamples, 0, (fftLength - refSamples) * sizeof(float));
+
+    for (i = 0; i < ovlSamples; i ++)
+    {
+        pSeekMid[i] = (float)pMidBuffer[i];
+    }
+    memset(pSeekMid + ovlSamples, 0, (fftLength - ovlSamples) * sizeof(float));
+
+    seekFFT.forward(pSeekRef);
+    seekFFT.forward(pSeekMid);
+    seekFFT.multiplyConjugate(pSeekRef, pSeekMid);
+    seekFFT.inverse(pSeekRef);
+    // pSeekRef[channels * i] is now the correlation at offset 'i'
+
+    double norm = 0;
+    for (i = 0; i < ovlSamples; i ++)
+    {
+        norm += (double)refPos[i] * (double)refPos[i];
+    }
+
+    double bestCorr = pSeekRef[0] / sqrt((norm < 1e-9) ? 1.0 : norm);
+    bestCorr = (bestCorr + 0.1) * 0.75;
+    int bestOffs = 0;
+
+    for (i = 1; i < seekLength; i ++)
+    {
+        // slide the energy window by one sample frame
+        const SAMPLETYPE *leaving = refPos + channels * (i - 1);
+        for (int c = 0; c < channels; c ++)
+        {
+            norm -= (double)leaving[c] * (double)leaving[c];
+            norm += (double)leaving[ovlSamples + c] * (double)leaving[ovlSamples + c];
+        }
+
+        double corr = pSeekRef[channels * i] / sqrt((norm < 1e-9) ? 1.0 : norm);
+
+        // heuristic rule to slightly favour values close to mid of the range
+        double tmp = (double)(2 * i - seekLength) / (double)seekLength;
+        corr = ((corr + 0.1) * (1.0 - 0.25 * tmp * tmp));
+
+        if (corr > bestCorr)
+        {
+            bestCorr = corr;
+            bestOffs = i;
+        }
+    }
+
+    return bestOffs;
+}
+
+
+// Sizes the buffers of the multi-resolution seek, and restarts the decimated
+// input when the channel count changes.
+void TDStretch::prepareMultiResSeek()
+{
+    if (!bMultiResSeek) return;
+
+    if (channels != decimChannels)
+    {
+        decimChannels = channels;
+        decimatedBuffer.clear();
+        decimStart = 0;
+        updateDecimated();
+    }
+
+    // mid-buffer at 4x & 8x decimation, plus the 8x reference
+    int size = overlapLength / MULTIRES_DECIMATION + overlapLength / (2 * MULTIRES_DECIMATION) +
+               (seekLength + overlapLength) / (2 * MULTIRES_DECIMATION) + 2;
+    if (size > decimatedMidSize)
+    {
+        delete[] pDecimatedMid;
+        pDecimatedMid = new float[size];
+        decimatedMidSize = size;
+    }
+}
+
+
+// Appends the averages of the complete MULTIRES_DECIMATION frame blocks of
+// 'inputBuffer' that aren't yet in 'decimatedBuffer'. Called as input arrives,
+// so each input frame is decimated once.
+void TDStretch::updateDecimated()
+{
+    const int available = (int)inputBuffer.numSamples();
+    int next = decimStart + MULTIRES_DECIMATION * (int)decimatedBuffer.numSamples();
+
+    if (available < next)
+    {
+        // input was taken out through getInput(); start over from what's left
+        decimatedBuffer.clear();
+        decimStart = 0;
+        next = 0;
+    }
+
+    const int blocks = (available - next) / MULTIRES_DECIMATION;
+    if (blocks <= 0) return;
+
+    const int blockSamples = channels * MULTIRES_DECIMATION;
+    const float scale = 1.0f / (float)blockSamples;
+    const SAMPLETYPE *src = inputBuffer.ptrBegin() + channels * next;
+    SAMPLETYPE *dest = decimatedBuffer.ptrEnd((uint)blocks);
+
+    for (int b = 0; b < blocks; b ++)
+    {
+        float sum = 0;
+        for (int i = 0; i < blockSamples; i ++)
+        {
+            sum += (float)src[i];
+        }
+        dest[b] = (SAMPLETYPE)(sum * scale);
+        src += blockSamples;
+    }
+    decimatedBuffer.putSamples((uint)blocks);
+}
+
+
+// Follows 'frames' frames being removed from the beginning of 'inputBuffer'. Blocks
+// that begin before the new beginning are dropped, partial ones included.
+void TDStretch::skipDecimated(int frames)
+{
+    decimStart -= frames;
+    if (decimStart < 0)
+    {
+        int drop = (MULTIRES_DECIMATION - 1 - decimStart) / MULTIRES_DECIMATION;
+        decimStart += drop * MULTIRES_DECIMATION;
+        decimatedBuffer.receiveSamples((uint)drop);
+    }
+}
+
+
+// Normalized correlation of two decimated sequences
+template <class T>
+static double decimatedCorr(const T *ref, const float *mid, int length)
+{
+    float corr = 0;
+    float norm = 0;
+    for (int i = 0; i < length; i ++)
+    {
+        corr += (float)ref[i] * mid[i];
+        norm += (float)ref[i] * (float)ref[i];
+    }
+    return corr / sqrt((norm < 1e-9) ? 1.0 : norm);
+}
+
+
+// Correlation value with the heuristic rule to slightly favour offsets close to
+// mid of the seek range
+static double multiResScore(double corr, int offs, int seekLength)
+{
+    double tmp = (double)(2 * offs - seekLength) / (double)seekLength;
+    return (corr + 0.1) * (1.0 - 0.25 * tmp * tmp);
+}
+
+
+// Keeps the 'count' best values & their offsets in descending order
+static void keepBest(double value, int offs, double *values, int *offsets, int count)
+{
+    int i = count - 1;
+    if (value <= values[i]) return;
+
+    while ((i > 0) && (value > values[i - 1]))
+    {
+        values[i] = values[i - 1];
+        offsets[i] = offsets[i - 1];
+        i --;
+    }
+    values[i] = value;
+    offsets[i] = offs;
+}
+
+
+// Multi-resolution seek, coarse to fine:
+// - 8x decimated: every offset in steps of 8 frames, keeping the three best
+// - 4x decimated: the three candidates & their 4 frame neighbours, keeping two
+// - full resolution: 3 frames to both sides of the two, with calcCrossCorr
+// Short overlaps (< 128 frames) begin from the 4x level instead.
+//
+// The 4x decimated input is kept up to date as input arrives; the 8x level is made
+// from it. With a 5 ms overlap & 10 ms seek window at 48 kHz this is ~1/4 of the
+// multiply-adds of the quick seek, while every offset is examined at the coarse
+// level instead of every 16th.
+int TDStretch::seekBestOverlapPositionMultiRes(const SAMPLETYPE *refPos)
+{
+    int i, k;
+    double norm;
+    double values[3];
+    int offsets[3];
+
+    // catches up with input that was added while the seek was disabled
+    updateDecimated();
+
+    const int ovl4 = overlapLength / MULTIRES_DECIMATION;
+    const int count4 = (seekLength - 1 - decimStart) / MULTIRES_DECIMATION + 1;
+
+    if ((int)decimatedBuffer.numSamples() < count4 - 1 + ovl4)
+    {
+        // not enough decimated input, shouldn't happen
+        return seekBestOverlapPositionQuick(refPos);
+    }
+
+    // Decimate the mid-buffer in blocks aligned to its beginning
+    const int blockSamples = channels * MULTIRES_DECIMATION;
+    const float scale = 1.0f / (float)blockSamples;
+    float *mid4 = pDecimatedMid;
+    const SAMPLETYPE *mid = pMidBuffer;
+    for (k = 0; k < ovl4; k ++)
+    {
+        float sum = 0;
+        for (i = 0; i < blockSamples; i ++)
+        {
+            sum += (float)mid[i];
+        }
+        mid4[k] = sum * scale;
+        mid += blockSamples;
+    }
+
+    const SAMPLETYPE *ref4 = decimatedBuffer.ptrBegin();
+    values[0] = values[1] = values[2] = -FLT_MAX;
+    offsets[0] = offsets[1] = offsets[2] = 0;
+
+    if (ovl4 >= 32)
+    {
+        // 8x level from pairs of 4x blocks, over the even 4x offsets
+        const int ovl8 = ovl4 / 2;
+        const int count8 = count4 / 2;
+        float *mid8 = mid4 + ovl4;
+        float *ref8 = mid8 + ovl8;
+
+        for (k = 0; k < ovl8; k ++)
+        {
+            mid8[k] = 0.5f * (mid4[2 * k] + mid4[2 * k + 1]);
+        }
+        for (k = 0; k < count8 - 1 + ovl8; k ++)
+        {
+            ref8[k] = 0.5f * ((float)ref4[2 * k] + (float)ref4[2 * k + 1]);
+        }
+
+        for (k = 0; k < count8; k ++)
+        {
+            double corr = decimatedCorr(ref8 + k, mid8, ovl8);
+            keepBest(multiResScore(corr, decimStart + 2 * MULTIRES_DECIMATION * k, seekLength),
+                     2 * k, values, offsets, 3);
+        }
+
+        // 4x level around the three candidates
+        int cand[3] = { offsets[0], offsets[1], offsets[2] };
+        values[0] = values[1] = values[2] = -FLT_MAX;
+        offsets[0] = offsets[1] = offsets[2] = -1;
+        for (int c = 0; c < 3; c ++)
+        {
+            for (int m = cand[c] - 1; m <= cand[c] + 1; m ++)
+            {
+                if ((m < 0) || (m >= count4)) continue;
+                if ((m == offsets[0]) || (m == offsets[1])) continue;   // evaluated already
+
+                double corr = decimatedCorr(ref4 + m, mid4, ovl4);
+                keepBest(multiResScore(corr, decimStart + MULTIRES_DECIMATION * m, seekLength),
+                         m, values, offsets, 2);
+            }
+        }
+    }
+    else
+    {
+        // 4x level over all offsets
+        for (k = 0; k < count4; k ++)
+        {
+            double corr = decimatedCorr(ref4 + k, mid4, ovl4);
+            keepBest(multiResScore(corr, decimStart + MULTIRES_DECIMATION * k, seekLength),
+                     k, values, offsets, 2);
+        }
+    }
+
+    // Full resolution around the two best. The ranges are merged when they overlap
+    // so that no offset is evaluated twice.
+    const int reach = MULTIRES_DECIMATION - 1;
+    int lo1 = decimStart + MULTIRES_DECIMATION * offsets[0] - reach;
+    int hi1 = decimStart + MULTIRES_DECIMATION * offsets[0] + reach;
+    int lo2 = decimStart + MULTIRES_DECIMATION * offsets[1] - reach;
+    int hi2 = decimStart + MULTIRES_DECIMATION * offsets[1] + reach;
+    if (lo2 < lo1)
+    {
+        int t;
+        t = lo1; lo1 = lo2; lo2 = t;
+        t = hi1; hi1 = hi2; hi2 = t;
+    }
+    if (lo2 <= hi1 + 1)
+    {
+        if (hi2 > hi1) hi1 = hi2;
+        lo2 = 1;
+        hi2 = 0;    // empty
+    }
+
+    double bestCorr = -FLT_MAX;
+    int bestOffs = 0;
+    for (int range = 0; range < 2; range ++)
+    {
+        int lo = (range == 0) ? lo1 : lo2;
+        int hi = (range == 0) ? hi1 : hi2;
+        if (lo < 0) lo = 0;
+        if (hi > seekLength - 1) hi = seekLength - 1;
+
+        for (i = lo; i <= hi; i ++)
+        {
+            double corr = multiResScore(calcCrossCorr(refPos + channels * i, pMidBuffer, norm),
+                                        i, seekLength);
+            if (corr > bestCorr)
+            {
+                bestCorr = corr;
+                bestOffs = i;
+            }
+        }
+    }
+
+    // clear cross correlation routine state if necessary (is so e.g. in MMX routines).
+    clearCrossCorrState();
+
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+    adaptNormalizer();
+#endif
+
+    return bestOffs;
+}
+
+
 // Quick seek algorithm for improved runtime-performance: First roughly scans through the
 // correlation area, and then scan surroundings of two best preliminary correlation candidates
 // with improved precision
@@ -456,6 +976,169 @@ int TDStretch::seekBestOverlapPositionQuick(const SAMPLETYPE *refPos)
 
 
 
+// Energy of the 'midBuffer' samples over the length that 'calcCrossCorr' correlates,
+// on the same scale as the 'norm' it returns, so that dividing the correlation by the
+// root of this gives the normalized cross-correlation.
+double TDStretch::calcMidEnergy() const
+{
+    const int ilength = (channels * overlapLength) & -8;
+    double energy = 0;
+
+    for (int i = 0; i < ilength; i ++)
+    {
+        energy += (double)pMidBuffer[i] * (double)pMidBuffer[i];
+    }
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+    energy /= (double)(1 << overlapDividerBitsNorm);
+#endif
+    return energy;
+}
+
+
+// Predictive seek. For periodic input such as voiced speech, the best offset keeps
+// the waveform continuing in phase from the end of the previous sequence, i.e. lies
+// a whole number of pitch periods from 'seekContinuation'. Probes a narrow window
+// around the in-phase offset closest to the middle of the seek range, and does the
+// normal search over the whole window only if the probe finds no offset with a
+// normalized correlation above PREDICTIVE_SEEK_THRESHOLD inside the window.
+//
+// The pitch period is learned from the wide searches, see 'learnSeekPeriod', and
+// tracked by the probes around offsets that are whole periods away from the
+// continuation.
+int TDStretch::seekBestOverlapPositionPredictive(const SAMPLETYPE *refPos)
+{
+    const int minPeriod = sampleRate / 500;
+    const int maxPeriod = sampleRate / 50;
+    const double energy = calcMidEnergy();
+    int i;
+
+    predictStats.seeks ++;
+
+    if (bSeekContinuation && (energy > 1e-9))
+    {
+        // Whole periods from the continuation to the middle of the seek range
+        int periods = 0;
+        int predicted = seekContinuation;
+        if (seekPeriod > 0)
+        {
+            periods = (int)floor((seekLength / 2 - seekContinuation) / seekPeriod + 0.5);
+            predicted += (int)floor(periods * seekPeriod + 0.5);
+        }
+
+        const int radius = (int)(sampleRate * PREDICTIVE_SEEK_RADIUS_MS / 1000.0) + 1;
+        const int start = max(predicted - radius, 0);
+        const int end = (predicted + radius + 1 < seekLength) ? predicted + radius + 1 : seekLength;
+
+        if (start < end)
+        {
+            double bestScore = -FLT_MAX;
+            double bestCorr = 0;
+            double norm;
+            int bestOffs = start;
+
+            for (i = start; i < end; i ++)
+            {
+                double corr;
+#if defined(ST_SIMD_AVOID_UNALIGNED)
+                corr = calcCrossCorr(refPos + channels * i, pMidBuffer, norm);
+#else
+                if (i == start)
+                {
+                    corr = calcCrossCorr(refPos + channels * i, pMidBuffer, norm);
+                }
+                else
+                {
+                    corr = calcCrossCorrAccumulate(refPos + channels * i, pMidBuffer, norm);
+                }
+#endif
+                // same heuristic rule as the full seek to favour the middle of the range
+                double tmp = (double)(2 * i - seekLength) / (double)seekLength;
+                double score = (corr + 0.1) * (1.0 - 0.25 * tmp * tmp);
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestCorr = corr;
+                    bestOffs = i;
+                }
+            }
+            predictStats.probes += end - start;
+
+            clearCrossCorrState();
+
+            // Accept if confident, and not on a probe window edge inside the seek
+            // range, where the correlation may still be rising further out
+            bool onEdge = ((bestOffs == predicted - radius) && (bestOffs > 0)) ||
+                          ((bestOffs == predicted + radius) && (bestOffs < seekLength - 1));
+            if (!onEdge && (bestCorr / sqrt(energy) >= PREDICTIVE_SEEK_THRESHOLD))
+            {
+                if (periods != 0)
+                {
+                    // track the pitch period
+                    double period = fabs((double)(bestOffs - seekContinuation) / periods);
+                    if ((period >= minPeriod) && (period <= maxPeriod))
+                    {
+                        seekPeriod = period;
+                    }
+                }
+                predictStats.hits ++;
+
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+                adaptNormalizer();
+#endif
+                return bestOffs;
+            }
+        }
+    }
+
+    int bestOffs = seekBestOverlapPositionWide(refPos);
+
+    if (bSeekContinuation && (energy > 1e-9))
+    {
+        learnSeekPeriod(refPos, bestOffs, energy);
+    }
+
+    return bestOffs;
+}
+
+
+// Estimates the pitch period after a wide search. If the offset found is a good
+// match, its distance from the continuation offset is a whole number of periods,
+// and the period is the shortest such fraction of the distance at which the
+// signal correlates with the reference as well.
+void TDStretch::learnSeekPeriod(const SAMPLETYPE *refPos, int bestOffs, double energy)
+{
+    const int minPeriod = sampleRate / 500;
+    const int maxPeriod = sampleRate / 50;
+    const double minCorr = PREDICTIVE_SEEK_THRESHOLD * sqrt(energy);
+    const int distance = abs(bestOffs - seekContinuation);
+    double norm;
+
+    if ((distance < minPeriod) ||
+        (calcCrossCorr(refPos + channels * bestOffs, pMidBuffer, norm) < minCorr))
+    {
+        clearCrossCorrState();
+        return;
+    }
+
+    for (int periods = distance / minPeriod; periods >= 1; periods --)
+    {
+        const double period = (double)distance / periods;
+        if (period > maxPeriod) break;
+
+        // check one period further in the direction that stays inside the seek range
+        const int step = (int)(period + 0.5);
+        const int check = (bestOffs + step < seekLength) ? bestOffs + step : bestOffs - step;
+        if ((check >= 0) &&
+            (calcCrossCorr(refPos + channels * check, pMidBuffer, norm) >= minCorr))
+        {
+            seekPeriod = period;
+            break;
+        }
+    }
+    clearCrossCorrState();
+}
+
+
 /// For integer algorithm: adapt normalization factor divider with music so that
 /// it'll not be pessimistically restrictive that can degrade quality on quieter sections
 /// yet won't cause integer overflows either
@@ -537,6 +1220,16 @@ void TDStretch::calcSeqParameters()
         seekWindowLength = 2 * overlapLength;
     }
     seekLength = (sampleRate * seekWindowMs) / 1000;
+
+    if (lookaheadMs > 0)
+    {
+        // low-latency mode: fit the seek window & overlap within the lookahead
+        int bound = (sampleRate * lookaheadMs) / 1000 - overlapLength;
+        if (seekLength > bound)
+        {
+            seekLength = max(bound, 1);
+        }
+    }
 }
 
 
@@ -560,6 +1253,9 @@ void TDStretch::setTempo(double newTempo)
     // process another batch of samples
     //sampleReq = max(intskip + overlapLength, seekWindowLength) + seekLength / 2;
     sampleReq = max(intskip + overlapLength, seekWindowLength) + seekLength;
+
+    prepareFFTSeek();
+    prepareMultiResSeek();
 }
 
 
@@ -633,9 +1329,19 @@ void TDStretch::processSamples()
 
     // Process samples as long as there are enough samples in 'inputBuffer'
     // to form a processing frame.
-    while ((int)inputBuffer.numSamples() >= sampleReq)
+    for (;;)
     {
-        if (isBeginning == false)
+        if (inSequence)
+        {
+            // continue the sequence begun earlier
+        }
+        else if ((int)inputBuffer.numSamples() < ((lookaheadMs > 0) ? seekLength + overlapLength : sampleReq))
+        {
+            // The low-latency mode begins a sequence as soon as the seek window
+            // is in, otherwise the whole sequence & skip are waited for
+            break;
+        }
+        else if (isBeginning == false)
         {
             // apart from the very beginning of the track,
             // scan for the best overlapping position & do overlap-add
@@ -648,6 +1354,10 @@ void TDStretch::processSamples()
             overlap(outputBuffer.ptrEnd((uint)overlapLength), inputBuffer.ptrBegin(), (uint)offset);
             outputBuffer.putSamples((uint)overlapLength);
             offset += overlapLength;
+
+            inSequence = true;
+            seqPos = offset;
+            seqRemaining = seekWindowLength - 2 * overlapLength;
         }
         else
         {
@@ -672,25 +1382,35 @@ void TDStretch::processSamples()
             {
                 skipFract = -nominalSkip;
             }
-        }
 
-        // ... then copy sequence samples from 'inputBuffer' to output:
+            inSequence = true;
+            seqPos = 0;
+            seqRemaining = seekWindowLength - 2 * overlapLength;
+        }
 
-        // crosscheck that we don't have buffer overflow...
-        if ((int)inputBuffer.numSamples() < (offset + seekWindowLength - overlapLength))
+        // ... then copy sequence samples from 'inputBuffer' to output, as far as
+        // the input reaches
+        temp = _MIN(seqRemaining, (int)inputBuffer.numSamples() - seqPos);
+        if (temp > 0)
         {
-            continue;    // just in case, shouldn't really happen
+            outputBuffer.putSamples(inputBuffer.ptrBegin() + channels * seqPos, (uint)temp);
+            seqPos += temp;
+            seqRemaining -= temp;
         }
 
-        // length of sequence
-        temp = (seekWindowLength - 2 * overlapLength);
-        outputBuffer.putSamples(inputBuffer.ptrBegin() + channels * offset, (uint)temp);
+        // The end of the sequence & the skip to the next one must be in the input
+        // before the next sequence can begin
+        ovlSkip = (int)(skipFract + nominalSkip);
+        if ((seqRemaining > 0) ||
+            ((int)inputBuffer.numSamples() < max(seqPos + overlapLength, ovlSkip)))
+        {
+            break;
+        }
 
         // Copies the end of the current sequence from 'inputBuffer' to
         // 'midBuffer' for being mixed with the beginning of the next
         // processing sequence and so on
-        assert((offset + temp + overlapLength) <= (int)inputBuffer.numSamples());
-        memcpy(pMidBuffer, inputBuffer.ptrBegin() + channels * (offset + temp),
+        memcpy(pMidBuffer, inputBuffer.ptrBegin() + channels * seqPos,
             channels * sizeof(SAMPLETYPE) * overlapLength);
 
         // Remove the processed samples from the input buffer. Update
@@ -700,6 +1420,15 @@ void TDStretch::processSamples()
         ovlSkip = (int)skipFract;   // rounded to integer skip
         skipFract -= ovlSkip;       // maintain the fraction part, i.e. real vs. integer skip
         inputBuffer.receiveSamples((uint)ovlSkip);
+        if (bMultiResSeek)
+        {
+            skipDecimated(ovlSkip);
+        }
+
+        // The input that continues 'midBuffer' begins at this offset of the next seek
+        seekContinuation = seqPos - ovlSkip;
+        bSeekContinuation = true;
+        inSequence = false;
     }
 }
 
@@ -710,6 +1439,17 @@ void TDStretch::putSamples(const SAMPLETYPE *samples, uint nSamples)
 {
     // Add the samples into the input buffer
     inputBuffer.putSamples(samples, nSamples);
+    processInput();
+}
+
+
+// Processes the samples added directly to the input buffer
+void TDStretch::processInput()
+{
+    if (bMultiResSeek)
+    {
+        updateDecimated();
+    }
     // Process the samples in input buffer
     processSamples();
 }
@@ -755,7 +1495,7 @@ TDStretch * TDStretch::newInstance()
     uExtensions = detectCPUextensions();
     (void)uExtensions;
 
-    // Check if MMX/SSE instruction set extensions supported by CPU
+    // Check which instruction set extensions are supported by CPU, widest first
 
 #ifdef SOUNDTOUCH_ALLOW_MMX
     // MMX routines available only with integer sample types
@@ -767,6 +1507,24 @@ TDStretch * TDStretch::newInstance()
 #endif // SOUNDTOUCH_ALLOW_MMX
 
 
+#if defined(SOUNDTOUCH_ALLOW_AVX512) && defined(SOUNDTOUCH_ALLOW_AVX2) && defined(SOUNDTOUCH_ALLOW_SSE)
+    if (uExtensions & SUPPORT_AVX512)
+    {
+        // AVX-512 support, implies AVX2 and FMA
+        return ::new TDStretchAVX512;
+    }
+    else
+#endif // SOUNDTOUCH_ALLOW_AVX512
+
+#if defined(SOUNDTOUCH_ALLOW_AVX2) && defined(SOUNDTOUCH_ALLOW_SSE)
+    if ((uExtensions & (SUPPORT_AVX2 | SUPPORT_FMA)) == (SUPPORT_AVX2 | SUPPORT_FMA))
+    {
+        // AVX2 and FMA support
+        return ::new TDStretchAVX2;
+    }
+    else
+#endif // SOUNDTOUCH_ALLOW_AVX2
+
 #ifdef SOUNDTOUCH_ALLOW_SSE
     if (uExtensions & SUPPORT_SSE)
     {
@@ -776,6 +1534,15 @@ TDStretch * TDStretch::newInstance()
     else
 #endif // SOUNDTOUCH_ALLOW_SSE
 
+#ifdef SOUNDTOUCH_ALLOW_NEON
+    if (uExtensions & SUPPORT_NEON)
+    {
+        // NEON support
+        return ::new TDStretchNEON;
+    }
+    else
+#endif // SOUNDTOUCH_ALLOW_NEON
+
     {
         // ISA optimizations not supported, use plain C version
         return ::new TDStretch;
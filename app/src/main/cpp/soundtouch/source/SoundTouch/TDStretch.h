@@ -41,6 +41,7 @@
 #include "STTypes.h"
 #include "RateTransposer.h"
 #include "FIFOSamplePipe.h"
+#include "RealFFT.h"
 
 namespace soundtouch
 {
@@ -97,10 +98,84 @@ namespace soundtouch
 /// Increasing this value increases computational burden & vice versa.
 #define DEFAULT_OVERLAP_MS      8
 
+/// Decimation of the finest coarse level of the multi-resolution overlap seek.
+/// The level above it is decimated twice as much.
+#define MULTIRES_DECIMATION     4
+
+/// Half-width of the window probed around the predicted offset by the predictive
+/// overlap seek, in milliseconds.
+#define PREDICTIVE_SEEK_RADIUS_MS   0.5
+
+/// Normalized cross-correlation the best offset of the predictive probe has to
+/// reach to be accepted without a search over the whole seek window.
+#define PREDICTIVE_SEEK_THRESHOLD   0.8
+
+/// Counters of the predictive position seeking
+struct PredictiveSeekStats
+{
+    /// Seeks done with the predictive seeking enabled
+    unsigned long seeks;
+
+    /// Seeks resolved by the probe around the predicted offset, the rest
+    /// fell back to the search over the whole seek window
+    unsigned long hits;
+
+    /// Offsets correlated by the probes around the predicted offsets
+    unsigned long probes;
+};
+
+
+/// Abstract base class of the tempo changer engines, i.e. the interface through
+/// which 'SoundTouch' drives whichever engine is selected.
+class StretchBase : public FIFOProcessor
+{
+protected:
+    StretchBase(FIFOSamplePipe *pOutput) : FIFOProcessor(pOutput)
+    {
+    }
+
+public:
+    /// Returns the output buffer object
+    virtual FIFOSampleBuffer *getOutput() = 0;
+
+    /// Returns the input buffer object
+    virtual FIFOSampleBuffer *getInput() = 0;
+
+    /// Processes the samples added directly to the buffer returned by getInput(),
+    /// e.g. by the previous stage of a pipeline writing its output there
+    virtual void processInput() = 0;
+
+    /// Sets new target tempo. Normal tempo = 1.0, smaller values represent slower
+    /// tempo, larger faster tempo.
+    virtual void setTempo(double newTempo) = 0;
+
+    /// Sets the number of channels, 1 = mono, 2 = stereo
+    virtual void setChannels(int numChannels) = 0;
+
+    /// Clears the input buffer
+    virtual void clearInput() = 0;
+
+    /// return nominal input sample requirement for triggering a processing batch
+    virtual int getInputSampleReq() const = 0;
+
+    /// return nominal output sample amount when running a processing batch
+    virtual int getOutputBatchSize() const = 0;
+
+    /// return approximate initial input-output latency
+    virtual int getLatency() const = 0;
+
+    /// Presizes the input & work buffers for processing up to 'maxInput' samples at
+    /// a time with the tempo between 'minTempo' and 'maxTempo', and fixes their
+    /// capacity so that the processing & tempo changes don't allocate memory. Zero
+    /// 'maxInput' releases the fix. Returns the most samples that such processing
+    /// outputs at a time, for presizing the output buffer.
+    virtual uint reserve(uint maxInput, double minTempo, double maxTempo) = 0;
+};
+
 
 /// Class that does the time-stretch (tempo change) effect for the processed
 /// sound.
-class TDStretch : public FIFOProcessor
+class TDStretch : public StretchBase
 {
 protected:
     int channels;
@@ -117,6 +192,10 @@ protected:
     int seekWindowMs;
     int overlapMs;
 
+    /// Low-latency mode: bound of the seek window plus overlap in milliseconds,
+    /// zero if the mode is off
+    int lookaheadMs;
+
     unsigned long maxnorm;
     float maxnormf;
 
@@ -125,16 +204,54 @@ protected:
     double skipFract;
 
     bool bQuickSeek;
+    bool bFFTSeek;
+    bool bMultiResSeek;
+    bool bPredictiveSeek;
     bool bAutoSeqSetting;
     bool bAutoSeekSetting;
     bool isBeginning;
 
+    /// Set while the buffers are reserved, so that they're kept at the size
+    /// reserved instead of being shrunk
+    bool bReserved;
+
+    /// Set while a sequence has been begun but not all of it output. 'seqPos' is
+    /// the position in 'inputBuffer' of the next sequence sample to output and
+    /// 'seqRemaining' the count of those still to output.
+    bool inSequence;
+    int seqPos;
+    int seqRemaining;
+
     SAMPLETYPE *pMidBuffer;
     SAMPLETYPE *pMidBufferUnaligned;
 
     FIFOSampleBuffer outputBuffer;
     FIFOSampleBuffer inputBuffer;
 
+    RealFFT seekFFT;
+    float *pSeekRef;
+    float *pSeekMid;
+
+    /// Input averaged over blocks of MULTIRES_DECIMATION frames & all channels, for
+    /// the coarse levels of the multi-resolution seek. The first block begins at
+    /// frame 'decimStart' of 'inputBuffer'.
+    FIFOSampleBuffer decimatedBuffer;
+    int decimChannels;
+    int decimStart;
+    float *pDecimatedMid;
+    int decimatedMidSize;
+
+    /// Offset of the next seek at which the input continues the samples of the
+    /// previous sequence in 'pMidBuffer', valid if 'bSeekContinuation' is set.
+    /// May lie outside the seek window.
+    int seekContinuation;
+    bool bSeekContinuation;
+
+    /// Pitch period estimate of the predictive seek in samples, zero if unknown
+    double seekPeriod;
+
+    PredictiveSeekStats predictStats;
+
     void acceptNewOverlapLength(int newOverlapLength);
 
     virtual void clearCrossCorrState();
@@ -145,6 +262,16 @@ protected:
 
     virtual int seekBestOverlapPositionFull(const SAMPLETYPE *refPos);
     virtual int seekBestOverlapPositionQuick(const SAMPLETYPE *refPos);
+    virtual int seekBestOverlapPositionFFT(const SAMPLETYPE *refPos);
+    virtual int seekBestOverlapPositionMultiRes(const SAMPLETYPE *refPos);
+    virtual int seekBestOverlapPositionPredictive(const SAMPLETYPE *refPos);
+    int seekBestOverlapPositionWide(const SAMPLETYPE *refPos);
+    void learnSeekPeriod(const SAMPLETYPE *refPos, int bestOffs, double energy);
+    double calcMidEnergy() const;
+    void prepareFFTSeek();
+    void prepareMultiResSeek();
+    void updateDecimated();
+    void skipDecimated(int frames);
     virtual int seekBestOverlapPosition(const SAMPLETYPE *refPos);
 
     virtual void overlapStereo(SAMPLETYPE *output, const SAMPLETYPE *input) const;
@@ -177,23 +304,23 @@ public:
     static TDStretch *newInstance();
 
     /// Returns the output buffer object
-    FIFOSamplePipe *getOutput() { return &outputBuffer; };
+    FIFOSampleBuffer *getOutput() override { return &outputBuffer; };
 
     /// Returns the input buffer object
-    FIFOSamplePipe *getInput() { return &inputBuffer; };
+    FIFOSampleBuffer *getInput() override { return &inputBuffer; };
 
     /// Sets new target tempo. Normal tempo = 'SCALE', smaller values represent slower
     /// tempo, larger faster tempo.
-    void setTempo(double newTempo);
+    void setTempo(double newTempo) override;
 
     /// Returns nonzero if there aren't any samples available for outputting.
     virtual void clear() override;
 
     /// Clears the input buffer
-    void clearInput();
+    void clearInput() override;
 
     /// Sets the number of channels, 1 = mono, 2 = stereo
-    void setChannels(int numChannels);
+    void setChannels(int numChannels) override;
 
     /// Enables/disables the quick position seeking algorithm. Zero to disable,
     /// nonzero to enable
@@ -202,6 +329,54 @@ public:
     /// Returns nonzero if the quick seeking algorithm is enabled.
     bool isQuickSeekEnabled() const;
 
+    /// Enables/disables the FFT based full position seeking. It finds the same
+    /// position as the plain full seek, but calculates the correlation of all
+    /// offsets at once in the frequency domain. Used only when quick seek is
+    /// disabled, and only with floating point samples.
+    void enableFFTSeek(bool enable);
+
+    /// Returns nonzero if the FFT based seeking is enabled.
+    bool isFFTSeekEnabled() const;
+
+    /// Enables/disables the multi-resolution position seeking. It searches all
+    /// offsets on a decimated copy of the input and refines the two best ones at
+    /// full resolution, for a better match than the quick seek at a lower cost.
+    /// Takes precedence over the quick & full seeks when enabled.
+    void enableMultiResSeek(bool enable);
+
+    /// Returns nonzero if the multi-resolution seeking is enabled.
+    bool isMultiResSeekEnabled() const;
+
+    /// Enables/disables the predictive position seeking. Each seek first probes a
+    /// narrow window around the offset that continues the previous sequence, shifted
+    /// by whole estimated pitch periods, and searches the whole seek window with the
+    /// other seek settings only if the probe doesn't find a confident match.
+    /// Enabling resets the statistics.
+    void enablePredictiveSeek(bool enable);
+
+    /// Returns nonzero if the predictive seeking is enabled.
+    bool isPredictiveSeekEnabled() const;
+
+    /// Sets the low-latency mode. A sequence is begun as soon as the seek window is
+    /// in the input, instead of the whole sequence, and the sequence is output as
+    /// far as the input reaches. The seek window is also shortened if needed to
+    /// bound the seek window plus overlap to 'lookaheadMs' milliseconds, so this
+    /// trades the quality of the overlap matching for latency. Zero disables.
+    void setLowLatency(int lookaheadMs);
+
+    /// Returns the low-latency mode lookahead bound in milliseconds, zero if off
+    int getLowLatency() const;
+
+    /// Presizes the buffers for the tempo range. The sequence parameters must be
+    /// set before, as changing them reallocates the buffers.
+    uint reserve(uint maxInput, double minTempo, double maxTempo) override;
+
+    /// Returns the counters of the predictive seeking since it was enabled
+    const PredictiveSeekStats &getPredictiveSeekStats() const
+    {
+        return predictStats;
+    }
+
     /// Sets routine control parameters. These control are certain time constants
     /// defining how the sound is stretched to the desired duration.
     //
@@ -229,22 +404,26 @@ public:
                                                     ///< contains both channels if stereo
             ) override;
 
+    /// Processes the samples added directly to the input buffer
+    void processInput() override;
+
     /// return nominal input sample requirement for triggering a processing batch
-    int getInputSampleReq() const
+    int getInputSampleReq() const override
     {
         return (int)(nominalSkip + 0.5);
     }
 
     /// return nominal output sample amount when running a processing batch
-    int getOutputBatchSize() const
+    int getOutputBatchSize() const override
     {
         return seekWindowLength - overlapLength;
     }
 
-	/// return approximate initial input-output latency
-	int getLatency() const
+	/// return approximate initial input-output latency. In the low-latency mode
+	/// output begins once the seek window is in, and then follows the input.
+	int getLatency() const override
 	{
-		return sampleReq;
+		return (lookaheadMs > 0) ? seekLength + overlapLength : sampleReq;
 	}
 };
 
@@ -275,5 +454,47 @@ public:
 
 #endif /// SOUNDTOUCH_ALLOW_SSE
 
+
+#if defined(SOUNDTOUCH_ALLOW_AVX2) && defined(SOUNDTOUCH_ALLOW_SSE)
+    /// Class that implements AVX2/FMA optimized routines for floating point samples type.
+    class TDStretchAVX2 : public TDStretch
+    {
+    protected:
+        double calcCrossCorr(const float *mixingPos, const float *compare, double &norm) override;
+        double calcCrossCorrAccumulate(const float *mixingPos, const float *compare, double &norm) override;
+        virtual void overlapMono(float *output, const float *input) const override;
+        virtual void overlapStereo(float *output, const float *input) const override;
+    };
+
+#endif /// SOUNDTOUCH_ALLOW_AVX2
+
+
+#if defined(SOUNDTOUCH_ALLOW_AVX512) && defined(SOUNDTOUCH_ALLOW_AVX2) && defined(SOUNDTOUCH_ALLOW_SSE)
+    /// Class that implements AVX-512 optimized routines for floating point samples type.
+    class TDStretchAVX512 : public TDStretchAVX2
+    {
+    protected:
+        double calcCrossCorr(const float *mixingPos, const float *compare, double &norm) override;
+        double calcCrossCorrAccumulate(const float *mixingPos, const float *compare, double &norm) override;
+        virtual void overlapMono(float *output, const float *input) const override;
+        virtual void overlapStereo(float *output, const float *input) const override;
+    };
+
+#endif /// SOUNDTOUCH_ALLOW_AVX512
+
+
+#ifdef SOUNDTOUCH_ALLOW_NEON
+    /// Class that implements NEON optimized routines for floating point samples type.
+    class TDStretchNEON : public TDStretch
+    {
+    protected:
+        double calcCrossCorr(const float *mixingPos, const float *compare, double &norm) override;
+        double calcCrossCorrAccumulate(const float *mixingPos, const float *compare, double &norm) override;
+        virtual void overlapMono(float *output, const float *input) const override;
+        virtual void overlapStereo(float *output, const float *input) const override;
+    };
+
+#endif /// SOUNDTOUCH_ALLOW_NEON
+
 }
 #endif  /// TDStretch_H
@@ -0,0 +1,430 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// AVX2 optimized routines for x86 CPUs supporting the AVX2 instruction set.
+/// All AVX2 optimized functions are gathered into this single source file, and
+/// only they are compiled with AVX2 code generation enabled. The routines are
+/// selected at runtime, so the rest of the library keeps running on CPUs
+/// without AVX2. The TDStretch and FIRFilter routines also use FMA and
+/// are only selected when the CPU has both.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "cpu_detect.h"
+#include "STTypes.h"
+#include "SampleConvertSIMD.h"
+
+using namespace soundtouch;
+
+#ifdef SOUNDTOUCH_ALLOW_AVX2
+
+#include <immintrin.h>
+
+// The file is compiled for the baseline CPU and only these routines for AVX2 &
+// FMA, so that the inline functions of the included headers don't get AVX code
+// that the linker could pick for the rest of the library. MSVC needs no flag
+// for the intrinsics.
+#if defined(__GNUC__) || defined(__clang__)
+    #define ST_TARGET_AVX2  __attribute__((target("avx2,fma")))
+#else
+    #define ST_TARGET_AVX2
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of AVX2 optimized sample format conversion routines
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Saturates scaled samples to given range and truncates them to integers
+ST_TARGET_AVX2 static inline __m256i avx2Saturate(__m256 v, __m256 vMin, __m256 vMax)
+{
+    return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(v, vMin), vMax));
+}
+
+
+// Packs 2 x 8 int32 to 16 int16. The pack instruction works within 128bit
+// halves, so the 64bit quarters need reordering afterwards.
+ST_TARGET_AVX2 static inline __m256i avx2PackInt16(__m256i lo, __m256i hi)
+{
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+
+// Triangular noise from eight xorshift32 lanes, see 'tpdfNoise' in SampleConvert.cpp
+ST_TARGET_AVX2 static inline __m256 avx2TpdfNoise(__m256i &state)
+{
+    state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+    state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+    state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+
+    __m256i hi = _mm256_srli_epi32(state, 16);
+    __m256i lo = _mm256_and_si256(state, _mm256_set1_epi32(0xffff));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(hi, lo)), _mm256_set1_ps(1.0f / 65536.0f));
+}
+
+
+ST_TARGET_AVX2 uint soundtouch::convertFloatToInt16AVX2(const float *src, short *dest, uint numSamples)
+{
+    const __m256 vScale = _mm256_set1_ps(32768.0f);
+    const __m256 vMin = _mm256_set1_ps(-32768.0f);
+    const __m256 vMax = _mm256_set1_ps(32767.0f);
+    uint count16 = numSamples & ~(uint)15;
+    uint count = numSamples & ~(uint)7;
+    uint i;
+
+    for (i = 0; i < count16; i += 16)
+    {
+        __m256i lo = avx2Saturate(_mm256_mul_ps(_mm256_loadu_ps(src + i), vScale), vMin, vMax);
+        __m256i hi = avx2Saturate(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), vScale), vMin, vMax);
+        _mm256_storeu_si256((__m256i *)(dest + i), avx2PackInt16(lo, hi));
+    }
+    if (i < count)
+    {
+        __m256i v = avx2Saturate(_mm256_mul_ps(_mm256_loadu_ps(src + i), vScale), vMin, vMax);
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        _mm_storeu_si128((__m128i *)(dest + i), packed);
+    }
+    return count;
+}
+
+
+ST_TARGET_AVX2 uint soundtouch::convertFloatToInt16DitherAVX2(const float *src, short *dest, uint numSamples, DitherState &dither)
+{
+    const __m256 vScale = _mm256_set1_ps(32768.0f);
+    const __m256 vMin = _mm256_set1_ps(-32768.0f);
+    const __m256 vMax = _mm256_set1_ps(32767.0f);
+    __m256i state = _mm256_loadu_si256((const __m256i *)dither.lane);
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 8)
+    {
+        __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), vScale), avx2TpdfNoise(state));
+        __m256i iv = avx2Saturate(v, vMin, vMax);
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(iv), _mm256_extracti128_si256(iv, 1));
+        _mm_storeu_si128((__m128i *)(dest + i), packed);
+    }
+
+    _mm256_storeu_si256((__m256i *)dither.lane, state);
+    return count;
+}
+
+
+ST_TARGET_AVX2 uint soundtouch::convertInt16ToFloatAVX2(const short *src, float *dest, uint numSamples)
+{
+    const __m256 vScale = _mm256_set1_ps(1.0f / 32768.0f);
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 8)
+    {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), vScale));
+    }
+    return count;
+}
+
+
+ST_TARGET_AVX2 uint soundtouch::convertFloatToInt24AVX2(const float *src, int *dest, uint numSamples)
+{
+    const __m256 vScale = _mm256_set1_ps(8388608.0f);
+    const __m256 vMin = _mm256_set1_ps(-8388608.0f);
+    const __m256 vMax = _mm256_set1_ps(8388607.0f);
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 8)
+    {
+        __m256i v = avx2Saturate(_mm256_mul_ps(_mm256_loadu_ps(src + i), vScale), vMin, vMax);
+        _mm256_storeu_si256((__m256i *)(dest + i), v);
+    }
+    return count;
+}
+
+
+
+#ifdef SOUNDTOUCH_ALLOW_SSE
+
+// TDStretch and FIRFilter routines are available only with float sample type
+
+#include <assert.h>
+#include <math.h>
+#include "TDStretch.h"
+#include "FIRFilter.h"
+
+// Sum of the eight lanes
+ST_TARGET_AVX2 static inline float avx2Sum(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of AVX2 optimized functions of class 'TDStretchAVX2'
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Calculates cross correlation of two buffers, on four independent
+// accumulators per sum
+ST_TARGET_AVX2 double TDStretchAVX2::calcCrossCorr(const float *pV1, const float *pV2, double &anorm)
+{
+    #ifdef ST_SIMD_AVOID_UNALIGNED
+        // skip 'mixingPos' positions that aren't aligned to 16-byte boundary
+        if (((ulongptr)pV1) & 15) return -1e50;
+    #endif
+
+    // overlapLength is divisible by 8
+    int ilength = (channels * overlapLength) & -8;
+    int i;
+
+    __m256 vCorr0 = _mm256_setzero_ps(), vCorr1 = _mm256_setzero_ps();
+    __m256 vCorr2 = _mm256_setzero_ps(), vCorr3 = _mm256_setzero_ps();
+    __m256 vNorm0 = _mm256_setzero_ps(), vNorm1 = _mm256_setzero_ps();
+    __m256 vNorm2 = _mm256_setzero_ps(), vNorm3 = _mm256_setzero_ps();
+
+    for (i = 0; i + 32 <= ilength; i += 32)
+    {
+        __m256 v0 = _mm256_loadu_ps(pV1 + i);
+        __m256 v1 = _mm256_loadu_ps(pV1 + i + 8);
+        __m256 v2 = _mm256_loadu_ps(pV1 + i + 16);
+        __m256 v3 = _mm256_loadu_ps(pV1 + i + 24);
+
+        vCorr0 = _mm256_fmadd_ps(v0, _mm256_loadu_ps(pV2 + i), vCorr0);
+        vCorr1 = _mm256_fmadd_ps(v1, _mm256_loadu_ps(pV2 + i + 8), vCorr1);
+        vCorr2 = _mm256_fmadd_ps(v2, _mm256_loadu_ps(pV2 + i + 16), vCorr2);
+        vCorr3 = _mm256_fmadd_ps(v3, _mm256_loadu_ps(pV2 + i + 24), vCorr3);
+
+        vNorm0 = _mm256_fmadd_ps(v0, v0, vNorm0);
+        vNorm1 = _mm256_fmadd_ps(v1, v1, vNorm1);
+        vNorm2 = _mm256_fmadd_ps(v2, v2, vNorm2);
+        vNorm3 = _mm256_fmadd_ps(v3, v3, vNorm3);
+    }
+    for (; i < ilength; i += 8)
+    {
+        __m256 v0 = _mm256_loadu_ps(pV1 + i);
+        vCorr0 = _mm256_fmadd_ps(v0, _mm256_loadu_ps(pV2 + i), vCorr0);
+        vNorm0 = _mm256_fmadd_ps(v0, v0, vNorm0);
+    }
+
+    float corr = avx2Sum(_mm256_add_ps(_mm256_add_ps(vCorr0, vCorr1), _mm256_add_ps(vCorr2, vCorr3)));
+    float norm = avx2Sum(_mm256_add_ps(_mm256_add_ps(vNorm0, vNorm1), _mm256_add_ps(vNorm2, vNorm3)));
+
+    anorm = norm;
+    return corr / sqrt((norm < 1e-9 ? 1.0 : norm));
+}
+
+
+// Update cross-correlation by accumulating "norm" coefficient by previously calculated value
+ST_TARGET_AVX2 double TDStretchAVX2::calcCrossCorrAccumulate(const float *pV1, const float *pV2, double &norm)
+{
+    int ilength = (channels * overlapLength) & -8;
+    int i;
+
+    // cancel first normalizer tap from previous round
+    for (i = 1; i <= channels; i ++)
+    {
+        norm -= pV1[-i] * pV1[-i];
+    }
+
+    __m256 vCorr0 = _mm256_setzero_ps(), vCorr1 = _mm256_setzero_ps();
+    __m256 vCorr2 = _mm256_setzero_ps(), vCorr3 = _mm256_setzero_ps();
+
+    for (i = 0; i + 32 <= ilength; i += 32)
+    {
+        vCorr0 = _mm256_fmadd_ps(_mm256_loadu_ps(pV1 + i), _mm256_loadu_ps(pV2 + i), vCorr0);
+        vCorr1 = _mm256_fmadd_ps(_mm256_loadu_ps(pV1 + i + 8), _mm256_loadu_ps(pV2 + i + 8), vCorr1);
+        vCorr2 = _mm256_fmadd_ps(_mm256_loadu_ps(pV1 + i + 16), _mm256_loadu_ps(pV2 + i + 16), vCorr2);
+        vCorr3 = _mm256_fmadd_ps(_mm256_loadu_ps(pV1 + i + 24), _mm256_loadu_ps(pV2 + i + 24), vCorr3);
+    }
+    for (; i < ilength; i += 8)
+    {
+        vCorr0 = _mm256_fmadd_ps(_mm256_loadu_ps(pV1 + i), _mm256_loadu_ps(pV2 + i), vCorr0);
+    }
+
+    float corr = avx2Sum(_mm256_add_ps(_mm256_add_ps(vCorr0, vCorr1), _mm256_add_ps(vCorr2, vCorr3)));
+
+    // update normalizer with last samples of this round
+    for (int j = 1; j <= channels; j ++)
+    {
+        norm += pV1[ilength - j] * pV1[ilength - j];
+    }
+
+    return corr / sqrt((norm < 1e-9 ? 1.0 : norm));
+}
+
+
+// Overlaps samples in 'midBuffer' with the samples in 'pInput'. One vector
+// holds the integer weights of eight consecutive samples.
+ST_TARGET_AVX2 void TDStretchAVX2::overlapMono(float *pOutput, const float *pInput) const
+{
+    const __m256 vScale = _mm256_set1_ps(1.0f / (float)overlapLength);
+    const __m256 vStep = _mm256_set1_ps(8.0f);
+    const __m256 vLength = _mm256_set1_ps((float)overlapLength);
+    __m256 vM1 = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+
+    // overlapLength is divisible by 8
+    for (int i = 0; i < overlapLength; i += 8)
+    {
+        __m256 vM2 = _mm256_sub_ps(vLength, vM1);
+        __m256 sum = _mm256_mul_ps(_mm256_loadu_ps(pMidBuffer + i), vM2);
+        sum = _mm256_fmadd_ps(_mm256_loadu_ps(pInput + i), vM1, sum);
+        _mm256_storeu_ps(pOutput + i, _mm256_mul_ps(sum, vScale));
+        vM1 = _mm256_add_ps(vM1, vStep);
+    }
+}
+
+
+// Overlaps samples in 'midBuffer' with the samples in 'pInput'. The 'Stereo'
+// version of the routine; each vector holds four stereo frames.
+ST_TARGET_AVX2 void TDStretchAVX2::overlapStereo(float *pOutput, const float *pInput) const
+{
+    const float fScale = 1.0f / (float)overlapLength;
+    const __m256 vStep = _mm256_set1_ps(4.0f * fScale);
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    __m256 vF1 = _mm256_mul_ps(_mm256_setr_ps(0, 0, 1, 1, 2, 2, 3, 3), _mm256_set1_ps(fScale));
+
+    for (int i = 0; i < 2 * overlapLength; i += 8)
+    {
+        __m256 vF2 = _mm256_sub_ps(vOne, vF1);
+        __m256 sum = _mm256_mul_ps(_mm256_loadu_ps(pMidBuffer + i), vF2);
+        sum = _mm256_fmadd_ps(_mm256_loadu_ps(pInput + i), vF1, sum);
+        _mm256_storeu_ps(pOutput + i, sum);
+        vF1 = _mm256_add_ps(vF1, vStep);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of AVX2 optimized functions of class 'FIRFilterAVX2'
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Filters 32 consecutive mono samples at a time: each tap coefficient is
+// broadcast and multiplied with four vectors of source samples, so that the
+// four accumulators are independent and no horizontal sums are needed.
+ST_TARGET_AVX2 uint FIRFilterAVX2::evaluateFilterMono(float *dest, const float *src, uint numSamples) const
+{
+    assert(length != 0);
+    assert(src != nullptr);
+    assert(dest != nullptr);
+    assert(filterCoeffs != nullptr);
+
+    int end = (int)(numSamples - length);
+    int j;
+
+    #pragma omp parallel for
+    for (j = 0; j < (end & -32); j += 32)
+    {
+        const float *pSrc = src + j;
+        __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+        __m256 sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+
+        for (uint i = 0; i < length; i ++)
+        {
+            __m256 coeff = _mm256_broadcast_ss(filterCoeffs + i);
+            sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(pSrc + i), coeff, sum0);
+            sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(pSrc + i + 8), coeff, sum1);
+            sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(pSrc + i + 16), coeff, sum2);
+            sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(pSrc + i + 24), coeff, sum3);
+        }
+        _mm256_storeu_ps(dest + j, sum0);
+        _mm256_storeu_ps(dest + j + 8, sum1);
+        _mm256_storeu_ps(dest + j + 16, sum2);
+        _mm256_storeu_ps(dest + j + 24, sum3);
+    }
+
+    for (j = end & -32; j < end; j ++)
+    {
+        const float *pSrc = src + j;
+        __m256 sum = _mm256_setzero_ps();
+
+        // length is divisible by 8
+        for (uint i = 0; i < length; i += 8)
+        {
+            sum = _mm256_fmadd_ps(_mm256_loadu_ps(pSrc + i), _mm256_loadu_ps(filterCoeffs + i), sum);
+        }
+        dest[j] = avx2Sum(sum);
+    }
+    return (uint)end;
+}
+
+
+// Same as the mono routine for interleaved stereo: a vector holds four frames
+// of both channels, so four accumulators cover 16 output frames.
+ST_TARGET_AVX2 uint FIRFilterAVX2::evaluateFilterStereo(float *dest, const float *src, uint numSamples) const
+{
+    assert(length != 0);
+    assert(src != nullptr);
+    assert(dest != nullptr);
+    assert(filterCoeffs != nullptr);
+    assert(numSamples >= length);
+
+    int end = (int)(numSamples - length);
+    int j;
+
+    #pragma omp parallel for
+    for (j = 0; j < (end & -16); j += 16)
+    {
+        const float *pSrc = src + 2 * j;
+        __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+        __m256 sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+
+        for (uint i = 0; i < length; i ++)
+        {
+            __m256 coeff = _mm256_broadcast_ss(filterCoeffs + i);
+            const float *ptr = pSrc + 2 * i;
+            sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(ptr), coeff, sum0);
+            sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(ptr + 8), coeff, sum1);
+            sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(ptr + 16), coeff, sum2);
+            sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(ptr + 24), coeff, sum3);
+        }
+        float *pDest = dest + 2 * j;
+        _mm256_storeu_ps(pDest, sum0);
+        _mm256_storeu_ps(pDest + 8, sum1);
+        _mm256_storeu_ps(pDest + 16, sum2);
+        _mm256_storeu_ps(pDest + 24, sum3);
+    }
+
+    for (j = end & -16; j < end; j ++)
+    {
+        const float *pSrc = src + 2 * j;
+        __m256 sum = _mm256_setzero_ps();
+
+        // four taps of both channels per vector
+        for (uint i = 0; i < 2 * length; i += 8)
+        {
+            sum = _mm256_fmadd_ps(_mm256_loadu_ps(pSrc + i), _mm256_loadu_ps(filterCoeffsStereo + i), sum);
+        }
+        __m128 lr = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        lr = _mm_add_ps(lr, _mm_movehl_ps(lr, lr));
+        _mm_storel_pi((__m64 *)(dest + 2 * j), lr);
+    }
+    return (uint)end;
+}
+
+#endif  // SOUNDTOUCH_ALLOW_SSE
+
+#endif  // SOUNDTOUCH_ALLOW_AVX2
@@ -0,0 +1,295 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// AVX-512 optimized routines for x86 CPUs supporting the AVX-512F instruction
+/// set. All AVX-512 optimized functions are gathered into this single source
+/// file, and only they are compiled with AVX-512 code generation enabled. The
+/// routines are selected at runtime, so the rest of the library keeps running
+/// on CPUs without AVX-512.
+///
+/// Sample counts that don't fill a 512-bit vector are handled with masked
+/// loads and stores, or passed on to the AVX2 routines of the base classes.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "cpu_detect.h"
+#include "STTypes.h"
+
+using namespace soundtouch;
+
+#if defined(SOUNDTOUCH_ALLOW_AVX512) && defined(SOUNDTOUCH_ALLOW_AVX2) && defined(SOUNDTOUCH_ALLOW_SSE)
+
+// AVX-512 routines available only with float sample type
+
+#include <immintrin.h>
+#include <math.h>
+#include "TDStretch.h"
+#include "FIRFilter.h"
+
+// Only these routines are compiled for AVX-512, see 'avx2_optimized.cpp'
+#if defined(__GNUC__) || defined(__clang__)
+    #define ST_TARGET_AVX512    __attribute__((target("avx512f,avx2,fma")))
+#else
+    #define ST_TARGET_AVX512
+#endif
+
+// Mask of the first 'count' lanes
+ST_TARGET_AVX512 static inline __mmask16 avx512Mask(int count)
+{
+    return (__mmask16)((1u << count) - 1);
+}
+
+
+// Sum of the 16 lanes. Goes through memory once per call rather than through
+// the 512-bit extract intrinsics, which trip -Wuninitialized in GCC 12.
+ST_TARGET_AVX512 static inline float avx512Sum(__m512 v)
+{
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, v);
+
+    __m256 s8 = _mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8));
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of AVX-512 optimized functions of class 'TDStretchAVX512'
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Calculates cross correlation of two buffers, on four independent
+// accumulators per sum
+ST_TARGET_AVX512 double TDStretchAVX512::calcCrossCorr(const float *pV1, const float *pV2, double &anorm)
+{
+    #ifdef ST_SIMD_AVOID_UNALIGNED
+        // skip 'mixingPos' positions that aren't aligned to 16-byte boundary
+        if (((ulongptr)pV1) & 15) return -1e50;
+    #endif
+
+    int ilength = (channels * overlapLength) & -8;
+    int i;
+
+    __m512 vCorr0 = _mm512_setzero_ps(), vCorr1 = _mm512_setzero_ps();
+    __m512 vCorr2 = _mm512_setzero_ps(), vCorr3 = _mm512_setzero_ps();
+    __m512 vNorm0 = _mm512_setzero_ps(), vNorm1 = _mm512_setzero_ps();
+    __m512 vNorm2 = _mm512_setzero_ps(), vNorm3 = _mm512_setzero_ps();
+
+    for (i = 0; i + 64 <= ilength; i += 64)
+    {
+        __m512 v0 = _mm512_loadu_ps(pV1 + i);
+        __m512 v1 = _mm512_loadu_ps(pV1 + i + 16);
+        __m512 v2 = _mm512_loadu_ps(pV1 + i + 32);
+        __m512 v3 = _mm512_loadu_ps(pV1 + i + 48);
+
+        vCorr0 = _mm512_fmadd_ps(v0, _mm512_loadu_ps(pV2 + i), vCorr0);
+        vCorr1 = _mm512_fmadd_ps(v1, _mm512_loadu_ps(pV2 + i + 16), vCorr1);
+        vCorr2 = _mm512_fmadd_ps(v2, _mm512_loadu_ps(pV2 + i + 32), vCorr2);
+        vCorr3 = _mm512_fmadd_ps(v3, _mm512_loadu_ps(pV2 + i + 48), vCorr3);
+
+        vNorm0 = _mm512_fmadd_ps(v0, v0, vNorm0);
+        vNorm1 = _mm512_fmadd_ps(v1, v1, vNorm1);
+        vNorm2 = _mm512_fmadd_ps(v2, v2, vNorm2);
+        vNorm3 = _mm512_fmadd_ps(v3, v3, vNorm3);
+    }
+    for (; i < ilength; i += 16)
+    {
+        // the last round may have only 8 samples left
+        __mmask16 mask = avx512Mask(ilength - i < 16 ? ilength - i : 16);
+        __m512 v0 = _mm512_maskz_loadu_ps(mask, pV1 + i);
+        vCorr0 = _mm512_fmadd_ps(v0, _mm512_maskz_loadu_ps(mask, pV2 + i), vCorr0);
+        vNorm0 = _mm512_fmadd_ps(v0, v0, vNorm0);
+    }
+
+    float corr = avx512Sum(_mm512_add_ps(_mm512_add_ps(vCorr0, vCorr1), _mm512_add_ps(vCorr2, vCorr3)));
+    float norm = avx512Sum(_mm512_add_ps(_mm512_add_ps(vNorm0, vNorm1), _mm512_add_ps(vNorm2, vNorm3)));
+
+    anorm = norm;
+    return corr / sqrt((norm < 1e-9 ? 1.0 : norm));
+}
+
+
+// Update cross-correlation by accumulating "norm" coefficient by previously calculated value
+ST_TARGET_AVX512 double TDStretchAVX512::calcCrossCorrAccumulate(const float *pV1, const float *pV2, double &norm)
+{
+    int ilength = (channels * overlapLength) & -8;
+    int i;
+
+    // cancel first normalizer tap from previous round
+    for (i = 1; i <= channels; i ++)
+    {
+        norm -= pV1[-i] * pV1[-i];
+    }
+
+    __m512 vCorr0 = _mm512_setzero_ps(), vCorr1 = _mm512_setzero_ps();
+    __m512 vCorr2 = _mm512_setzero_ps(), vCorr3 = _mm512_setzero_ps();
+
+    for (i = 0; i + 64 <= ilength; i += 64)
+    {
+        vCorr0 = _mm512_fmadd_ps(_mm512_loadu_ps(pV1 + i), _mm512_loadu_ps(pV2 + i), vCorr0);
+        vCorr1 = _mm512_fmadd_ps(_mm512_loadu_ps(pV1 + i + 16), _mm512_loadu_ps(pV2 + i + 16), vCorr1);
+        vCorr2 = _mm512_fmadd_ps(_mm512_loadu_ps(pV1 + i + 32), _mm512_loadu_ps(pV2 + i + 32), vCorr2);
+        vCorr3 = _mm512_fmadd_ps(_mm512_loadu_ps(pV1 + i + 48), _mm512_loadu_ps(pV2 + i + 48), vCorr3);
+    }
+    for (; i < ilength; i += 16)
+    {
+        __mmask16 mask = avx512Mask(ilength - i < 16 ? ilength - i : 16);
+        vCorr0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, pV1 + i),
+                                 _mm512_maskz_loadu_ps(mask, pV2 + i), vCorr0);
+    }
+
+    float corr = avx512Sum(_mm512_add_ps(_mm512_add_ps(vCorr0, vCorr1), _mm512_add_ps(vCorr2, vCorr3)));
+
+    // update normalizer with last samples of this round
+    for (int j = 1; j <= channels; j ++)
+    {
+        norm += pV1[ilength - j] * pV1[ilength - j];
+    }
+
+    return corr / sqrt((norm < 1e-9 ? 1.0 : norm));
+}
+
+
+// Overlaps samples in 'midBuffer' with the samples in 'pInput'. One vector
+// holds the integer weights of 16 consecutive samples.
+ST_TARGET_AVX512 void TDStretchAVX512::overlapMono(float *pOutput, const float *pInput) const
+{
+    const __m512 vScale = _mm512_set1_ps(1.0f / (float)overlapLength);
+    const __m512 vStep = _mm512_set1_ps(16.0f);
+    const __m512 vLength = _mm512_set1_ps((float)overlapLength);
+    __m512 vM1 = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    // overlapLength is divisible by 8, the last round may be a half vector
+    for (int i = 0; i < overlapLength; i += 16)
+    {
+        __mmask16 mask = avx512Mask(overlapLength - i < 16 ? overlapLength - i : 16);
+        __m512 vM2 = _mm512_sub_ps(vLength, vM1);
+        __m512 sum = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, pMidBuffer + i), vM2);
+        sum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, pInput + i), vM1, sum);
+        _mm512_mask_storeu_ps(pOutput + i, mask, _mm512_mul_ps(sum, vScale));
+        vM1 = _mm512_add_ps(vM1, vStep);
+    }
+}
+
+
+// Overlaps samples in 'midBuffer' with the samples in 'pInput'. The 'Stereo'
+// version of the routine; each vector holds eight stereo frames.
+ST_TARGET_AVX512 void TDStretchAVX512::overlapStereo(float *pOutput, const float *pInput) const
+{
+    const float fScale = 1.0f / (float)overlapLength;
+    const __m512 vStep = _mm512_set1_ps(8.0f * fScale);
+    const __m512 vOne = _mm512_set1_ps(1.0f);
+    __m512 vF1 = _mm512_mul_ps(_mm512_setr_ps(0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7),
+                               _mm512_set1_ps(fScale));
+
+    // 2 * overlapLength is divisible by 16
+    for (int i = 0; i < 2 * overlapLength; i += 16)
+    {
+        __m512 vF2 = _mm512_sub_ps(vOne, vF1);
+        __m512 sum = _mm512_mul_ps(_mm512_loadu_ps(pMidBuffer + i), vF2);
+        sum = _mm512_fmadd_ps(_mm512_loadu_ps(pInput + i), vF1, sum);
+        _mm512_storeu_ps(pOutput + i, sum);
+        vF1 = _mm512_add_ps(vF1, vStep);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of AVX-512 optimized functions of class 'FIRFilterAVX512'
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Filters 64 consecutive mono samples at a time, see the AVX2 routine. The
+// remaining samples are filtered by the AVX2 routine.
+ST_TARGET_AVX512 uint FIRFilterAVX512::evaluateFilterMono(float *dest, const float *src, uint numSamples) const
+{
+    int end = (int)(numSamples - length);
+    int j;
+
+    #pragma omp parallel for
+    for (j = 0; j < (end & -64); j += 64)
+    {
+        const float *pSrc = src + j;
+        __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+        __m512 sum2 = _mm512_setzero_ps(), sum3 = _mm512_setzero_ps();
+
+        for (uint i = 0; i < length; i ++)
+        {
+            __m512 coeff = _mm512_set1_ps(filterCoeffs[i]);
+            sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(pSrc + i), coeff, sum0);
+            sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(pSrc + i + 16), coeff, sum1);
+            sum2 = _mm512_fmadd_ps(_mm512_loadu_ps(pSrc + i + 32), coeff, sum2);
+            sum3 = _mm512_fmadd_ps(_mm512_loadu_ps(pSrc + i + 48), coeff, sum3);
+        }
+        _mm512_storeu_ps(dest + j, sum0);
+        _mm512_storeu_ps(dest + j + 16, sum1);
+        _mm512_storeu_ps(dest + j + 32, sum2);
+        _mm512_storeu_ps(dest + j + 48, sum3);
+    }
+
+    j = end & -64;
+    FIRFilterAVX2::evaluateFilterMono(dest + j, src + j, numSamples - (uint)j);
+    return (uint)end;
+}
+
+
+// Same as the mono routine for interleaved stereo: a vector holds eight
+// frames of both channels, so four accumulators cover 32 output frames.
+ST_TARGET_AVX512 uint FIRFilterAVX512::evaluateFilterStereo(float *dest, const float *src, uint numSamples) const
+{
+    int end = (int)(numSamples - length);
+    int j;
+
+    #pragma omp parallel for
+    for (j = 0; j < (end & -32); j += 32)
+    {
+        const float *pSrc = src + 2 * j;
+        __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+        __m512 sum2 = _mm512_setzero_ps(), sum3 = _mm512_setzero_ps();
+
+        for (uint i = 0; i < length; i ++)
+        {
+            __m512 coeff = _mm512_set1_ps(filterCoeffs[i]);
+            const float *ptr = pSrc + 2 * i;
+            sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(ptr), coeff, sum0);
+            sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(ptr + 16), coeff, sum1);
+            sum2 = _mm512_fmadd_ps(_mm512_loadu_ps(ptr + 32), coeff, sum2);
+            sum3 = _mm512_fmadd_ps(_mm512_loadu_ps(ptr + 48), coeff, sum3);
+        }
+        float *pDest = dest + 2 * j;
+        _mm512_storeu_ps(pDest, sum0);
+        _mm512_storeu_ps(pDest + 16, sum1);
+        _mm512_storeu_ps(pDest + 32, sum2);
+        _mm512_storeu_ps(pDest + 48, sum3);
+    }
+
+    j = end & -32;
+    FIRFilterAVX2::evaluateFilterStereo(dest + 2 * j, src + 2 * j, numSamples - (uint)j);
+    return (uint)end;
+}
+
+#endif  // SOUNDTOUCH_ALLOW_AVX512
@@ -38,10 +38,10 @@
 
 #if defined(SOUNDTOUCH_ALLOW_X86_OPTIMIZATIONS)
 
-   #if defined(__GNUC__) && defined(__i386__)
+   #if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
        // gcc
        #include "cpuid.h"
-   #elif defined(_M_IX86)
+   #elif defined(_M_IX86) || defined(_M_X64)
        // windows non-gcc
        #include <intrin.h>
    #endif
@@ -49,6 +49,11 @@
    #define bit_MMX     (1 << 23)
    #define bit_SSE     (1 << 25)
    #define bit_SSE2    (1 << 26)
+   #define bit_OSXSAVE (1 << 27)
+   #define bit_AVX     (1 << 28)
+   #define bit_FMA     (1 << 12)
+   #define bit_AVX2    (1 << 5)
+   #define bit_AVX512F (1 << 16)
 #endif
 
 
@@ -68,16 +73,76 @@ void disableExtensions(uint dwDisableMask)
 }
 
 
+#if defined(SOUNDTOUCH_ALLOW_X86_OPTIMIZATIONS)
+
+/// Checks for AVX2, FMA and AVX-512F support. Besides the CPU flags, the OS
+/// has to save the YMM (and for AVX-512 the ZMM and opmask) register state on
+/// context switches, which is reported in XCR0. AVX-512 is only reported
+/// together with AVX2 and FMA, which its kernels use as well.
+static uint avxExtensions(uint ecx1, uint ebx7, uint xcr0)
+{
+    if ((xcr0 & 0x6) != 0x6) return 0;     // XMM and YMM state enabled
+
+    uint res = 0;
+    if (ebx7 & bit_AVX2) res |= SUPPORT_AVX2;
+    if (ecx1 & bit_FMA)  res |= SUPPORT_FMA;
+
+    if ((ebx7 & bit_AVX512F) && (xcr0 & 0xe6) == 0xe6 &&
+        (res & (SUPPORT_AVX2 | SUPPORT_FMA)) == (SUPPORT_AVX2 | SUPPORT_FMA))
+    {
+        res |= SUPPORT_AVX512;
+    }
+    return res;
+}
+
+
+static uint detectAVXextensions(void)
+{
+#if defined(__GNUC__)
+    uint eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return 0;
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) return 0;
+    uint ecx1 = ecx;
+
+    uint xcr0, xcr0hi;
+    __asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0hi) : "c" (0));
+
+    if (__get_cpuid_max(0, nullptr) < 7) return 0;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+    return avxExtensions(ecx1, ebx, xcr0);
+#else
+    int reg[4] = {-1};
+
+    __cpuid(reg, 0);
+    int maxLeaf = reg[0];
+
+    __cpuid(reg, 1);
+    uint ecx1 = (unsigned int)reg[2];
+    if (!(ecx1 & bit_OSXSAVE) || !(ecx1 & bit_AVX)) return 0;
+    uint xcr0 = (uint)_xgetbv(0);
+
+    if (maxLeaf < 7) return 0;
+    __cpuidex(reg, 7, 0);
+
+    return avxExtensions(ecx1, (unsigned int)reg[1], xcr0);
+#endif
+}
+
+#endif
+
 /// Checks which instruction set extensions are supported by the CPU.
 uint detectCPUextensions(void)
 {
 /// If building for a 64bit system (no Itanium) and the user wants optimizations.
-/// Return the OR of SUPPORT_{MMX,SSE,SSE2}. 11001 or 0x19.
+/// Return the OR of SUPPORT_{MMX,SSE,SSE2}, 11001 or 0x19, plus AVX2/FMA/AVX-512 if the OS enables them.
 /// Keep the _dwDisabledISA test (2 more operations, could be eliminated).
 #if ((defined(__GNUC__) && defined(__x86_64__)) \
     || defined(_M_X64))  \
     && defined(SOUNDTOUCH_ALLOW_X86_OPTIMIZATIONS)
-    return 0x19 & ~_dwDisabledISA;
+    static const uint avx = detectAVXextensions();
+    return (0x19 | avx) & ~_dwDisabledISA;
 
 /// If building for a 32bit system and the user wants optimizations.
 /// Keep the _dwDisabledISA test (2 more operations, could be eliminated).
@@ -116,6 +181,8 @@ uint detectCPUextensions(void)
 
 #endif
 
+    res |= detectAVXextensions();
+
     return res & ~_dwDisabledISA;
 
 #else
@@ -124,7 +191,13 @@ uint detectCPUextensions(void)
 /// 1) We don't want optimizations.
 /// 2) Using an unsupported compiler.
 /// 3) Running on a non-x86 platform.
+#ifdef SOUNDTOUCH_ALLOW_NEON
+    // NEON is part of the ARM target the library was built for; report it
+    // so that it can be disabled like the x86 extensions
+    return SUPPORT_NEON & ~_dwDisabledISA;
+#else
     return 0;
+#endif
 
 #endif
 }
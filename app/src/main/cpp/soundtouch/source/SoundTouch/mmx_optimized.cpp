@@ -309,12 +309,16 @@ FIRFilterMMX::~FIRFilterMMX()
 void FIRFilterMMX::setCoefficients(const short *coeffs, uint newLength, uint uResultDivFactor)
 {
     uint i;
+    const uint prevLength = length;
     FIRFilter::setCoefficients(coeffs, newLength, uResultDivFactor);
 
     // Ensure that filter coeffs array is aligned to 16-byte boundary
-    delete[] filterCoeffsUnalign;
-    filterCoeffsUnalign = new short[2 * newLength + 8];
-    filterCoeffsAlign = (short *)SOUNDTOUCH_ALIGN_POINTER_16(filterCoeffsUnalign);
+    if ((newLength != prevLength) || (filterCoeffsUnalign == nullptr))
+    {
+        delete[] filterCoeffsUnalign;
+        filterCoeffsUnalign = new short[2 * newLength + 8];
+        filterCoeffsAlign = (short *)SOUNDTOUCH_ALIGN_POINTER_16(filterCoeffsUnalign);
+    }
 
     // rearrange the filter coefficients for mmx routines
     for (i = 0;i < length; i += 4)
@@ -0,0 +1,326 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// NEON optimized routines for ARM CPUs. All NEON optimized functions of the
+/// TDStretch and FIRFilter classes are gathered into this single source file.
+///
+/// The inner products run on several independent accumulators, so that
+/// consecutive multiply-adds don't wait for each other's result, and use fused
+/// multiply-add where the FPU has it. The classes are selected at runtime by
+/// the 'newInstance' functions, and can be turned off with
+/// 'disableExtensions(SUPPORT_NEON)' to compare against the plain C++ routines.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "cpu_detect.h"
+#include "STTypes.h"
+
+using namespace soundtouch;
+
+#ifdef SOUNDTOUCH_ALLOW_NEON
+
+// NEON routines available only with float sample type
+
+#include <arm_neon.h>
+#include <assert.h>
+#include <math.h>
+#include "TDStretch.h"
+#include "FIRFilter.h"
+
+
+// acc + a * b, fused where the FPU supports it (always on arm64)
+static inline float32x4_t neonMulAdd(float32x4_t acc, float32x4_t a, float32x4_t b)
+{
+#if defined(__aarch64__) || defined(__ARM_FEATURE_FMA)
+    return vfmaq_f32(acc, a, b);
+#else
+    return vmlaq_f32(acc, a, b);
+#endif
+}
+
+
+// Sum of the four lanes
+static inline float neonSum(float32x4_t v)
+{
+#ifdef __aarch64__
+    return vaddvq_f32(v);
+#else
+    float32x2_t pair = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of NEON optimized functions of class 'TDStretchNEON'
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Calculates cross correlation of two buffers
+double TDStretchNEON::calcCrossCorr(const float *pV1, const float *pV2, double &anorm)
+{
+    #ifdef ST_SIMD_AVOID_UNALIGNED
+        // skip 'mixingPos' positions that aren't aligned to 16-byte boundary
+        if (((ulongptr)pV1) & 15) return -1e50;
+    #endif
+
+    // overlapLength is divisible by 8
+    int ilength = (channels * overlapLength) & -8;
+    int i;
+
+    float32x4_t vCorr0 = vdupq_n_f32(0), vCorr1 = vdupq_n_f32(0);
+    float32x4_t vCorr2 = vdupq_n_f32(0), vCorr3 = vdupq_n_f32(0);
+    float32x4_t vNorm0 = vdupq_n_f32(0), vNorm1 = vdupq_n_f32(0);
+    float32x4_t vNorm2 = vdupq_n_f32(0), vNorm3 = vdupq_n_f32(0);
+
+    for (i = 0; i + 16 <= ilength; i += 16)
+    {
+        float32x4_t v0 = vld1q_f32(pV1 + i);
+        float32x4_t v1 = vld1q_f32(pV1 + i + 4);
+        float32x4_t v2 = vld1q_f32(pV1 + i + 8);
+        float32x4_t v3 = vld1q_f32(pV1 + i + 12);
+
+        vCorr0 = neonMulAdd(vCorr0, v0, vld1q_f32(pV2 + i));
+        vCorr1 = neonMulAdd(vCorr1, v1, vld1q_f32(pV2 + i + 4));
+        vCorr2 = neonMulAdd(vCorr2, v2, vld1q_f32(pV2 + i + 8));
+        vCorr3 = neonMulAdd(vCorr3, v3, vld1q_f32(pV2 + i + 12));
+
+        vNorm0 = neonMulAdd(vNorm0, v0, v0);
+        vNorm1 = neonMulAdd(vNorm1, v1, v1);
+        vNorm2 = neonMulAdd(vNorm2, v2, v2);
+        vNorm3 = neonMulAdd(vNorm3, v3, v3);
+    }
+    if (i < ilength)
+    {
+        // remaining 8 samples
+        float32x4_t v0 = vld1q_f32(pV1 + i);
+        float32x4_t v1 = vld1q_f32(pV1 + i + 4);
+
+        vCorr0 = neonMulAdd(vCorr0, v0, vld1q_f32(pV2 + i));
+        vCorr1 = neonMulAdd(vCorr1, v1, vld1q_f32(pV2 + i + 4));
+        vNorm0 = neonMulAdd(vNorm0, v0, v0);
+        vNorm1 = neonMulAdd(vNorm1, v1, v1);
+    }
+
+    float corr = neonSum(vaddq_f32(vaddq_f32(vCorr0, vCorr1), vaddq_f32(vCorr2, vCorr3)));
+    float norm = neonSum(vaddq_f32(vaddq_f32(vNorm0, vNorm1), vaddq_f32(vNorm2, vNorm3)));
+
+    anorm = norm;
+    return corr / sqrt((norm < 1e-9 ? 1.0 : norm));
+}
+
+
+// Update cross-correlation by accumulating "norm" coefficient by previously calculated value
+double TDStretchNEON::calcCrossCorrAccumulate(const float *pV1, const float *pV2, double &norm)
+{
+    int ilength = (channels * overlapLength) & -8;
+    int i;
+
+    // cancel first normalizer tap from previous round
+    for (i = 1; i <= channels; i ++)
+    {
+        norm -= pV1[-i] * pV1[-i];
+    }
+
+    float32x4_t vCorr0 = vdupq_n_f32(0), vCorr1 = vdupq_n_f32(0);
+    float32x4_t vCorr2 = vdupq_n_f32(0), vCorr3 = vdupq_n_f32(0);
+
+    for (i = 0; i + 16 <= ilength; i += 16)
+    {
+        vCorr0 = neonMulAdd(vCorr0, vld1q_f32(pV1 + i), vld1q_f32(pV2 + i));
+        vCorr1 = neonMulAdd(vCorr1, vld1q_f32(pV1 + i + 4), vld1q_f32(pV2 + i + 4));
+        vCorr2 = neonMulAdd(vCorr2, vld1q_f32(pV1 + i + 8), vld1q_f32(pV2 + i + 8));
+        vCorr3 = neonMulAdd(vCorr3, vld1q_f32(pV1 + i + 12), vld1q_f32(pV2 + i + 12));
+    }
+    if (i < ilength)
+    {
+        vCorr0 = neonMulAdd(vCorr0, vld1q_f32(pV1 + i), vld1q_f32(pV2 + i));
+        vCorr1 = neonMulAdd(vCorr1, vld1q_f32(pV1 + i + 4), vld1q_f32(pV2 + i + 4));
+    }
+
+    float corr = neonSum(vaddq_f32(vaddq_f32(vCorr0, vCorr1), vaddq_f32(vCorr2, vCorr3)));
+
+    // update normalizer with last samples of this round
+    for (int j = 1; j <= channels; j ++)
+    {
+        norm += pV1[ilength - j] * pV1[ilength - j];
+    }
+
+    return corr / sqrt((norm < 1e-9 ? 1.0 : norm));
+}
+
+
+// Overlaps samples in 'midBuffer' with the samples in 'pInput'. One vector
+// holds the integer weights of four consecutive samples.
+void TDStretchNEON::overlapMono(float *pOutput, const float *pInput) const
+{
+    static const float ramp[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    const float32x4_t vScale = vdupq_n_f32(1.0f / (float)overlapLength);
+    const float32x4_t vStep = vdupq_n_f32(4.0f);
+    const float32x4_t vLength = vdupq_n_f32((float)overlapLength);
+    float32x4_t vM1 = vld1q_f32(ramp);
+
+    // overlapLength is divisible by 8
+    for (int i = 0; i < overlapLength; i += 4)
+    {
+        float32x4_t vM2 = vsubq_f32(vLength, vM1);
+        float32x4_t sum = vmulq_f32(vld1q_f32(pMidBuffer + i), vM2);
+        sum = neonMulAdd(sum, vld1q_f32(pInput + i), vM1);
+        vst1q_f32(pOutput + i, vmulq_f32(sum, vScale));
+        vM1 = vaddq_f32(vM1, vStep);
+    }
+}
+
+
+// Overlaps samples in 'midBuffer' with the samples in 'pInput'. The 'Stereo'
+// version of the routine; each vector holds two stereo frames.
+void TDStretchNEON::overlapStereo(float *pOutput, const float *pInput) const
+{
+    static const float ramp[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+    const float fScale = 1.0f / (float)overlapLength;
+    const float32x4_t vStep = vdupq_n_f32(2.0f * fScale);
+    const float32x4_t vOne = vdupq_n_f32(1.0f);
+    float32x4_t vF1 = vmulq_f32(vld1q_f32(ramp), vdupq_n_f32(fScale));
+
+    for (int i = 0; i < 2 * overlapLength; i += 4)
+    {
+        float32x4_t vF2 = vsubq_f32(vOne, vF1);
+        float32x4_t sum = vmulq_f32(vld1q_f32(pMidBuffer + i), vF2);
+        sum = neonMulAdd(sum, vld1q_f32(pInput + i), vF1);
+        vst1q_f32(pOutput + i, sum);
+        vF1 = vaddq_f32(vF1, vStep);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of NEON optimized functions of class 'FIRFilterNEON'
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Filters 16 consecutive mono samples at a time: each tap coefficient is
+// broadcast and multiplied with four vectors of source samples, so that the
+// four accumulators are independent and no horizontal sums are needed.
+uint FIRFilterNEON::evaluateFilterMono(float *dest, const float *src, uint numSamples) const
+{
+    assert(length != 0);
+    assert(src != nullptr);
+    assert(dest != nullptr);
+    assert(filterCoeffs != nullptr);
+
+    int end = (int)(numSamples - length);
+    int j;
+
+    #pragma omp parallel for
+    for (j = 0; j < (end & -16); j += 16)
+    {
+        const float *pSrc = src + j;
+        float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+        float32x4_t sum2 = vdupq_n_f32(0), sum3 = vdupq_n_f32(0);
+
+        for (uint i = 0; i < length; i ++)
+        {
+            float32x4_t coeff = vdupq_n_f32(filterCoeffs[i]);
+            sum0 = neonMulAdd(sum0, vld1q_f32(pSrc + i), coeff);
+            sum1 = neonMulAdd(sum1, vld1q_f32(pSrc + i + 4), coeff);
+            sum2 = neonMulAdd(sum2, vld1q_f32(pSrc + i + 8), coeff);
+            sum3 = neonMulAdd(sum3, vld1q_f32(pSrc + i + 12), coeff);
+        }
+        vst1q_f32(dest + j, sum0);
+        vst1q_f32(dest + j + 4, sum1);
+        vst1q_f32(dest + j + 8, sum2);
+        vst1q_f32(dest + j + 12, sum3);
+    }
+
+    for (j = end & -16; j < end; j ++)
+    {
+        const float *pSrc = src + j;
+        float32x4_t sum = vdupq_n_f32(0);
+
+        // length is divisible by 8
+        for (uint i = 0; i < length; i += 4)
+        {
+            sum = neonMulAdd(sum, vld1q_f32(pSrc + i), vld1q_f32(filterCoeffs + i));
+        }
+        dest[j] = neonSum(sum);
+    }
+    return (uint)end;
+}
+
+
+// Same as the mono routine for interleaved stereo: a vector holds two frames
+// of both channels, so four accumulators cover eight output frames.
+uint FIRFilterNEON::evaluateFilterStereo(float *dest, const float *src, uint numSamples) const
+{
+    assert(length != 0);
+    assert(src != nullptr);
+    assert(dest != nullptr);
+    assert(filterCoeffs != nullptr);
+    assert(numSamples >= length);
+
+    int end = (int)(numSamples - length);
+    int j;
+
+    #pragma omp parallel for
+    for (j = 0; j < (end & -8); j += 8)
+    {
+        const float *pSrc = src + 2 * j;
+        float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+        float32x4_t sum2 = vdupq_n_f32(0), sum3 = vdupq_n_f32(0);
+
+        for (uint i = 0; i < length; i ++)
+        {
+            float32x4_t coeff = vdupq_n_f32(filterCoeffs[i]);
+            const float *ptr = pSrc + 2 * i;
+            sum0 = neonMulAdd(sum0, vld1q_f32(ptr), coeff);
+            sum1 = neonMulAdd(sum1, vld1q_f32(ptr + 4), coeff);
+            sum2 = neonMulAdd(sum2, vld1q_f32(ptr + 8), coeff);
+            sum3 = neonMulAdd(sum3, vld1q_f32(ptr + 12), coeff);
+        }
+        float *pDest = dest + 2 * j;
+        vst1q_f32(pDest, sum0);
+        vst1q_f32(pDest + 4, sum1);
+        vst1q_f32(pDest + 8, sum2);
+        vst1q_f32(pDest + 12, sum3);
+    }
+
+    for (j = end & -8; j < end; j ++)
+    {
+        const float *pSrc = src + 2 * j;
+        float32x4_t sum = vdupq_n_f32(0);
+
+        // two taps of both channels per vector
+        for (uint i = 0; i < 2 * length; i += 4)
+        {
+            sum = neonMulAdd(sum, vld1q_f32(pSrc + i), vld1q_f32(filterCoeffsStereo + i));
+        }
+        float32x2_t lr = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+        dest[2 * j] = vget_lane_f32(lr, 0);
+        dest[2 * j + 1] = vget_lane_f32(lr, 1);
+    }
+    return (uint)end;
+}
+
+#endif  // SOUNDTOUCH_ALLOW_NEON
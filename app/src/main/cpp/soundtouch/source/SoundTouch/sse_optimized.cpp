@@ -132,6 +132,19 @@ double TDStretchSSE::calcCrossCorr(const float *pV1, const float *pV2, double &a
         pVec2 += 4;
     }
 
+    // Mono overlapLength is divisible by 8 only, so 8 samples may remain
+    if ((channels * overlapLength) & 8)
+    {
+        __m128 vTemp;
+        vTemp = _MM_LOAD(pVec1);
+        vSum  = _mm_add_ps(vSum,  _mm_mul_ps(vTemp ,pVec2[0]));
+        vNorm = _mm_add_ps(vNorm, _mm_mul_ps(vTemp ,vTemp));
+
+        vTemp = _MM_LOAD(pVec1 + 4);
+        vSum  = _mm_add_ps(vSum, _mm_mul_ps(vTemp, pVec2[1]));
+        vNorm = _mm_add_ps(vNorm, _mm_mul_ps(vTemp ,vTemp));
+    }
+
     // return value = vSum[0] + vSum[1] + vSum[2] + vSum[3]
     float *pvNorm = (float*)&vNorm;
     float norm = (pvNorm[0] + pvNorm[1] + pvNorm[2] + pvNorm[3]);
@@ -211,14 +224,19 @@ FIRFilterSSE::~FIRFilterSSE()
 // (overloaded) Calculates filter coefficients for SSE routine
 void FIRFilterSSE::setCoefficients(const float *coeffs, uint newLength, uint uResultDivFactor)
 {
+    const uint prevLength = length;
+
     FIRFilter::setCoefficients(coeffs, newLength, uResultDivFactor);
 
     // Scale the filter coefficients so that it won't be necessary to scale the filtering result
     // also rearrange coefficients suitably for SSE
     // Ensure that filter coeffs array is aligned to 16-byte boundary
-    delete[] filterCoeffsUnalign;
-    filterCoeffsUnalign = new float[2 * newLength + 4];
-    filterCoeffsAlign = (float *)SOUNDTOUCH_ALIGN_POINTER_16(filterCoeffsUnalign);
+    if ((newLength != prevLength) || (filterCoeffsUnalign == nullptr))
+    {
+        delete[] filterCoeffsUnalign;
+        filterCoeffsUnalign = new float[2 * newLength + 4];
+        filterCoeffsAlign = (float *)SOUNDTOUCH_ALIGN_POINTER_16(filterCoeffsUnalign);
+    }
 
     const float scale = ::pow(0.5, (int)resultDivFactor);
 
@@ -359,4 +377,113 @@ uint FIRFilterSSE::evaluateFilterStereo(float *dest, const float *source, uint n
     */
 }
 
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of SSE2 optimized sample format conversion routines
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "SampleConvertSIMD.h"
+
+#ifdef SOUNDTOUCH_ALLOW_SSE2
+
+#include <emmintrin.h>
+
+// Saturates scaled samples to given range and truncates them to integers
+static inline __m128i sse2Saturate(__m128 v, __m128 vMin, __m128 vMax)
+{
+    return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, vMin), vMax));
+}
+
+
+// Triangular noise from four xorshift32 lanes, see 'tpdfNoise' in SampleConvert.cpp
+static inline __m128 sse2TpdfNoise(__m128i &state)
+{
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+    state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+
+    __m128i hi = _mm_srli_epi32(state, 16);
+    __m128i lo = _mm_and_si128(state, _mm_set1_epi32(0xffff));
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(hi, lo)), _mm_set1_ps(1.0f / 65536.0f));
+}
+
+
+uint soundtouch::convertFloatToInt16SSE2(const float *src, short *dest, uint numSamples)
+{
+    const __m128 vScale = _mm_set1_ps(32768.0f);
+    const __m128 vMin = _mm_set1_ps(-32768.0f);
+    const __m128 vMax = _mm_set1_ps(32767.0f);
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 8)
+    {
+        __m128i lo = sse2Saturate(_mm_mul_ps(_mm_loadu_ps(src + i), vScale), vMin, vMax);
+        __m128i hi = sse2Saturate(_mm_mul_ps(_mm_loadu_ps(src + i + 4), vScale), vMin, vMax);
+        _mm_storeu_si128((__m128i *)(dest + i), _mm_packs_epi32(lo, hi));
+    }
+    return count;
+}
+
+
+uint soundtouch::convertFloatToInt16DitherSSE2(const float *src, short *dest, uint numSamples, DitherState &dither)
+{
+    const __m128 vScale = _mm_set1_ps(32768.0f);
+    const __m128 vMin = _mm_set1_ps(-32768.0f);
+    const __m128 vMax = _mm_set1_ps(32767.0f);
+    __m128i state0 = _mm_loadu_si128((const __m128i *)dither.lane);
+    __m128i state1 = _mm_loadu_si128((const __m128i *)(dither.lane + 4));
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 8)
+    {
+        __m128 v0 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), vScale), sse2TpdfNoise(state0));
+        __m128 v1 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), vScale), sse2TpdfNoise(state1));
+        _mm_storeu_si128((__m128i *)(dest + i),
+                         _mm_packs_epi32(sse2Saturate(v0, vMin, vMax), sse2Saturate(v1, vMin, vMax)));
+    }
+
+    _mm_storeu_si128((__m128i *)dither.lane, state0);
+    _mm_storeu_si128((__m128i *)(dither.lane + 4), state1);
+    return count;
+}
+
+
+uint soundtouch::convertInt16ToFloatSSE2(const short *src, float *dest, uint numSamples)
+{
+    const __m128 vScale = _mm_set1_ps(1.0f / 32768.0f);
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        // sign-extend by placing the 16bit values in the upper halves and shifting down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vScale));
+        _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vScale));
+    }
+    return count;
+}
+
+
+uint soundtouch::convertFloatToInt24SSE2(const float *src, int *dest, uint numSamples)
+{
+    const __m128 vScale = _mm_set1_ps(8388608.0f);
+    const __m128 vMin = _mm_set1_ps(-8388608.0f);
+    const __m128 vMax = _mm_set1_ps(8388607.0f);
+    uint count = numSamples & ~(uint)7;
+
+    for (uint i = 0; i < count; i += 4)
+    {
+        __m128i v = sse2Saturate(_mm_mul_ps(_mm_loadu_ps(src + i), vScale), vMin, vMax);
+        _mm_storeu_si128((__m128i *)(dest + i), v);
+    }
+    return count;
+}
+
+#endif  // SOUNDTOUCH_ALLOW_SSE2
+
 #endif  // SOUNDTOUCH_ALLOW_SSE
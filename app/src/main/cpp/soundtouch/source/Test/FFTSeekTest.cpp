@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Test of the FFT based overlap position seek against the plain full seek.
+/// Both score every offset of the seek window with the same criterion, so they
+/// must pick the same offset; the test runs them on tones, a chirp, noise & a
+/// pulse train, mono & stereo, at several seek window & overlap lengths.
+///
+/// The FFT seek is available with floating point samples only.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "TDStretch.h"
+
+using namespace soundtouch;
+
+#ifdef SOUNDTOUCH_FLOAT_SAMPLES
+
+/// Runs the seek routines of the C++ TDStretch on given input
+class SeekTester : public TDStretch
+{
+public:
+    SeekTester(int channels, int sampleRate, int seekWindowMs, int overlapMs)
+    {
+        setChannels(channels);
+        setParameters(sampleRate, 40, seekWindowMs, overlapMs);
+        enableFFTSeek(true);
+    }
+
+    int seekFrames() const
+    {
+        return seekLength;
+    }
+
+    int overlapFrames() const
+    {
+        return overlapLength;
+    }
+
+    /// Best offset in 'refPos' to mix the 'overlapLength' frames of 'mid' at
+    int seek(const SAMPLETYPE *refPos, const SAMPLETYPE *mid, bool fft)
+    {
+        memcpy(pMidBuffer, mid, channels * overlapLength * sizeof(SAMPLETYPE));
+        return fft ? seekBestOverlapPositionFFT(refPos) : seekBestOverlapPositionFull(refPos);
+    }
+};
+
+
+static const char *SIGNALS[] = {"sine", "two tones", "chirp", "noise", "pulse train", "noisy sine"};
+static const int NUM_SIGNALS = sizeof(SIGNALS) / sizeof(SIGNALS[0]);
+
+
+/// Two seconds of test signal 'kind'; the second channel is the first one
+/// delayed by a few frames & scaled down
+static std::vector<SAMPLETYPE> testSignal(int kind, int channels, int sampleRate)
+{
+    const int frames = 2 * sampleRate;
+    std::vector<float> mono(frames + 16);
+    unsigned int seed = 12345;
+
+    for (int i = 0; i < frames + 16; i ++)
+    {
+        const double t = (double)i / sampleRate;
+        seed = seed * 1664525u + 1013904223u;
+        const double noise = (double)((int)(seed >> 8) - 0x800000) / 0x800000;
+
+        switch (kind)
+        {
+            case 0:
+                mono[i] = (float)(0.5 * sin(2 * M_PI * 440 * t));
+                break;
+            case 1:
+                mono[i] = (float)(0.4 * sin(2 * M_PI * 220 * t) + 0.3 * sin(2 * M_PI * 331 * t + 1));
+                break;
+            case 2:
+                // 100 Hz rising to 4 kHz
+                mono[i] = (float)(0.5 * sin(2 * M_PI * (100 * t + 975 * t * t)));
+                break;
+            case 3:
+                mono[i] = (float)(0.5 * noise);
+                break;
+            case 4:
+                // 150 Hz pulses of 1 ms
+                mono[i] = (fmod(t * 150, 1.0) < 0.15) ? 0.8f : -0.1f;
+                break;
+            default:
+                mono[i] = (float)(0.5 * sin(2 * M_PI * 180 * t) + 0.2 * noise);
+                break;
+        }
+    }
+
+    std::vector<SAMPLETYPE> signal(frames * channels);
+    for (int i = 0; i < frames; i ++)
+    {
+        signal[i * channels] = mono[i + 16];
+        if (channels == 2)
+        {
+            signal[i * channels + 1] = 0.7f * mono[i + 16 - 5];
+        }
+    }
+    return signal;
+}
+
+
+/// Seeks with both routines from positions spread over the signal, with the
+/// overlap taken a varying distance after the position, & counts the offsets
+/// that differ
+static int runSeeks(int kind, int channels, int sampleRate, int seekWindowMs, int overlapMs)
+{
+    SeekTester st(channels, sampleRate, seekWindowMs, overlapMs);
+    const std::vector<SAMPLETYPE> signal = testSignal(kind, channels, sampleRate);
+    const int seekFrames = st.seekFrames();
+    const int overlapFrames = st.overlapFrames();
+    const int span = seekFrames - 1 + overlapFrames;
+    const int positions = 40;
+    int failures = 0;
+
+    for (int n = 0; n < positions; n ++)
+    {
+        const int pos = n * ((int)signal.size() / channels - 2 * span) / positions;
+        const int midPos = pos + (n * 37) % (2 * seekFrames);
+        const SAMPLETYPE *refPos = signal.data() + channels * pos;
+        const SAMPLETYPE *mid = signal.data() + channels * midPos;
+
+        const int full = st.seek(refPos, mid, false);
+        const int fft = st.seek(refPos, mid, true);
+        if (full != fft)
+        {
+            printf("FAIL %s, %d ch, %d Hz, seek %d ms, overlap %d ms, position %d: "
+                   "FFT offset %d, full seek offset %d\n",
+                   SIGNALS[kind], channels, sampleRate, seekWindowMs, overlapMs, pos, fft, full);
+            failures ++;
+        }
+    }
+    return failures;
+}
+
+
+int main()
+{
+    struct Parameters
+    {
+        int sampleRate;
+        int seekWindowMs;
+        int overlapMs;
+    };
+    static const Parameters parameters[] =
+    {
+        {48000, 15, 8},
+        {44100, 25, 12},
+        {22050, 10, 4},
+        {8000, 30, 8},
+    };
+    int failures = 0;
+
+    for (const Parameters &p : parameters)
+    {
+        for (int channels = 1; channels <= 2; channels ++)
+        {
+            for (int kind = 0; kind < NUM_SIGNALS; kind ++)
+            {
+                failures += runSeeks(kind, channels, p.sampleRate, p.seekWindowMs, p.overlapMs);
+            }
+        }
+    }
+
+    printf(failures ? "FAILED\n" : "PASSED\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#else
+
+int main()
+{
+    printf("FFT seek is available with floating point samples only\nPASSED\n");
+    return EXIT_SUCCESS;
+}
+
+#endif // SOUNDTOUCH_FLOAT_SAMPLES
@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Regression test of the PSOLA tempo changer at large upward pitch shifts.
+/// These slow the tempo to a half or less, so that the grains at the first pitch
+/// marks are repeated before the input reaches far enough past them; this once
+/// read input before the start of the buffer. The library's asserts check the
+/// grain bounds, and the output is checked to be at the shifted pitch.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "SoundTouch.h"
+
+using namespace soundtouch;
+
+static const int SAMPLE_RATE = 48000;
+static const double INPUT_HZ = 140.0;
+
+
+/// Shifts two seconds of a tone by 'semitones' in blocks of 'blockFrames', as
+/// an audio callback would, & checks the output. Starts over once after a
+/// 'clear', which puts the marks back at the beginning of the input.
+static int runShift(double semitones, int channels, uint blockFrames)
+{
+    SoundTouch st;
+    std::vector<SAMPLETYPE> input(blockFrames * channels);
+    std::vector<SAMPLETYPE> output(8192 * channels);
+    int failures = 0;
+
+    st.setSampleRate(SAMPLE_RATE);
+    st.setChannels(channels);
+    st.setSetting(SETTING_TEMPO_ENGINE, TEMPO_ENGINE_PSOLA);
+    st.setPitchSemiTones(semitones);
+
+    for (int pass = 0; pass < 2; pass ++)
+    {
+        std::vector<float> mono;
+        double phase = 0;
+
+        st.clear();
+        for (int frames = 0; frames < 2 * SAMPLE_RATE; frames += blockFrames)
+        {
+            for (uint i = 0; i < blockFrames; i ++)
+            {
+                phase += 2 * M_PI * INPUT_HZ / SAMPLE_RATE;
+                for (int c = 0; c < channels; c ++)
+                {
+                    input[i * channels + c] = (SAMPLETYPE)(16000 * sin(phase));
+                }
+            }
+            st.putSamples(input.data(), blockFrames);
+
+            uint received;
+            while ((received = st.receiveSamples(output.data(), 8192)) > 0)
+            {
+                for (uint i = 0; i < received; i ++)
+                {
+                    mono.push_back((float)output[i * channels]);
+                }
+            }
+        }
+
+        // Count the rising zero crossings past the first half second, where the
+        // output has settled, to get its frequency
+        const size_t begin = SAMPLE_RATE / 2;
+        int crossings = 0;
+        size_t first = 0;
+        size_t last = 0;
+        bool finite = true;
+        for (size_t i = begin; i < mono.size(); i ++)
+        {
+            finite = finite && std::isfinite(mono[i]);
+            if ((mono[i - 1] < 0) && (mono[i] >= 0))
+            {
+                if (crossings == 0) first = i;
+                last = i;
+                crossings ++;
+            }
+        }
+
+        const double expected = INPUT_HZ * pow(2.0, semitones / 12.0);
+        const double measured = (crossings > 1) ? (crossings - 1) * (double)SAMPLE_RATE / (last - first) : 0;
+        if (!finite || (fabs(measured / expected - 1) > 0.03))
+        {
+            printf("FAIL %+g semitones, %d ch, %u frames, pass %d: %.1f Hz, expected %.1f Hz%s\n",
+                   semitones, channels, blockFrames, pass, measured, expected,
+                   finite ? "" : ", non-finite output");
+            failures ++;
+        }
+    }
+    return failures;
+}
+
+
+int main()
+{
+    int failures = 0;
+
+    for (double semitones : {12.0, 16.0})
+    {
+        for (int channels = 1; channels <= 2; channels ++)
+        {
+            for (uint blockFrames : {64u, 192u, 1024u})
+            {
+                failures += runShift(semitones, channels, blockFrames);
+            }
+        }
+    }
+
+    printf(failures ? "FAILED\n" : "PASSED\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Test of the phase vocoder tempo changer. Stretches two seconds of a tone
+/// to several tempos in blocks as an audio callback would, and checks that the
+/// output length is the input length divided by the tempo, less the latency of
+/// about a frame before the flush, and that the tone keeps its frequency &
+/// level.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "SoundTouch.h"
+
+using namespace soundtouch;
+
+static const int SAMPLE_RATE = 48000;
+static const int INPUT_FRAMES = 2 * SAMPLE_RATE;
+static const double INPUT_HZ = 440.0;
+
+/// Input the vocoder may hold back until flushed: its 40 ms frame plus margin
+static const int MAX_LATENCY_FRAMES = SAMPLE_RATE / 20;
+
+
+/// Changes the tempo of a tone in blocks of 'blockFrames' & checks the output
+static int runTempo(double tempo, int channels, uint blockFrames)
+{
+    SoundTouch st;
+    std::vector<SAMPLETYPE> input(blockFrames * channels);
+    std::vector<SAMPLETYPE> output(8192 * channels);
+    std::vector<float> mono;
+    double phase = 0;
+    int failures = 0;
+
+    st.setSampleRate(SAMPLE_RATE);
+    st.setChannels(channels);
+    st.setSetting(SETTING_TEMPO_ENGINE, TEMPO_ENGINE_PHASE_VOCODER);
+    st.setTempo(tempo);
+
+    for (int frames = 0; frames < INPUT_FRAMES; frames += blockFrames)
+    {
+        const uint count = (uint)((INPUT_FRAMES - frames < (int)blockFrames) ? INPUT_FRAMES - frames : blockFrames);
+        for (uint i = 0; i < count; i ++)
+        {
+            phase += 2 * M_PI * INPUT_HZ / SAMPLE_RATE;
+            for (int c = 0; c < channels; c ++)
+            {
+                input[i * channels + c] = (SAMPLETYPE)(16000 * sin(phase));
+            }
+        }
+        st.putSamples(input.data(), count);
+
+        uint received;
+        while ((received = st.receiveSamples(output.data(), 8192)) > 0)
+        {
+            for (uint i = 0; i < received; i ++)
+            {
+                mono.push_back((float)output[i * channels]);
+            }
+        }
+    }
+
+    const double expectedFrames = INPUT_FRAMES / tempo;
+    const double minFrames = (INPUT_FRAMES - MAX_LATENCY_FRAMES) / tempo;
+    if ((mono.size() < minFrames) || (mono.size() > expectedFrames))
+    {
+        printf("FAIL tempo %g, %d ch, %u frames: %u output frames before flush, expected %.0f to %.0f\n",
+               tempo, channels, blockFrames, (uint)mono.size(), minFrames, expectedFrames);
+        failures ++;
+    }
+
+    st.flush();
+    uint received;
+    while ((received = st.receiveSamples(output.data(), 8192)) > 0)
+    {
+        for (uint i = 0; i < received; i ++)
+        {
+            mono.push_back((float)output[i * channels]);
+        }
+    }
+
+    if (fabs(mono.size() / expectedFrames - 1) > 0.01)
+    {
+        printf("FAIL tempo %g, %d ch, %u frames: %u output frames, expected %.0f\n",
+               tempo, channels, blockFrames, (uint)mono.size(), expectedFrames);
+        failures ++;
+    }
+
+    // Count the rising zero crossings past the first quarter second, where the
+    // output has settled, up to the last quarter second, which holds the flush
+    // padding, to get its frequency
+    const size_t begin = SAMPLE_RATE / 4;
+    const size_t end = (mono.size() > begin + SAMPLE_RATE / 4) ? mono.size() - SAMPLE_RATE / 4 : begin;
+    int crossings = 0;
+    size_t first = 0;
+    size_t last = 0;
+    bool finite = true;
+    double energy = 0;
+    for (size_t i = begin; i < end; i ++)
+    {
+        finite = finite && std::isfinite(mono[i]);
+        energy += (double)mono[i] * mono[i];
+        if ((mono[i - 1] < 0) && (mono[i] >= 0))
+        {
+            if (crossings == 0) first = i;
+            last = i;
+            crossings ++;
+        }
+    }
+
+    const double measured = (crossings > 1) ? (crossings - 1) * (double)SAMPLE_RATE / (last - first) : 0;
+    if (!finite || (fabs(measured / INPUT_HZ - 1) > 0.01))
+    {
+        printf("FAIL tempo %g, %d ch, %u frames: %.1f Hz, expected %.1f Hz%s\n",
+               tempo, channels, blockFrames, measured, INPUT_HZ,
+               finite ? "" : ", non-finite output");
+        failures ++;
+    }
+
+    // The input RMS is 16000 / sqrt(2)
+    const double rms = (end > begin) ? sqrt(energy / (end - begin)) : 0;
+    if (fabs(rms / (16000 / sqrt(2.0)) - 1) > 0.05)
+    {
+        printf("FAIL tempo %g, %d ch, %u frames: RMS %.0f, expected %.0f\n",
+               tempo, channels, blockFrames, rms, 16000 / sqrt(2.0));
+        failures ++;
+    }
+    return failures;
+}
+
+
+int main()
+{
+    int failures = 0;
+
+    for (double tempo : {0.5, 0.8, 1.25, 2.0})
+    {
+        for (int channels = 1; channels <= 2; channels ++)
+        {
+            for (uint blockFrames : {64u, 192u, 1024u})
+            {
+                failures += runTempo(tempo, channels, blockFrames);
+            }
+        }
+    }
+
+    printf(failures ? "FAILED\n" : "PASSED\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
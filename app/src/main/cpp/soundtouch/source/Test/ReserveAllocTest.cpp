@@ -0,0 +1,355 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Checks that SoundTouch doesn't allocate or free memory in 'putSamples',
+/// 'receiveSamples' & the setters once 'reserve' has sized its buffers, so that
+/// it can run in a real-time audio callback. The global operator new & delete
+/// are replaced to count calls, and on Linux malloc, calloc, realloc & free are
+/// also wrapped through the linker to catch the C allocator.
+///
+/// Pitch is changed across 1.0, where the rate transposer changes from before
+/// the tempo changer to after it, and the tempo engine is switched while
+/// processing. Last, going past the reservation is checked to be refused with
+/// a false return instead of an exception or allocation.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include "SoundTouch.h"
+
+using namespace soundtouch;
+
+/// Allocations & frees are counted while this is set
+static bool armed = false;
+static long allocCount = 0;
+
+#ifdef SOUNDTOUCH_TEST_WRAP_MALLOC
+
+// Linked with -Wl,--wrap=malloc etc., so that the calls in the library & here
+// come to these functions, and the real ones are reached as __real_...
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+    void __real_free(void *ptr);
+
+    void *__wrap_malloc(size_t size)
+    {
+        if (armed) allocCount ++;
+        return __real_malloc(size);
+    }
+
+    void *__wrap_calloc(size_t count, size_t size)
+    {
+        if (armed) allocCount ++;
+        return __real_calloc(count, size);
+    }
+
+    void *__wrap_realloc(void *ptr, size_t size)
+    {
+        if (armed) allocCount ++;
+        return __real_realloc(ptr, size);
+    }
+
+    void __wrap_free(void *ptr)
+    {
+        if (armed && ptr) allocCount ++;
+        __real_free(ptr);
+    }
+}
+
+#define RAW_MALLOC  __real_malloc
+#define RAW_FREE    __real_free
+
+#else
+
+#define RAW_MALLOC  malloc
+#define RAW_FREE    free
+
+#endif // SOUNDTOUCH_TEST_WRAP_MALLOC
+
+
+static void *countedNew(size_t size)
+{
+    if (armed) allocCount ++;
+    void *ptr = RAW_MALLOC(size ? size : 1);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+static void countedDelete(void *ptr)
+{
+    if (armed && ptr) allocCount ++;
+    RAW_FREE(ptr);
+}
+
+void *operator new(size_t size) { return countedNew(size); }
+void *operator new[](size_t size) { return countedNew(size); }
+void operator delete(void *ptr) noexcept { countedDelete(ptr); }
+void operator delete[](void *ptr) noexcept { countedDelete(ptr); }
+void operator delete(void *ptr, size_t) noexcept { countedDelete(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { countedDelete(ptr); }
+
+
+static unsigned int randomState = 12345;
+
+/// Uniform random number in 0..1, the same sequence on every run
+static double random01()
+{
+    randomState = randomState * 1103515245 + 12345;
+    return ((randomState >> 8) & 0xffff) / 65535.0;
+}
+
+
+enum TestMode
+{
+    MODE_APP_SETTINGS,      ///< WSOLA with FFT & predictive seek in low-latency mode
+    MODE_MULTIRES_SEEK,     ///< WSOLA with the coarse-to-fine seek
+    MODE_PSOLA,
+    MODE_PHASE_VOCODER,
+    MODE_ENGINE_SWITCH,     ///< app settings, switching the engine every now & then
+    MODE_COUNT
+};
+
+static const char *modeNames[MODE_COUNT] =
+{
+    "app settings", "multires seek", "PSOLA", "phase vocoder", "engine switch"
+};
+
+
+/// Feeds a voice-like signal through a reserved SoundTouch instance, changing
+/// the settings along, & returns the number of allocations seen meanwhile.
+///
+/// 'callbackLike' gives blocks of about 'blockFrames' & takes as many out, as
+/// the audio callback of a full-duplex stream does, with pitch changes across
+/// 1.0. Otherwise the blocks are of random length, all of the output is taken
+/// every time & tempo & rate change at random.
+static long runStream(TestMode mode, int channels, uint blockFrames, bool callbackLike)
+{
+    SoundTouch st;
+
+    st.setSampleRate(48000);
+    st.setChannels(channels);
+    if (mode == MODE_APP_SETTINGS || mode == MODE_ENGINE_SWITCH)
+    {
+        st.setSetting(SETTING_USE_AA_FILTER, 0);
+        st.setSetting(SETTING_SEQUENCE_MS, 20);
+        st.setSetting(SETTING_SEEKWINDOW_MS, 10);
+        st.setSetting(SETTING_OVERLAP_MS, 5);
+        st.setSetting(SETTING_USE_QUICKSEEK, 0);
+        st.setSetting(SETTING_USE_FFT_SEEK, 1);
+        st.setSetting(SETTING_USE_PREDICTIVE_SEEK, 1);
+        st.setSetting(SETTING_LOW_LATENCY_MS, 15);
+    }
+    else if (mode == MODE_MULTIRES_SEEK)
+    {
+        st.setSetting(SETTING_USE_MULTIRES_SEEK, 1);
+    }
+    else if (mode == MODE_PSOLA)
+    {
+        st.setSetting(SETTING_TEMPO_ENGINE, TEMPO_ENGINE_PSOLA);
+    }
+    else if (mode == MODE_PHASE_VOCODER)
+    {
+        st.setSetting(SETTING_TEMPO_ENGINE, TEMPO_ENGINE_PHASE_VOCODER);
+    }
+    st.setSetting(SETTING_PARAMETER_RAMP_MS, (mode == MODE_APP_SETTINGS) ? 0 : 20);
+    st.reserve(blockFrames, 2.0);
+
+    const uint maxOutput = 16 * blockFrames;
+    std::vector<SAMPLETYPE> input(blockFrames * channels);
+    std::vector<SAMPLETYPE> output(maxOutput * channels);
+    double phase = 0;
+    int pitchStep = 0;
+
+    armed = true;
+    for (int block = 0; block < 3000; block ++)
+    {
+        uint frames = callbackLike ? blockFrames - (uint)(random01() * 2.99) * (blockFrames / 4)
+                                   : 1 + (uint)(random01() * (blockFrames - 1));
+
+        for (uint i = 0; i < frames; i ++)
+        {
+            // harmonics of a gliding 120 Hz voice with some noise
+            phase += 2 * M_PI * (120 + 60 * sin(block * 0.01)) / 48000;
+            for (int c = 0; c < channels; c ++)
+            {
+                input[i * channels + c] = (SAMPLETYPE)(0.5 * sin(phase * (c + 1)) + 0.1 * (random01() - 0.5));
+            }
+        }
+
+        if (!st.tryPutSamples(input.data(), frames))
+        {
+            armed = false;
+            printf("  block of %u frames refused\n", frames);
+            return -1;
+        }
+        if (callbackLike)
+        {
+            st.receiveSamples(output.data(), frames);
+        }
+        else
+        {
+            while (st.numSamples()) st.receiveSamples(output.data(), maxOutput);
+        }
+
+        if (block % 17 == 0)
+        {
+            if (callbackLike)
+            {
+                // up, back to 1.0, down, 1.0, ... so that every change crosses or lands on 1.0
+                static const double pitches[4] = {1.25, 1.0, 0.8, 1.0};
+                st.setPitch(pitches[pitchStep ++ % 4] * (0.9 + 0.2 * random01()));
+            }
+            else
+            {
+                st.setTempo(exp((random01() * 2 - 1) * log(2.0)));
+                st.setRate(exp((random01() * 2 - 1) * log(2.0)));
+            }
+        }
+        if (block % 251 == 0 && mode != MODE_APP_SETTINGS)
+        {
+            st.setSetting(SETTING_USE_AA_FILTER, (block / 251) & 1);
+        }
+        if (block % 503 == 0 && mode == MODE_ENGINE_SWITCH)
+        {
+            st.setSetting(SETTING_TEMPO_ENGINE, (block / 503) % 3);
+        }
+        if (block % 701 == 700)
+        {
+            st.clear();
+        }
+        if (block % 997 == 996)
+        {
+            st.flush();
+            while (st.numSamples()) st.receiveSamples(output.data(), maxOutput);
+        }
+    }
+    armed = false;
+
+    return allocCount;
+}
+
+
+/// Going past the reservation must return false, not throw or allocate
+static int checkRefusals()
+{
+    SoundTouch st;
+    std::vector<SAMPLETYPE> input(1024, 0);
+    int failures = 0;
+
+    st.setSampleRate(48000);
+    st.setChannels(1);
+    st.reserve(256, 2.0);
+
+    armed = true;
+    if (st.tryPutSamples(input.data(), 257))
+    {
+        printf("  a block over the reservation was accepted\n");
+        failures ++;
+    }
+    if (st.setTempo(2.5))
+    {
+        printf("  a tempo over the reserved ratio was accepted\n");
+        failures ++;
+    }
+    if (!st.setPitch(1.5))
+    {
+        printf("  a pitch within the reserved ratio was refused\n");
+        failures ++;
+    }
+
+    // Output left unreceived piles up until the backlog is refused
+    bool refused = false;
+    for (int i = 0; i < 1000 && !refused; i ++)
+    {
+        refused = !st.tryPutSamples(input.data(), 256);
+    }
+    if (!refused)
+    {
+        printf("  output piled up past the reservation\n");
+        failures ++;
+    }
+    armed = false;
+
+    if (allocCount != 0)
+    {
+        printf("  %ld allocations while refusing\n", allocCount);
+        failures ++;
+    }
+    allocCount = 0;
+
+    try
+    {
+        st.putSamples(input.data(), 257);
+        printf("  putSamples didn't throw for a block over the reservation\n");
+        failures ++;
+    }
+    catch (const std::runtime_error &)
+    {
+    }
+    return failures;
+}
+
+
+int main()
+{
+    int failures = 0;
+
+    for (uint blockFrames : {64u, 192u, 1024u, 4096u})
+    {
+        for (int channels = 1; channels <= 2; channels ++)
+        {
+            for (int mode = 0; mode < MODE_COUNT; mode ++)
+            {
+                for (bool callbackLike : {true, false})
+                {
+                    long allocs = runStream((TestMode)mode, channels, blockFrames, callbackLike);
+                    if (allocs != 0)
+                    {
+                        printf("FAIL %s, %d ch, %u frames%s: %ld allocations\n", modeNames[mode],
+                               channels, blockFrames, callbackLike ? ", callback" : "", allocs);
+                        failures ++;
+                    }
+                    allocCount = 0;
+                }
+            }
+        }
+    }
+
+    int refusalFailures = checkRefusals();
+    if (refusalFailures)
+    {
+        printf("FAIL reservation overruns\n");
+        failures += refusalFailures;
+    }
+
+    printf(failures ? "FAILED\n" : "PASSED\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,402 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Tests of the SSE, AVX2, AVX-512 & NEON versions of the TDStretch
+/// cross-correlation & FIRFilter routines against the plain C++ ones. Each
+/// version is created through 'newInstance' with the wider extensions
+/// disabled, & its output must match the C++ output within the rounding of
+/// the different summation order. The lengths cover the remainders left over
+/// from the SIMD blocks.
+///
+/// Run with the argument 'benchmark' to also time each routine & version.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <typeinfo>
+#include <vector>
+#include "TDStretch.h"
+#include "FIRFilter.h"
+#include "cpu_detect.h"
+
+using namespace soundtouch;
+
+/// Versions of the routines to compare, by the extensions left enabled
+struct Version
+{
+    const char *name;
+    uint disabled;      ///< SUPPORT_... flags passed to 'disableExtensions'
+};
+
+static const Version versions[] =
+{
+    {"C++", 0xffffffff},
+#if defined(SOUNDTOUCH_INTEGER_SAMPLES)
+    #ifdef SOUNDTOUCH_ALLOW_X86_OPTIMIZATIONS
+    {"MMX", 0},
+    #endif
+#elif defined(SOUNDTOUCH_ALLOW_X86_OPTIMIZATIONS)
+    {"SSE", SUPPORT_AVX2 | SUPPORT_AVX512},
+    {"AVX2", SUPPORT_AVX512},
+    {"AVX-512", 0},
+#elif (defined(__arm__) || defined(__aarch64__))
+    // The library enables NEON for ARM targets unless built with NEON=OFF,
+    // in which case this repeats the C++ version
+    {"NEON", 0},
+#endif
+};
+static const int NUM_VERSIONS = sizeof(versions) / sizeof(versions[0]);
+
+
+/// Reaches the protected routines & state of the instances that 'newInstance'
+/// creates, through pointers to the members of the base class
+class StretchAccess : public TDStretch
+{
+public:
+    static double crossCorr(TDStretch *st, const SAMPLETYPE *mixingPos, const SAMPLETYPE *compare, double &norm)
+    {
+        return (st->*(&StretchAccess::calcCrossCorr))(mixingPos, compare, norm);
+    }
+
+    static double crossCorrAccumulate(TDStretch *st, const SAMPLETYPE *mixingPos, const SAMPLETYPE *compare, double &norm)
+    {
+        return (st->*(&StretchAccess::calcCrossCorrAccumulate))(mixingPos, compare, norm);
+    }
+
+    static void clearState(TDStretch *st)
+    {
+        (st->*(&StretchAccess::clearCrossCorrState))();
+    }
+
+    static int overlapSamples(TDStretch *st)
+    {
+        return st->*(&StretchAccess::overlapLength) * st->*(&StretchAccess::channels);
+    }
+};
+
+
+/// Creates the TDStretch & FIRFilter of a version
+static TDStretch *newStretch(const Version &version)
+{
+    disableExtensions(version.disabled);
+    TDStretch *st = TDStretch::newInstance();
+    disableExtensions(0);
+    return st;
+}
+
+static FIRFilter *newFilter(const Version &version)
+{
+    disableExtensions(version.disabled);
+    FIRFilter *filter = FIRFilter::newInstance();
+    disableExtensions(0);
+    return filter;
+}
+
+
+/// Test input in the sample range, the same sequence on every call
+static std::vector<SAMPLETYPE> randomInput(uint count, unsigned int seed)
+{
+    std::vector<SAMPLETYPE> values(count);
+
+    for (uint i = 0; i < count; i ++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        double value = (double)((int)(seed >> 8) - 0x800000) / 0x800000;
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+        values[i] = (SAMPLETYPE)(value * 16000);
+#else
+        values[i] = (SAMPLETYPE)value;
+#endif
+    }
+    return values;
+}
+
+
+static int failures = 0;
+
+static void fail(const char *routine, const char *version, const char *detail, double got, double expected)
+{
+    if (failures < 20)
+    {
+        printf("FAIL %s %s, %s: %g, expected %g\n", routine, version, detail, got, expected);
+    }
+    failures ++;
+}
+
+
+/// Single-precision sums of 'terms' products of magnitude 'scale' in another
+/// order differ by a few ulps of the largest partial sum
+static bool isClose(double got, double expected, double scale, int terms)
+{
+    return fabs(got - expected) <= 1e-6 * scale * terms + 1e-6 * fabs(expected);
+}
+
+
+static void testCrossCorr()
+{
+    // Overlaps of 2 to 17 blocks of 8 frames, mono & stereo; the sample rate
+    // picks the overlap length as 1 ms of it. Integer overlaps are powers of 2.
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+    static const int overlaps[] = {16, 32, 64, 128};
+#else
+    static const int overlaps[] = {16, 24, 40, 56, 64, 72, 96, 136};
+#endif
+    for (int channels = 1; channels <= 2; channels ++)
+    {
+        for (int overlap : overlaps)
+        {
+            char detail[64];
+            snprintf(detail, sizeof(detail), "%d ch, overlap %d", channels, overlap);
+
+            const int offsets = 67;
+            std::vector<SAMPLETYPE> mixing = randomInput((overlap + offsets + 1) * channels, 1);
+            std::vector<SAMPLETYPE> compare = randomInput(overlap * channels, 2);
+            std::vector<double> reference(2 * offsets);
+
+            for (int v = 0; v < NUM_VERSIONS; v ++)
+            {
+                std::unique_ptr<TDStretch> st(newStretch(versions[v]));
+                st->setChannels(channels);
+                st->setParameters(1000 * overlap, 40, 15, 1);
+                if (StretchAccess::overlapSamples(st.get()) != overlap * channels)
+                {
+                    fail("overlap length", versions[v].name, detail,
+                         StretchAccess::overlapSamples(st.get()), overlap * channels);
+                    continue;
+                }
+
+                // Unaligned positions too: the offsets step by one frame
+                double scale = 1;
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+                scale = 16000.0 * 16000.0;
+#endif
+                double norm = 0;
+                double accNorm = 0;
+                for (int i = 0; i < offsets; i ++)
+                {
+                    const SAMPLETYPE *pos = mixing.data() + i * channels;
+                    double corr = StretchAccess::crossCorr(st.get(), pos, compare.data(), norm);
+                    double acc = (i == 0) ? StretchAccess::crossCorr(st.get(), pos, compare.data(), accNorm)
+                                          : StretchAccess::crossCorrAccumulate(st.get(), pos, compare.data(), accNorm);
+                    if (v == 0)
+                    {
+                        reference[2 * i] = corr;
+                        reference[2 * i + 1] = acc;
+                    }
+                    else
+                    {
+                        // correlations are normalized by the mixing energy only,
+                        // so they scale with the compare samples
+                        if (!isClose(corr, reference[2 * i], sqrt(scale), overlap * channels))
+                        {
+                            fail("calcCrossCorr", versions[v].name, detail, corr, reference[2 * i]);
+                        }
+                        if (!isClose(acc, reference[2 * i + 1], sqrt(scale), overlap * channels))
+                        {
+                            fail("calcCrossCorrAccumulate", versions[v].name, detail, acc, reference[2 * i + 1]);
+                        }
+                    }
+                }
+                StretchAccess::clearState(st.get());
+            }
+        }
+    }
+}
+
+
+static void testFilter()
+{
+    const uint MAX_EXTRA = 67;
+
+    for (uint channels = 1; channels <= 2; channels ++)
+    {
+        for (uint length : {8u, 16u, 24u, 32u, 40u, 64u, 72u, 128u})
+        {
+            std::vector<SAMPLETYPE> coeffs = randomInput(length, 3);
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+            // Gain of at most 1 after the division by 2^8, as the MMX routine
+            // saturates where the C++ one does not
+            for (SAMPLETYPE &coeff : coeffs)
+            {
+                coeff = (SAMPLETYPE)(coeff * 256 / (16000 * (int)length));
+            }
+#endif
+            std::vector<SAMPLETYPE> src = randomInput((length + MAX_EXTRA) * channels, 4);
+
+            for (uint numSamples = length; numSamples <= length + MAX_EXTRA; numSamples ++)
+            {
+                char detail[64];
+                snprintf(detail, sizeof(detail), "%u ch, %u taps, %u frames", channels, length, numSamples);
+
+                std::vector<SAMPLETYPE> reference;
+                uint referenceCount = 0;
+
+                for (int v = 0; v < NUM_VERSIONS; v ++)
+                {
+                    std::unique_ptr<FIRFilter> filter(newFilter(versions[v]));
+                    filter->setCoefficients(coeffs.data(), length, 8);
+
+                    std::vector<SAMPLETYPE> dest(numSamples * channels, 0);
+                    uint count = filter->evaluate(dest.data(), src.data(), numSamples, channels);
+
+                    if (v == 0)
+                    {
+                        reference = dest;
+                        referenceCount = count;
+                        continue;
+                    }
+
+                    // The SSE stereo routine filters an even count of frames
+                    if ((count > referenceCount) || (count + 1 < referenceCount))
+                    {
+                        fail("FIR filter count", versions[v].name, detail, count, referenceCount);
+                        continue;
+                    }
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+                    const double scale = 16000.0 * 16000.0 / 256;
+#else
+                    const double scale = 1.0 / 256;
+#endif
+                    for (uint i = 0; i < count * channels; i ++)
+                    {
+                        if (!isClose(dest[i], reference[i], scale, length))
+                        {
+                            fail("FIR filter", versions[v].name, detail, dest[i], reference[i]);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/// Whether a version created the same class as the one before it, which
+/// happens for the extensions that the CPU lacks
+template <class T> static bool repeatsPrevious(T *(*create)(const Version &), int v)
+{
+    if (v == 0) return false;
+    std::unique_ptr<T> current(create(versions[v]));
+    std::unique_ptr<T> previous(create(versions[v - 1]));
+    return typeid(*current) == typeid(*previous);
+}
+
+
+/// Prints the time of each routine & version: a seek over 15 ms at 48 kHz with an
+/// 8 ms overlap, and a 64-tap filter over a block of 4096 frames
+static void benchmark()
+{
+    printf("\n%-28s", "ns/call");
+    for (int v = 0; v < NUM_VERSIONS; v ++) printf("%10s", versions[v].name);
+    printf("\n");
+
+    for (int channels = 1; channels <= 2; channels ++)
+    {
+        const int seekLength = 48 * 15;
+        std::vector<SAMPLETYPE> mixing = randomInput((384 + seekLength) * channels, 5);
+        std::vector<SAMPLETYPE> compare = randomInput(384 * channels, 6);
+
+        printf("seek, %d ch %-16s", channels, "");
+        for (int v = 0; v < NUM_VERSIONS; v ++)
+        {
+            if (repeatsPrevious(newStretch, v))
+            {
+                printf("%10s", "-");
+                continue;
+            }
+            std::unique_ptr<TDStretch> st(newStretch(versions[v]));
+            st->setChannels(channels);
+            st->setParameters(48000, 40, 15, 8);
+
+            const int rounds = 200;
+            double sink = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; r ++)
+            {
+                double norm;
+                sink += StretchAccess::crossCorr(st.get(), mixing.data(), compare.data(), norm);
+                for (int i = 1; i < seekLength; i ++)
+                {
+                    sink += StretchAccess::crossCorrAccumulate(st.get(), mixing.data() + i * channels, compare.data(), norm);
+                }
+            }
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            printf("%10.0f", elapsed.count() / rounds + (sink == 12345 ? 1 : 0));
+        }
+        printf("\n");
+    }
+
+    for (uint channels = 1; channels <= 2; channels ++)
+    {
+        const uint length = 64;
+        const uint frames = 4096;
+        std::vector<SAMPLETYPE> coeffs = randomInput(length, 7);
+        std::vector<SAMPLETYPE> src = randomInput((frames + length) * channels, 8);
+        std::vector<SAMPLETYPE> dest((frames + length) * channels);
+
+        printf("FIR 64 taps, %u ch %-10s", channels, "");
+        for (int v = 0; v < NUM_VERSIONS; v ++)
+        {
+            if (repeatsPrevious(newFilter, v))
+            {
+                printf("%10s", "-");
+                continue;
+            }
+            std::unique_ptr<FIRFilter> filter(newFilter(versions[v]));
+            filter->setCoefficients(coeffs.data(), length, 8);
+
+            const int rounds = 500;
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; r ++)
+            {
+                filter->evaluate(dest.data(), src.data(), frames + length, channels);
+            }
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            printf("%10.0f", elapsed.count() / rounds);
+        }
+        printf("\n");
+    }
+    printf("'-': the CPU lacks the extensions, same as the version before\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    // The versions the CPU lacks create the next best one, which only repeats it
+    testCrossCorr();
+    testFilter();
+
+    if ((argc > 1) && (strcmp(argv[1], "benchmark") == 0))
+    {
+        benchmark();
+    }
+
+    printf(failures ? "FAILED\n" : "PASSED\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
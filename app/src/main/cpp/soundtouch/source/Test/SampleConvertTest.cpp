@@ -0,0 +1,316 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Tests of the sample format conversion routines. Each routine is run with the
+/// SIMD versions the CPU has and with them disabled, which must give the same
+/// output bit for bit, and the plain C++ output is checked against the expected
+/// scaling & saturation. Lengths from 0 to a few vectors cover the remainders
+/// that the C++ loop finishes after the SIMD routines.
+///
+/// Run with the argument 'benchmark' to also time each routine & version.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "SampleConvert.h"
+#include "cpu_detect.h"
+
+using namespace soundtouch;
+
+/// Versions of the routines to compare, by the extensions left enabled
+struct Version
+{
+    const char *name;
+    uint disabled;      ///< SUPPORT_... flags passed to 'disableExtensions'
+};
+
+static const Version versions[] =
+{
+    {"C++", 0xffffffff},
+    {"SSE2", SUPPORT_AVX2},
+    {"AVX2", 0},
+};
+static const int NUM_VERSIONS = sizeof(versions) / sizeof(versions[0]);
+
+/// Longest test length; covers a couple of vectors of every SIMD width
+static const uint MAX_LENGTH = 67;
+
+
+/// Float test input: exact & near full scale values, values beyond it that
+/// must saturate, and values between the integer steps
+static std::vector<float> floatInput(uint count)
+{
+    static const float special[] =
+    {
+        0.0f, -0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 2.0f, -2.0f, 1e9f, -1e9f,
+        32767.0f / 32768.0f, 32767.5f / 32768.0f, -32768.5f / 32768.0f,
+        1e-6f, -1e-6f, 0.25f / 32768.0f, -0.75f / 32768.0f
+    };
+    const uint numSpecial = sizeof(special) / sizeof(special[0]);
+    std::vector<float> values(count);
+    unsigned int seed = 1;
+
+    for (uint i = 0; i < count; i ++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        values[i] = (i < numSpecial) ? special[i] : (float)((int)(seed >> 8) - 0x800000) / 6000000.0f;
+    }
+    return values;
+}
+
+
+/// 16bit test input covering the extremes
+static std::vector<short> int16Input(uint count)
+{
+    std::vector<short> values(count);
+
+    for (uint i = 0; i < count; i ++)
+    {
+        values[i] = (short)((i == 0) ? -32768 : (i == 1) ? 32767 : (int)(i * 2654435761u >> 16) - 32768);
+    }
+    return values;
+}
+
+
+/// Expected 'convertFloatToInt16' & 'convertFloatToInt24' output: scaled,
+/// saturated & truncated towards zero
+static int expectedInt(float value, float scale)
+{
+    float scaled = value * scale;
+
+    if (scaled > scale - 1) return (int)scale - 1;
+    if (scaled < -scale) return -(int)scale;
+    return (int)scaled;
+}
+
+
+static int failures = 0;
+
+static void fail(const char *routine, const char *version, uint length, uint index)
+{
+    if (failures < 20)
+    {
+        printf("FAIL %s %s, %u samples: sample %u differs\n", routine, version, length, index);
+    }
+    failures ++;
+}
+
+
+static void testFloatToInt16()
+{
+    std::vector<float> src = floatInput(MAX_LENGTH);
+
+    for (uint length = 0; length <= MAX_LENGTH; length ++)
+    {
+        std::vector<short> reference(length + 1, 0x5555);
+
+        for (int v = 0; v < NUM_VERSIONS; v ++)
+        {
+            std::vector<short> dest(length + 1, 0x5555);
+
+            disableExtensions(versions[v].disabled);
+            convertFloatToInt16(src.data(), dest.data(), length);
+            if (v == 0)
+            {
+                reference = dest;
+                for (uint i = 0; i < length; i ++)
+                {
+                    if (dest[i] != expectedInt(src[i], 32768.0f)) fail("float to int16", "expected", length, i);
+                }
+            }
+            // also checks that nothing was written past the end
+            for (uint i = 0; i <= length; i ++)
+            {
+                if (dest[i] != reference[i]) fail("float to int16", versions[v].name, length, i);
+            }
+        }
+    }
+}
+
+
+static void testFloatToInt16Dither()
+{
+    std::vector<float> src = floatInput(MAX_LENGTH);
+
+    for (uint length = 0; length <= MAX_LENGTH; length ++)
+    {
+        std::vector<short> reference;
+        DitherState referenceState;
+
+        for (int v = 0; v < NUM_VERSIONS; v ++)
+        {
+            std::vector<short> dest(length + 1, 0x5555);
+            DitherState dither(1234);
+
+            // two calls, so that the second one starts from a used state
+            disableExtensions(versions[v].disabled);
+            convertFloatToInt16Dither(src.data(), dest.data(), length, dither);
+            convertFloatToInt16Dither(src.data(), dest.data(), length, dither);
+            if (v == 0)
+            {
+                reference = dest;
+                referenceState = dither;
+                // TPDF noise is within one step either way
+                for (uint i = 0; i < length; i ++)
+                {
+                    if (abs(dest[i] - expectedInt(src[i], 32768.0f)) > 1) fail("float to int16 dither", "expected", length, i);
+                }
+            }
+            for (uint i = 0; i <= length; i ++)
+            {
+                if (dest[i] != reference[i]) fail("float to int16 dither", versions[v].name, length, i);
+            }
+            if (memcmp(dither.lane, referenceState.lane, sizeof(dither.lane)) != 0)
+            {
+                fail("float to int16 dither state", versions[v].name, length, 0);
+            }
+        }
+    }
+}
+
+
+static void testInt16ToFloat()
+{
+    std::vector<short> src = int16Input(MAX_LENGTH);
+
+    for (uint length = 0; length <= MAX_LENGTH; length ++)
+    {
+        std::vector<float> reference;
+
+        for (int v = 0; v < NUM_VERSIONS; v ++)
+        {
+            std::vector<float> dest(length + 1, 123.0f);
+
+            disableExtensions(versions[v].disabled);
+            convertInt16ToFloat(src.data(), dest.data(), length);
+            if (v == 0)
+            {
+                reference = dest;
+                for (uint i = 0; i < length; i ++)
+                {
+                    if (dest[i] != (float)src[i] / 32768.0f) fail("int16 to float", "expected", length, i);
+                }
+            }
+            if (memcmp(dest.data(), reference.data(), (length + 1) * sizeof(float)) != 0)
+            {
+                fail("int16 to float", versions[v].name, length, 0);
+            }
+        }
+    }
+}
+
+
+static void testFloatToInt24()
+{
+    std::vector<float> src = floatInput(MAX_LENGTH);
+
+    for (uint length = 0; length <= MAX_LENGTH; length ++)
+    {
+        std::vector<int> reference;
+
+        for (int v = 0; v < NUM_VERSIONS; v ++)
+        {
+            std::vector<int> dest(length + 1, 0x55555555);
+
+            disableExtensions(versions[v].disabled);
+            convertFloatToInt24(src.data(), dest.data(), length);
+            if (v == 0)
+            {
+                reference = dest;
+                for (uint i = 0; i < length; i ++)
+                {
+                    if (dest[i] != expectedInt(src[i], 8388608.0f)) fail("float to int24", "expected", length, i);
+                }
+            }
+            for (uint i = 0; i <= length; i ++)
+            {
+                if (dest[i] != reference[i]) fail("float to int24", versions[v].name, length, i);
+            }
+        }
+    }
+}
+
+
+/// Prints the time per sample of each routine & version over a buffer of a
+/// typical block size, repeated to about 100 million samples
+static void benchmark()
+{
+    const uint length = 4096;
+    const int rounds = 25000;
+    std::vector<float> floats = floatInput(length);
+    std::vector<short> shorts(length);
+    std::vector<int> ints(length);
+    DitherState dither;
+
+    printf("\n%-24s", "ns/sample");
+    for (int v = 0; v < NUM_VERSIONS; v ++) printf("%8s", versions[v].name);
+    printf("\n");
+
+    for (int routine = 0; routine < 4; routine ++)
+    {
+        static const char *names[4] = {"float to int16", "float to int16 dither", "int16 to float", "float to int24"};
+        printf("%-24s", names[routine]);
+        for (int v = 0; v < NUM_VERSIONS; v ++)
+        {
+            disableExtensions(versions[v].disabled);
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; r ++)
+            {
+                switch (routine)
+                {
+                    case 0: convertFloatToInt16(floats.data(), shorts.data(), length); break;
+                    case 1: convertFloatToInt16Dither(floats.data(), shorts.data(), length, dither); break;
+                    case 2: convertInt16ToFloat(shorts.data(), floats.data(), length); break;
+                    default: convertFloatToInt24(floats.data(), ints.data(), length); break;
+                }
+            }
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            printf("%8.3f", elapsed.count() / ((double)rounds * length));
+        }
+        printf("\n");
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    // The versions the CPU lacks run the next best one, which only repeats it
+    testFloatToInt16();
+    testFloatToInt16Dither();
+    testInt16ToFloat();
+    testFloatToInt24();
+
+    if ((argc > 1) && (strcmp(argv[1], "benchmark") == 0))
+    {
+        benchmark();
+    }
+    disableExtensions(0);
+
+    printf(failures ? "FAILED\n" : "PASSED\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
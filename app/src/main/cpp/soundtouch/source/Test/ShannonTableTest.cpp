@@ -0,0 +1,182 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Test of the tabulated Shannon interpolation kernel against the windowed sinc
+/// it replaces. Transposes noise at several rates, mono & stereo, and compares
+/// each output sample with the sum over the 8 taps of the input times
+/// sinc(k - 3 - fract) times the Kaiser window, evaluated in double precision.
+/// The difference must stay within the error of interpolating the table
+/// linearly between its SHANNON_PHASES phases.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "InterpolateShannon.h"
+
+using namespace soundtouch;
+
+/// Kaiser window with beta = 2.0, scaled down by 5%, as in InterpolateShannon
+static const double KAISER8[8] =
+{
+   0.41778693317814,
+   0.64888025049173,
+   0.83508562409944,
+   0.93887857733412,
+   0.93887857733412,
+   0.83508562409944,
+   0.64888025049173,
+   0.41778693317814
+};
+
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+static const double FULL_SCALE = 16000;
+#else
+static const double FULL_SCALE = 1;
+#endif
+
+/// Largest allowed difference relative to full scale, -90 dB. Interpolating
+/// the table linearly errs by at most (1 / SHANNON_PHASES)^2 / 8 times the
+/// kernel's second derivative, pi^2 / 3, per tap: 1.3e-5 over the 8 taps at
+/// full scale, plus the float rounding.
+static const double MAX_ERROR = 3.2e-5;
+
+
+/// Runs the protected transposing routines of the interpolator
+class ShannonAccess : public InterpolateShannon
+{
+public:
+    int mono(SAMPLETYPE *dest, const SAMPLETYPE *src, int &srcSamples)
+    {
+        return transposeMono(dest, src, srcSamples);
+    }
+
+    int stereo(SAMPLETYPE *dest, const SAMPLETYPE *src, int &srcSamples)
+    {
+        return transposeStereo(dest, src, srcSamples);
+    }
+};
+
+
+/// The windowed sinc interpolation of channel 'c' at 'fract' past 'src'
+static double reference(const SAMPLETYPE *src, int channels, int c, double fract)
+{
+    double out = 0;
+
+    for (int k = 0; k < 8; k ++)
+    {
+        double x = M_PI * (k - 3 - fract);
+        double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(x) / x;
+        out += src[k * channels + c] * sinc * KAISER8[k];
+    }
+    return out;
+}
+
+
+/// Transposes noise at 'rate' & counts the output samples off the reference;
+/// reports the largest difference in 'maxDiff'
+static int runRate(double rate, int channels, double &maxDiff)
+{
+    const int frames = 20000;
+    std::vector<SAMPLETYPE> src(frames * channels);
+    std::vector<SAMPLETYPE> dest((size_t)(frames / rate + 16) * channels);
+    unsigned int seed = 1;
+
+    for (SAMPLETYPE &sample : src)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        sample = (SAMPLETYPE)(FULL_SCALE * ((int)(seed >> 8) - 0x800000) / 0x800000);
+    }
+
+    ShannonAccess interpolator;
+    interpolator.setChannels(channels);
+    interpolator.setRate(rate);
+
+    int srcSamples = frames;
+    const int count = (channels == 1) ? interpolator.mono(dest.data(), src.data(), srcSamples)
+                                      : interpolator.stereo(dest.data(), src.data(), srcSamples);
+
+    // Step the position the way the interpolator does
+    double fract = 0;
+    int pos = 0;
+    int failures = 0;
+    for (int i = 0; i < count; i ++)
+    {
+        for (int c = 0; c < channels; c ++)
+        {
+            double expected = reference(src.data() + pos * channels, channels, c, fract);
+            double got = dest[i * channels + c];
+#ifdef SOUNDTOUCH_INTEGER_SAMPLES
+            // both truncated to integer
+            expected = (SAMPLETYPE)expected;
+            const double allowed = 1 + MAX_ERROR * FULL_SCALE;
+#else
+            const double allowed = MAX_ERROR * FULL_SCALE;
+#endif
+            const double diff = fabs(got - expected);
+            if (diff > maxDiff) maxDiff = diff;
+            if (diff > allowed)
+            {
+                if (failures < 10)
+                {
+                    printf("FAIL rate %g, %d ch, output %d, fract %.6f: %g, expected %g\n",
+                           rate, channels, i, fract, got, expected);
+                }
+                failures ++;
+            }
+        }
+
+        fract += rate;
+        int whole = (int)fract;
+        fract -= whole;
+        pos += whole;
+    }
+
+    if (pos != srcSamples)
+    {
+        printf("FAIL rate %g, %d ch: consumed %d frames, expected %d\n", rate, channels, srcSamples, pos);
+        failures ++;
+    }
+    return failures;
+}
+
+
+int main()
+{
+    int failures = 0;
+    double maxDiff = 0;
+
+    for (double rate : {0.37, 0.5, 0.8, 1.0, 1.0 / 1.1, 1.25, 1.7, 2.0})
+    {
+        for (int channels = 1; channels <= 2; channels ++)
+        {
+            failures += runRate(rate, channels, maxDiff);
+        }
+    }
+
+    printf("Largest difference %.3g of full scale\n", maxDiff / FULL_SCALE);
+    printf(failures ? "FAILED\n" : "PASSED\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -13,6 +13,7 @@ import android.content.ServiceConnection
 import android.media.AudioDeviceInfo
 import android.media.AudioManager
 import android.os.Binder
+import android.os.Environment
 import android.os.IBinder
 import android.os.ParcelFileDescriptor
 import androidx.annotation.RequiresPermission
@@ -48,6 +49,7 @@ class AudioService : Service() {
     @Inject lateinit var audioHelper: AudioHelper
     @Inject lateinit var dataStoreRepository: DataStoreRepository
     @Inject lateinit var writingManager: WritingManager
+    @Inject lateinit var transcodeManager: TranscodeManager
     @Inject lateinit var getPreferredInputDeviceUseCase: GetPreferredInputDeviceUseCase
     @Inject lateinit var getPreferredOutputDeviceUseCase: GetPreferredOutputDeviceUseCase
 
@@ -70,6 +72,7 @@ class AudioService : Service() {
         super.onCreate()
 
         updateSampleRate()
+        resumePendingTranscodes()
 
         observeSelectedDevice()
         observePitch()
@@ -112,6 +115,12 @@ class AudioService : Service() {
     }
     // endregion
 
+    private fun resumePendingTranscodes() {
+        getExternalFilesDir(Environment.DIRECTORY_MUSIC)?.let {
+            transcodeManager.resumePending(it)
+        }
+    }
+
     private fun updateSampleRate() {
         val sampleRateStr = audioHelper.audioManager.getProperty(AudioManager.PROPERTY_OUTPUT_SAMPLE_RATE)
         val sampleRate = sampleRateStr?.let { str -> Integer.parseInt(str).takeUnless { it == 0 }} ?: 44100
@@ -295,23 +304,101 @@ class AudioService : Service() {
     }
 }
 
-class WritingManager @Inject constructor() {
+class WritingManager @Inject constructor(
+    private val transcodeManager: TranscodeManager
+) {
 
     val isActiveFlow = MutableStateFlow(false)
     var activatedTimestamp: Long? = null
 
     var pfd: ParcelFileDescriptor? = null
+    private var pendingCapture: File? = null
+
+    // Keeps the last seconds of the session (up to 120) in memory, so that
+    // start() can include them. 0 turns the history off.
+    fun setPreRollLength(seconds: Int) {
+        NativeWrapper.setPreRollSeconds(seconds)
+    }
+
+    // Pipeline counters of the current recording, or of the last one
+    fun stats(): RecordingStats {
+        return RecordingStats.fromArray(NativeWrapper.getRecordingStats())
+    }
+
+    // Prepares the encoder for the next start() with the same quality and
+    // source, so that recording starts without the codec setup delay. The
+    // engine does this by itself for the last used configuration.
+    fun prepare(
+        quality: RecordingQuality = RecordingQuality.STREAM,
+        includeProcessed: Boolean = false
+    ) {
+        NativeWrapper.prepareRecording(
+            recordingSource(includeProcessed),
+            quality.sampleRate,
+            recordingBitrate(quality, includeProcessed)
+        )
+    }
 
-    fun start(file: File) {
+    // With deferTranscode the session is captured as raw PCM next to file and
+    // converted to AAC in the background after stop(). With includeProcessed
+    // the file is stereo: dry input left, pitch-shifted output right.
+    // preRollSeconds of the history kept by setPreRollLength() go in front.
+    fun start(
+        file: File,
+        sinkType: Int = NativeWrapper.RECORDING_SINK_AAC,
+        deferTranscode: Boolean = false,
+        quality: RecordingQuality = RecordingQuality.STREAM,
+        includeProcessed: Boolean = false,
+        preRollSeconds: Int = 0
+    ) {
         if (isActiveFlow.value) {
             return
         }
 
-        val pfd = ParcelFileDescriptor.open(file, ParcelFileDescriptor.MODE_WRITE_ONLY or ParcelFileDescriptor.MODE_TRUNCATE)
+        val target = if (deferTranscode) transcodeManager.captureFileFor(file) else file
+        val pfd = ParcelFileDescriptor.open(target, ParcelFileDescriptor.MODE_WRITE_ONLY or ParcelFileDescriptor.MODE_CREATE or ParcelFileDescriptor.MODE_TRUNCATE)
         val fd = pfd.fd
-        NativeWrapper.startRecording(fd)
+        NativeWrapper.startRecording(
+            fd,
+            if (deferTranscode) NativeWrapper.RECORDING_SINK_WAV else sinkType,
+            recordingSource(includeProcessed),
+            quality.sampleRate,
+            recordingBitrate(quality, includeProcessed),
+            preRollSeconds
+        )
 
         this.pfd = pfd
+        this.pendingCapture = if (deferTranscode) target else null
+
+        isActiveFlow.value = true
+        activatedTimestamp = System.currentTimeMillis()
+    }
+
+    // Records into segment_NNNN.m4a files in directory, starting a new one
+    // every segmentMinutes or segmentMegabytes (0 disables a limit). Closed
+    // segments are listed with their first frame and length in segments.txt.
+    fun startSegmented(
+        directory: File,
+        segmentMinutes: Int,
+        segmentMegabytes: Int = 0,
+        quality: RecordingQuality = RecordingQuality.STREAM,
+        includeProcessed: Boolean = false,
+        preRollSeconds: Int = 0
+    ) {
+        if (isActiveFlow.value) {
+            return
+        }
+
+        directory.mkdirs()
+        NativeWrapper.startSegmentedRecording(
+            directory.path,
+            segmentMinutes * 60,
+            segmentMegabytes * 1024L * 1024L,
+            recordingSource(includeProcessed),
+            quality.sampleRate,
+            recordingBitrate(quality, includeProcessed),
+            preRollSeconds
+        )
 
         isActiveFlow.value = true
         activatedTimestamp = System.currentTimeMillis()
@@ -325,7 +412,16 @@ class WritingManager @Inject constructor() {
 
         this.pfd?.close()
         this.pfd = null
+
+        pendingCapture?.let { transcodeManager.enqueue(it) }
+        pendingCapture = null
     }
+
+    private fun recordingSource(includeProcessed: Boolean): Int =
+        if (includeProcessed) NativeWrapper.RECORDING_SOURCE_DRY_AND_PROCESSED else NativeWrapper.RECORDING_SOURCE_DRY
+
+    private fun recordingBitrate(quality: RecordingQuality, includeProcessed: Boolean): Int =
+        if (includeProcessed) quality.bitrate * 2 else quality.bitrate
 }
 
 class AudioServiceNotificationManager(private val context: Context) {
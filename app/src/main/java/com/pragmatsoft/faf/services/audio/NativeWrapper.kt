@@ -2,6 +2,16 @@ package com.pragmatsoft.faf.services.audio
 
 object NativeWrapper {
 
+    const val RECORDING_SINK_AAC = 0
+    const val RECORDING_SINK_WAV = 1
+
+    const val RECORDING_SOURCE_DRY = 0
+    const val RECORDING_SOURCE_DRY_AND_PROCESSED = 1
+
+    const val PITCH_ENGINE_SOUNDTOUCH = 0
+    const val PITCH_ENGINE_DELAY_LINE = 1
+    const val PITCH_ENGINE_FREQUENCY_SHIFT = 2
+
     init {
         System.loadLibrary("native-lib")
     }
@@ -17,7 +27,27 @@ object NativeWrapper {
     external fun setPitch(value: Float)
     external fun setGain(value: Int)
     external fun setGainType(value: Int)
+    external fun setPitchEngine(value: Int)
+    external fun setFrequencyShift(value: Float)
+    external fun getPitchLatencyFrames(): Int
 
-    external fun startRecording(fd: Int)
+    external fun setPreRollSeconds(value: Int)
+    external fun prepareRecording(source: Int, sampleRate: Int, bitrate: Int)
+    external fun startRecording(fd: Int, sinkType: Int, source: Int, sampleRate: Int, bitrate: Int, preRollSeconds: Int)
+    external fun startSegmentedRecording(
+        directory: String,
+        segmentSeconds: Int,
+        segmentBytes: Long,
+        source: Int,
+        sampleRate: Int,
+        bitrate: Int,
+        preRollSeconds: Int
+    )
     external fun stopRecording()
+    external fun getRecordingStats(): LongArray
+
+    external fun startTranscode(inFd: Int, outFd: Int): Boolean
+    external fun getTranscodeState(): Int
+    external fun getTranscodeProgress(): Float
+    external fun releaseTranscode()
 }
\ No newline at end of file
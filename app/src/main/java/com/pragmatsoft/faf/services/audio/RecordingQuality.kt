@@ -0,0 +1,10 @@
+package com.pragmatsoft.faf.services.audio
+
+// Sample rate and bitrate passed to NativeWrapper.startRecording. A sample
+// rate of 0 records at the stream rate; a bitrate of 0 lets the encoder pick
+// one for the rate. Bitrates are for mono and doubled for stereo recordings.
+enum class RecordingQuality(val sampleRate: Int, val bitrate: Int) {
+    STREAM(0, 0),
+    SPEECH_24K(24000, 32000),
+    SPEECH_16K(16000, 24000),
+}
@@ -0,0 +1,51 @@
+package com.pragmatsoft.faf.services.audio
+
+// Counters of the recording pipeline, from NativeWrapper.getRecordingStats.
+// Times are kept as count/total/max so that snapshots from several
+// recordings or devices can be summed before averaging.
+data class RecordingStats(
+    val framesQueued: Long,
+    val bytesWritten: Long,
+    val droppedSamples: Long,
+    val skippedFrames: Long,
+    val discontinuities: Long,
+    val ringOccupancy: Long,
+    val ringHighWater: Long,
+    val ringCapacity: Long,
+    val codecQueueDepth: Long,
+    val codecQueueMax: Long,
+    val convert: Timing,
+    val encode: Timing,
+    val write: Timing,
+    val firstSampleLatencyNs: Long,
+    // Input the audio callback lost: frames beyond its processing buffer, and
+    // times SoundTouch refused input and its output was cleared to catch up
+    val truncatedInputFrames: Long,
+    val pitchOverruns: Long,
+) {
+    data class Timing(val count: Long, val totalNs: Long, val maxNs: Long) {
+        val averageNs: Long get() = if (count > 0) totalNs / count else 0
+    }
+
+    companion object {
+        // Same order as the native side fills the array in
+        fun fromArray(values: LongArray) = RecordingStats(
+            framesQueued = values[0],
+            bytesWritten = values[1],
+            droppedSamples = values[2],
+            skippedFrames = values[3],
+            discontinuities = values[4],
+            ringOccupancy = values[5],
+            ringHighWater = values[6],
+            ringCapacity = values[7],
+            codecQueueDepth = values[8],
+            codecQueueMax = values[9],
+            convert = Timing(values[10], values[11], values[12]),
+            encode = Timing(values[13], values[14], values[15]),
+            write = Timing(values[16], values[17], values[18]),
+            firstSampleLatencyNs = values[19],
+            truncatedInputFrames = values[20],
+            pitchOverruns = values[21],
+        )
+    }
+}
@@ -0,0 +1,123 @@
+package com.pragmatsoft.faf.services.audio
+
+import android.os.ParcelFileDescriptor
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.flow.MutableStateFlow
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import java.io.File
+import javax.inject.Inject
+import javax.inject.Singleton
+
+// Converts raw session captures to AAC once the session is over. A capture
+// for "<name>" is kept as "<name>.<start time>.capture.wav" until its
+// transcode has finished, so jobs interrupted by the app being killed are
+// picked up again by resumePending(). The time stamp keeps a new session from
+// overwriting a capture of the same target that is still waiting; jobs run in
+// the order they were recorded, so the target ends up with the latest one.
+@Singleton
+class TranscodeManager @Inject constructor() {
+
+    // Progress of the running job from 0 to 1, null when idle
+    val progressFlow = MutableStateFlow<Float?>(null)
+
+    private val scope = CoroutineScope(Dispatchers.IO + SupervisorJob())
+    private val mutex = Mutex()
+
+    fun captureFileFor(target: File): File {
+        var stamp = System.currentTimeMillis()
+        var capture: File
+        do {
+            capture = File(target.parentFile, "${target.name}.${stamp++}$CAPTURE_SUFFIX")
+        } while (capture.exists())
+        return capture
+    }
+
+    fun enqueue(capture: File) {
+        scope.launch {
+            mutex.withLock {
+                transcode(capture)
+            }
+        }
+    }
+
+    fun resumePending(dir: File) {
+        // Only files named by captureFileFor(), oldest first
+        dir.listFiles { file -> targetFor(file) != null }
+            ?.sortedBy { stampOf(it) }
+            ?.forEach { enqueue(it) }
+    }
+
+    private suspend fun transcode(capture: File) {
+        if (!capture.exists()) {
+            return
+        }
+
+        val target = targetFor(capture) ?: return
+        val part = File(target.path + PART_SUFFIX)
+
+        val state = ParcelFileDescriptor.open(capture, ParcelFileDescriptor.MODE_READ_ONLY).use { input ->
+            ParcelFileDescriptor.open(
+                part,
+                ParcelFileDescriptor.MODE_WRITE_ONLY or ParcelFileDescriptor.MODE_CREATE or ParcelFileDescriptor.MODE_TRUNCATE
+            ).use { output ->
+                runTranscode(input.fd, output.fd)
+            }
+        }
+
+        if (state == STATE_DONE && part.renameTo(target)) {
+            capture.delete()
+        } else {
+            part.delete()
+        }
+    }
+
+    // "<name>.<stamp>.capture.wav" -> "<name>", null for any other file
+    private fun targetFor(capture: File): File? {
+        if (!capture.name.endsWith(CAPTURE_SUFFIX) || stampOf(capture) == null) {
+            return null
+        }
+        val name = capture.name.removeSuffix(CAPTURE_SUFFIX).substringBeforeLast('.')
+        return if (name.isEmpty()) null else File(capture.parentFile, name)
+    }
+
+    private fun stampOf(capture: File): Long? =
+        capture.name.removeSuffix(CAPTURE_SUFFIX).substringAfterLast('.', "").toLongOrNull()
+
+    private suspend fun runTranscode(inFd: Int, outFd: Int): Int {
+        if (!NativeWrapper.startTranscode(inFd, outFd)) {
+            return STATE_FAILED
+        }
+
+        try {
+            progressFlow.value = 0f
+
+            var state = NativeWrapper.getTranscodeState()
+            while (state == STATE_RUNNING) {
+                delay(PROGRESS_INTERVAL_MS)
+                progressFlow.value = NativeWrapper.getTranscodeProgress()
+                state = NativeWrapper.getTranscodeState()
+            }
+            return state
+        } finally {
+            // Also cancels the job if the coroutine was cancelled
+            NativeWrapper.releaseTranscode()
+            progressFlow.value = null
+        }
+    }
+
+    companion object {
+        const val CAPTURE_SUFFIX = ".capture.wav"
+        private const val PART_SUFFIX = ".part"
+        private const val PROGRESS_INTERVAL_MS = 200L
+
+        // Mirrors TranscodeState in Transcoder.h
+        private const val STATE_RUNNING = 1
+        private const val STATE_DONE = 2
+        private const val STATE_FAILED = 3
+    }
+}